@@ -3,10 +3,11 @@
 # -*- Mode: Python -*-
 
 import sys
-import requests
 import time
+import heapq
 import logging
-import threaded
+import threading
+import collections
 
 # scenes are device_id based. 
 hf_scenes = []
@@ -19,6 +20,7 @@ ch.setFormatter(formatter)
 logger.addHandler(ch)
 
 from DECTMessagingConfig import *
+from action_http import PooledHTTPClient
  
 HTTP_ULE_ROOT = f'http://{XML_SERVER_IP}:8881'
 
@@ -56,17 +58,188 @@ class HFScene:
             print(f'no HFAction(s) specified for empty state') 
 
 
+# keep-alive connections to phones, relays and gateways, shared by all actions
+action_http = PooledHTTPClient()
+
+
 def send_action_to_web_server(url):
     # save xml to file
     # send to phone
     request = url
     logger.debug("send to phone: {}".format(request))
-    try:
-        _response = requests.get(request, timeout=5)
-        logger.debug(_response)        
-    except:
-        logger.exception("Error send_action_to_web_server:")
-        pass
+    _response = action_http.get(request)
+    logger.debug(_response)
+
+
+def send_action_to_web_server_async(url):
+    # returns at once, the Future gives the response (None on failure)
+    logger.debug("send to phone (async): {}".format(url))
+    return action_http.get_async(url)
+
+
+def run_action(action):
+    # actions without duration go out in parallel with the next ones,
+    # a duration is counted from the response of the action
+    if action.actions_duration:
+        send_action_to_web_server(action.action_url)
+    else:
+        send_action_to_web_server_async(action.action_url)
+
+
+class SceneRun(object):
+    """One run of the actions of a scene for a state, executed step by step."""
+
+    def __init__(self, scene_name, state, actions):
+        self.scene_name = scene_name
+        self.state = state
+        self.actions = actions
+        self.cancelled = False
+        self.done = False
+
+
+def _percentile(values, pct):
+    if not values:
+        return None
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * pct / 100.0))]
+
+
+class SceneExecutor(object):
+    """Run scene actions on a fixed number of worker threads.
+
+    The actions_duration after an action is a timer: the next action is scheduled
+    at its due time and no thread waits for it. Per scene only one run is active,
+    an event with the same state while it runs is ignored, an event with another
+    state cancels the remaining actions and starts the new ones.
+    At most max_steps actions are waiting, further runs are dropped.
+
+        scene_executor.submit(scene, '1', scene.get_actions_by_state('1').actions)
+    """
+
+    def __init__(self, workers=4, max_steps=256, action=None):
+        self.max_steps = max_steps
+        # executes one HFAction, run_action by default
+        self._action = action or run_action
+        # (due time, sequence, run, action index)
+        self._steps = []
+        self._seq = 0
+        # scene name -> active SceneRun
+        self._runs = {}
+        self._running = 0
+        self._run = True
+        self._cond = threading.Condition()
+
+        self.counters = collections.Counter()
+        # seconds from due time to start of an action, and its duration, of the last actions
+        self._delays = collections.deque(maxlen=1024)
+        self._durations = collections.deque(maxlen=1024)
+
+        self._workers = [threading.Thread(target=self._work, name=f'scene-worker-{i}', daemon=True)
+                         for i in range(workers)]
+        for worker in self._workers:
+            worker.start()
+
+    def submit(self, scene: HFScene, state: str, actions: List[HFAction]) -> bool:
+        """Start the actions of scene for state, False if dropped or already running."""
+        with self._cond:
+            current = self._runs.get(scene.name)
+            if current and not current.done and current.state == state:
+                self.counters['deduplicated'] += 1
+                return False
+            if len(self._steps) >= self.max_steps:
+                self.counters['dropped'] += 1
+                logger.warning("scene %s dropped, %d actions waiting", scene.name, len(self._steps))
+                return False
+            if current and not current.done:
+                current.cancelled = True
+                self.counters['cancelled'] += 1
+            run = SceneRun(scene.name, state, list(actions))
+            self._runs[scene.name] = run
+            self.counters['submitted'] += 1
+            if run.actions:
+                self._schedule(time.monotonic(), run, 0)
+            else:
+                self._finish(run)
+            return True
+
+    def cancel(self, scene_name: str) -> bool:
+        """Cancel the remaining actions of the active run of a scene."""
+        with self._cond:
+            run = self._runs.get(scene_name)
+            if run is None or run.done:
+                return False
+            run.cancelled = True
+            self._finish(run)
+            self.counters['cancelled'] += 1
+            return True
+
+    def stats(self) -> dict:
+        with self._cond:
+            stats = dict(self.counters, queue_depth=len(self._steps), running=self._running,
+                         active_scenes=sum(1 for run in self._runs.values() if not run.done))
+            delays, durations = list(self._delays), list(self._durations)
+        for name, values in (('delay', delays), ('duration', durations)):
+            for pct in (50, 99):
+                value = _percentile(values, pct)
+                stats[f'{name}_p{pct}_ms'] = None if value is None else round(value * 1000, 3)
+        return stats
+
+    def stop(self):
+        with self._cond:
+            self._run = False
+            self._cond.notify_all()
+        for worker in self._workers:
+            worker.join(5.0)
+
+    def _schedule(self, due, run, index):
+        # called with the lock held
+        self._seq += 1
+        heapq.heappush(self._steps, (due, self._seq, run, index))
+        self._cond.notify()
+
+    def _finish(self, run):
+        # called with the lock held
+        run.done = True
+        if self._runs.get(run.scene_name) is run:
+            del self._runs[run.scene_name]
+
+    def _work(self):
+        while True:
+            with self._cond:
+                while self._run and (not self._steps or self._steps[0][0] > time.monotonic()):
+                    self._cond.wait(self._steps[0][0] - time.monotonic() if self._steps else None)
+                if not self._run:
+                    return
+                due, _, run, index = heapq.heappop(self._steps)
+                if run.cancelled:
+                    continue
+                self._running += 1
+            action = run.actions[index]
+            start = time.monotonic()
+            failed = False
+            try:
+                logger.debug("scene %s state=%s action=%s", run.scene_name, run.state, action)
+                self._action(action)
+            except:
+                logger.exception("scene %s: action %s failed", run.scene_name, action)
+                failed = True
+            end = time.monotonic()
+            with self._cond:
+                self._running -= 1
+                self.counters['actions'] += 1
+                if failed:
+                    self.counters['failed'] += 1
+                self._delays.append(start - due)
+                self._durations.append(end - start)
+                if run.cancelled:
+                    continue
+                if index + 1 < len(run.actions):
+                    self._schedule(end + action.actions_duration, run, index + 1)
+                else:
+                    self._finish(run)
+
+
+scene_executor = SceneExecutor()
     
 actions1 = [HFAction(f'{KNX_GATEWAY_URL}/5/1/18-an',
                      actions_duration = 0.0),
@@ -89,35 +262,20 @@ hf_scenes.append(scene)
 def snom_handle_window_open_close(device_id, proximity):
     global hf_scenes
     if device_id == 3:
-        # thread start here
-        thread = snom_handle_window_open_close_t(proximity, hf_scenes[0]) 
-        thread.start()
-        return True
+        return snom_handle_window_open_close_t(proximity, hf_scenes[0])
     if device_id == 10:
-        # thread start here
-        thread = snom_handle_window_open_close_t(proximity, hf_scenes[0]) 
-        thread.start()
-        return True
+        return snom_handle_window_open_close_t(proximity, hf_scenes[0])
     return False
 
-@threaded.Threaded
 def snom_handle_window_open_close_t(state: str, scene: HFScene) -> bool:
     global hf_scenes
     logger.debug("snom_handle_window_open_close: run scene {}, state={}".format(scene.name, state))
 
     try:
-        action = 'not specified'
         # action_list = device_action_dict[device_id]
         state_actions = scene.get_actions_by_state(str(state))
         #action_list_for_state = action_list[str(state)]
-        for action in state_actions.actions:
-            logger.debug("snom_handle_window_open_close action={}".format(action))
-            try:
-                send_action_to_web_server(action.action_url)
-                time.sleep(action.actions_duration)
-            except:
-                logger.debug(f'action for {str(state)} not found, only have {state_actions.actions}')
-            
+        scene_executor.submit(scene, str(state), state_actions.actions)
         return True
     except:
         logger.debug("snom_handle_window_open_close failed: {}->{}".format(state, scene))
@@ -172,33 +330,24 @@ def action_on_report_level_changed(device_id: int, level:int) -> bool:
     global hf_scenes
     # if device_id == 13:
     if device_id == 7:
-        # thread start here
-        thread = action_on_report_level_changed_t(level, hf_scenes[1])
-        thread.start()
+        action_on_report_level_changed_t(level, hf_scenes[1])
     return True
 
-@threaded.Threaded
 def action_on_report_level_changed_t(level:int, scene: HFScene) -> bool:
     logger.debug("action_on_report_level_changed: run scene={}, level={}".format(scene.name, level))
     #if device_id == 13:
     try:
-        action = 'not specified'
         # action_list = device_action_dict[device_id]
         if abs(level - 51) < 10:
-            state_actions = scene.get_actions_by_state(str(51))
+            state = str(51)
         elif abs(level - 204) < 10:
-            state_actions = scene.get_actions_by_state(str(204))
+            state = str(204)
         else:
-            state_actions = scene.get_actions_by_state(str(level))
+            state = str(level)
+        state_actions = scene.get_actions_by_state(state)
         
         #action_list_for_state = action_list[str(state)]
-        for action in state_actions.actions:
-            logger.debug("action_on_report_level_changed level={} -> action={}".format(level, action))
-            try:
-                send_action_to_web_server(action.action_url)
-                time.sleep(action.actions_duration)
-            except:
-                logger.debug(f'action for {str(level)} not found, only have {state_actions.actions}')
+        scene_executor.submit(scene, state, state_actions.actions)
         return True
     except:
         logger.debug("action_on_report_level_changed failed: {}->{}".format(level, scene))
@@ -239,35 +388,21 @@ def snom_handle_airtemp(device_id, unit_id, cmd_id: int, cmd_name: str):
         # air quality to bad
         if unit_id == 1 and cmd_id == 1: 
             button = 'air1'
-            # thread start here
-            thread = snom_handle_airtemp_t(button, hf_scenes[2]) 
-            thread.start()
-            return True
+            return snom_handle_airtemp_t(button, hf_scenes[2])
         # temperature too high
         if unit_id == 2 and cmd_id == 1:
             button = "temp1"
-             # thread start here
-            thread = snom_handle_airtemp_t(button, hf_scenes[2]) 
-            thread.start()
-            return True
+            return snom_handle_airtemp_t(button, hf_scenes[2])
     else:
         logger.debug('button {}={} pressed'.format(cmd_id, cmd_name))
 
-@threaded.Threaded
 def snom_handle_airtemp_t(button: int, scene: HFScene):
     logger.debug("snom_handle_airtemp_t: run scene={}, button={}".format(scene.name, button))
     try:
-        action = 'not specified'
         # action_list = device_action_dict[device_id]
         state_actions = scene.get_actions_by_state(button)
 
-        for action in state_actions.actions:
-            logger.debug("snom_handle_airtemp_t button={} -> action={}".format(button, action))
-            try:
-                send_action_to_web_server(action.action_url)
-                time.sleep(action.actions_duration)
-            except:
-                logger.debug(f'action for {str(button)} not found, only have {state_actions.actions}')
+        scene_executor.submit(scene, button, state_actions.actions)
         return True
     except:
         logger.debug("snom_handle_airtemp_t failed: {}->{}".format(button, scene))
@@ -280,8 +415,9 @@ if __name__ == "__main__":
 
     snom_handle_window_open_close(3, 1)
     snom_handle_window_open_close(3, 0)
-    # wait until threads are done
+    # wait until the actions are done
     time.sleep(20.0)
+    print(scene_executor.stats())
     print('done')
     print(HTTP_ULE_ROOT)
     
\ No newline at end of file
@@ -16,6 +16,65 @@ HTML_URL = f'{ULE_URL}/htmlULE'
 XML_FILE_PATH = './'
 
 import urllib.parse
+import collections
+import threading
+
+
+class RenderCache(object):
+    """Rendered mini browser and HTML pages, served from memory.
+
+    A page is identified by a key, e.g. ('mini', dev_id, unit_id, interface_id, cmd_id),
+    and belongs to an owner (the HFDevice or HFDevices it shows) at a version. It is
+    rendered again when the owner object was replaced (registration, delete) or its
+    version changed (attribute or registration update), the old entry is overwritten.
+
+        page = render_cache.get(key, dev, dev.version, lambda: return_minibrowser_device(dev))
+
+    At most max_entries pages are kept, the least recently used is dropped.
+    """
+    def __init__(self, max_entries=2048):
+        self.max_entries = max_entries
+        # key -> (owner, version, page)
+        self._pages = collections.OrderedDict()
+        self._lock = threading.Lock()
+        self.hits = 0
+        self.misses = 0
+
+    def get(self, key, owner, version, render):
+        with self._lock:
+            entry = self._pages.get(key)
+            if entry is not None and entry[0] is owner and entry[1] == version:
+                self._pages.move_to_end(key)
+                self.hits += 1
+                return entry[2]
+            self.misses += 1
+        # render outside of the lock, a concurrent miss renders the same page twice at worst
+        page = render()
+        with self._lock:
+            self._pages[key] = (owner, version, page)
+            self._pages.move_to_end(key)
+            while len(self._pages) > self.max_entries:
+                self._pages.popitem(last=False)
+        return page
+
+    def clear(self):
+        with self._lock:
+            self._pages.clear()
+
+
+# pages of the gateway routes, cleared when the device table was rebuilt
+render_cache = RenderCache()
+
+# file name -> content last written by _write_xml
+_written_xml = {}
+
+def _write_xml(filename: str, text: str):
+    # rewrite the file only if the content changed
+    if _written_xml.get(filename) == text and os.path.exists(filename):
+        return
+    with open(filename, 'w') as file:
+        file.write(text)
+    _written_xml[filename] = text
 
 def return_minibrowser_cmd_payload_change(dev_id: int, i_id: int, u_id: int, c: HFC2SCommand, label: str, idx: int) -> str:
     c_txt = '<?xml version="1.0" encoding="UTF-8"?>\n'
@@ -69,13 +128,9 @@ def create_minibrowser_cmd_payload_change(dev: HFDevice, i: HFInterface, u: HFUn
     c_txt +=  '</InputItem>\n'
     c_txt += '</SnomIPPhoneInput>\n'
 
-    if c_txt != '':    
+    if write_xml and c_txt != '':    
         filename = f'{dev.device_id}_{u.unit_id}_{i.intrf_id}_{c.cmd_id}_{idx}.xml'
-        if os.path.exists(filename):
-            os.remove(filename)
-
-        with open(filename, 'w') as file:
-            file.write(c_txt)
+        _write_xml(filename, c_txt)
 
     return c_txt
 
@@ -158,11 +213,7 @@ def create_minibrowser_cmd_payload(dev: HFDevice, i: HFInterface, u: HFUnit, c:
         c_txt += '</SnomIPPhoneMenu>\n'
 
         filename = f'{dev.device_id}_{u.unit_id}_{i.intrf_id}_{c.cmd_id}.xml'
-        if os.path.exists(filename):
-            os.remove(filename)
-
-        with open(filename, 'w') as file:
-            file.write(c_txt)
+        _write_xml(filename, c_txt)
 
     return c_txt
 
@@ -378,11 +429,7 @@ def create_minibrowser_cmd(dev: HFDevice, i: HFInterface, u: HFUnit, filename: s
         c_txt +=  '</MenuItem>\n'
         c_txt += '</SnomIPPhoneMenu>\n'
     
-        if os.path.exists(filename):
-            os.remove(filename)
-
-        with open(filename, 'w') as file:
-            file.write(c_txt)
+        _write_xml(filename, c_txt)
 
     return c_txt
 
@@ -474,11 +521,7 @@ def create_minibrowser_device(dev: HFDevice) -> str:
         u_i_txt += '</SnomIPPhoneMenu>\n'
 
         filename = f'{XML_FILE_PATH}/{dev.device_id}.xml'
-        if os.path.exists(filename):
-            os.remove(filename)
-
-        with open(filename, 'w') as file:
-            file.write(u_i_txt)
+        _write_xml(filename, u_i_txt)
 
     return u_i_txt
 
@@ -548,11 +591,7 @@ def create_minibrowser_ULE(devices: HFDevices()) -> str:
     device_txt += '</SnomIPPhoneMenu>'
 
     filename = f'{XML_FILE_PATH}/ULE_devices.xml'
-    if os.path.exists(filename):
-        os.remove(filename)
-
-    with open(filename, 'w') as file:
-        file.write(device_txt)
+    _write_xml(filename, device_txt)
 
     return device_txt
 
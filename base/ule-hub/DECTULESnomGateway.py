@@ -9,7 +9,6 @@ import gevent
 import sys
 
 import logging
-import requests
 import paho.mqtt.client as mqtt
 
 import bottle
@@ -26,6 +25,8 @@ from bottle_utils.i18n import lazy_gettext as _
 from snom_HF_app import *
 # ??? remove
 from DECTULEMiniBrowser import *
+from mqtt_commands import Answered, CommandIngest, COMMAND_TOPIC, MSG_TYPE_GET_ATTRIBUTE
+from device_events import DeviceEvents
 
 template.settings = {
     "autoescape": True,
@@ -102,6 +103,14 @@ class PrettyFormsDict(FormsDict):
         return "{{\n{}\n}}".format(args)
 ## end helper
 
+def page_locale():
+    # HTML pages are rendered per language
+    return getattr(request, 'locale', None)
+
+def payload_version(command):
+    # command pages show the last values of the payload
+    return tuple(tuple(pd.attribute_values) for pd in command.payload_descriptions)
+
 
 # receives full list of DEVICES in json format DEVICES
 @bottle.route("/json_action", name="json_action", no_i18n=True, method=["GET", "POST"])
@@ -114,10 +123,7 @@ def run_json_action():
     beacon_action = True
     if beacon_action:
         try:
-            s = requests.Session()
-            s.mount("http://", requests.adapters.HTTPAdapter(max_retries=3))
-
-            r = s.get(request_url, timeout=1.0)
+            r = action_http.get(request_url, timeout=1.0)
             r_json = r.json()
             logger.debug("fire_action: %s, response=%s", request_url, r)
         except:
@@ -172,8 +178,9 @@ import shlex
 @bottle.route("/htmlULE", name='return_HTML_Devs', method=['GET'], no_i18n = True)
 def return_HTML_Devs():
     try: 
-        answer_tuple = return_ULE(hf_devices)
-        return bottle.jinja2_template('uledevicesview', title=_("DECT ULE Devices"), data=answer_tuple)
+        return render_cache.get(('html', page_locale()), hf_devices, hf_devices.version,
+                                lambda: bottle.jinja2_template('uledevicesview', title=_("DECT ULE Devices"),
+                                                               data=return_ULE(hf_devices)))
 
     except:
         logger.exception('Kaputt')
@@ -183,8 +190,9 @@ def return_HTML_Devs():
 def return_HTML_Dev(dev_id):
     try: 
         dev = hf_devices.get_device_by_id(int(dev_id))
-        answer_tuple = return_device(dev)
-        return bottle.jinja2_template('uledeviceview', title=_("DECT ULE Device Interfaces"), data=answer_tuple)
+        return render_cache.get(('html', page_locale(), dev.device_id), dev, dev.version,
+                                lambda: bottle.jinja2_template('uledeviceview', title=_("DECT ULE Device Interfaces"),
+                                                               data=return_device(dev)))
 
     except:
         return('return_HTML_Dev failed')
@@ -199,23 +207,11 @@ def return_HTLM_interface_status(dev_id, unit_id, interface_id):
 
         # iterate over number of server attributes 
         interface_t.get_attribute_by_id(1)
+        # read all server attributes from the interface, in-process: a request to our
+        # own snom_ule_cmd_nr page would take a server thread per attribute
+        # e.g. get attribute 1 -> snom_attrib_info 5 2 512 1
         for sa_id,sa in enumerate(interface_t.server_attributes):
-            # get server attributes from interface
-            # e.g. get attribute 1 -> snom_attrib_info 5 2 512 1  
-            url = f'{ULE_URL}/snom_ule_cmd_nr/snom_attrib_info'
-            url += f' {dev_id} {unit_id}'
-            url += f' {interface_id}'
-            url += f' {sa_id}'
-            try:
-                s = requests.Session()
-                s.mount("http://", requests.adapters.HTTPAdapter(max_retries=3))
-
-                r = s.get(url, timeout=5.0)
-                logger.debug("snom_attrib_info: %s, response=%s", url, r)
-                s.close()
-            except:
-                logger.debug("snom_attrib_info: cannot connect %s", url)
-                s.close()
+            snom_attrib_info(client_handle, ['snom_attrib_info', dev_id, unit_id, interface_id, str(sa_id)])
             # sometimes we already have new data
             print(f'Attribute {sa.attribute_id}: {sa.attribute_name} {sa.attribute_descriptions}={sa.attribute_values}')
 
@@ -234,8 +230,9 @@ def return_HTML_CMDs(dev_id, unit_id, interface_id):
         unit = dev.get_unit_by_id(int(unit_id))
 
         interface_t = unit.get_interface_by_id(int(interface_id))
-        answer_tuple = return_cmds(int(dev_id), int(unit_id), interface_t, unit.profile.profile_name)
-        return bottle.jinja2_template('ulecmdsview', title=_(f"Interface {interface_id} Commands"), data=answer_tuple)
+        return render_cache.get(('html', page_locale(), dev.device_id, unit.unit_id, interface_t.intrf_id), dev, dev.version,
+                                lambda: bottle.jinja2_template('ulecmdsview', title=_(f"Interface {interface_id} Commands"),
+                                                               data=return_cmds(int(dev_id), int(unit_id), interface_t, unit.profile.profile_name)))
 
     except:
         return('return_HTML_CMDs failed')
@@ -276,16 +273,11 @@ def return_HTML_CMD(dev_id, unit_id, interface_id, cmd_id):
         # values 
         value_string = " ".join(str(x) for x in payload_descrs.attribute_values)
         url += f' {value_string}'
-        try:
-            s = requests.Session()
-            s.mount("http://", requests.adapters.HTTPAdapter(max_retries=3))
-
-            r = s.get(url, timeout=5.0)
-            logger.debug("snom_set_cmd_attribute_value: %s, response=%s", url, r)
-            s.close()
-        except:
+        r = action_http.get(url, timeout=5.0)
+        if r is None:
             logger.debug("snom_set_cmd_attribute_value: cannot connect %s", url)
-            s.close()
+        else:
+            logger.debug("snom_set_cmd_attribute_value: %s, response=%s", url, r)
 
         # get the changed values in case DECT ULE answered already
         answer_tuple = return_cmd_options_payload(int(dev_id), interface_t.intrf_name, int(interface_t.intrf_id), int(unit_id),
@@ -299,9 +291,11 @@ def return_HTML_CMD(dev_id, unit_id, interface_id, cmd_id):
             
             interface_t = unit.get_interface_by_id(int(interface_id))
             command = interface_t.get_c2s_cmd_by_id(int(cmd_id))
-            answer_tuple = return_cmd_options_payload(int(dev_id), interface_t.intrf_name, int(interface_t.intrf_id), int(unit_id),
-                                          command)         
-            return bottle.jinja2_template('ulecmdpayloadview', title=_(f"Set command value"), data=answer_tuple)
+            return render_cache.get(('html', page_locale(), dev.device_id, unit.unit_id, interface_t.intrf_id, command.cmd_id),
+                                    dev, (dev.version, payload_version(command)),
+                                    lambda: bottle.jinja2_template('ulecmdpayloadview', title=_(f"Set command value"),
+                                                                   data=return_cmd_options_payload(int(dev_id), interface_t.intrf_name,
+                                                                                                   int(interface_t.intrf_id), int(unit_id), command)))
 
         except:
             '''answer_tuple = ({'DeviceID': 2, 'InterfaceName': 'Colour Control Interface', 'InterfaceId': 514, 'UnitID': 1, 'CName': 'MoveToHueAndSaturation', 'BackUrl': 'http://192.168.188.185:8881/htmlULE/2/1/514'}, [[(0, 'Hue 0-359', 32, 48, False, 0, 999)], [(0, 'Saturation', 24, 32, False, 255, 999)], [(0, 'Direction', 16, 24, False, 3, 999)], [(0, 'Direction Up = 0x01', 16, 18, False, 3, 1), (1, 'Direction Down = 0x02', 16, 18, False, 3, 2), (2, 'Direction Shortest Distance = 0x03', 16, 18, False, 3, 3), (3, 'Direction Longest Distance = 0x04', 16, 18, False, 3, 4)], [(0, 'Transition Time 100ms', 0, 16, False, 1, 999)]])
@@ -320,8 +314,8 @@ def return_HTML_CMD(dev_id, unit_id, interface_id, cmd_id):
 @bottle.route("/miniULE", name='return_XML_Devs', method=['GET'], no_i18n = True)
 def return_XML_Devs():
     try: 
-        answer = return_minibrowser_ULE(hf_devices)
-        return answer
+        return render_cache.get(('mini',), hf_devices, hf_devices.version,
+                                lambda: return_minibrowser_ULE(hf_devices))
     except:
         return('return_XML_Devs failed')
 
@@ -329,8 +323,8 @@ def return_XML_Devs():
 def return_XML_Dev(dev_id):
     try: 
         dev = hf_devices.get_device_by_id(int(dev_id))
-        answer = return_minibrowser_device(dev)
-        return answer
+        return render_cache.get(('mini', dev.device_id), dev, dev.version,
+                                lambda: return_minibrowser_device(dev))
     except:
         return('return_XML_Dev failed')
 
@@ -341,8 +335,8 @@ def return_XML_Mini_CMDs(dev_id, unit_id, interface_id):
         unit = dev.get_unit_by_id(int(unit_id))
 
         interface_t = unit.get_interface_by_id(int(interface_id))
-        answer = return_minibrowser_cmds(int(dev_id), int(unit_id), interface_t)
-        return answer
+        return render_cache.get(('mini', dev.device_id, unit.unit_id, interface_t.intrf_id), dev, dev.version,
+                                lambda: return_minibrowser_cmds(int(dev_id), int(unit_id), interface_t))
     except:
         return('return_XML_Mini_CMDs failed')
 
@@ -354,8 +348,8 @@ def return_XML_Mini_CMD(dev_id, unit_id, interface_id, cmd_id):
         
         interface_t = unit.get_interface_by_id(int(interface_id))
         command = interface_t.get_c2s_cmd_by_id(int(cmd_id))
-        answer = return_minibrowser_cmd_payload(int(dev_id), int(interface_id), int(unit_id), command)
-        return answer
+        return render_cache.get(('mini', dev.device_id, unit.unit_id, interface_t.intrf_id, command.cmd_id), dev, dev.version,
+                                lambda: return_minibrowser_cmd_payload(int(dev_id), int(interface_id), int(unit_id), command))
     except:
         return('return_XML_Mini_CMD failed')
 
@@ -370,8 +364,9 @@ def return_XML_Mini_Input(dev_id, unit_id, interface_id, cmd_id, idx):
         payload = command.payload_descriptions[0].attribute_descriptions[int(idx)]
         label = payload[0]
         #def return_minibrowser_cmd_payload_change(dev_id: int, i_id: int, u_id: int, c: HFC2SCommand, label: str, idx: int) -> str:
-        answer = return_minibrowser_cmd_payload_change(int(dev_id), int(interface_id), int(unit_id), command, label, idx)
-        return answer
+        return render_cache.get(('mini', dev.device_id, unit.unit_id, interface_t.intrf_id, command.cmd_id, int(idx)),
+                                dev, (dev.version, payload_version(command)),
+                                lambda: return_minibrowser_cmd_payload_change(int(dev_id), int(interface_id), int(unit_id), command, label, idx))
     except:
         return('return_XML_Mini_Input failed')
 
@@ -450,18 +445,105 @@ def run_main():
     return "nothing here."
 
 
+#####
+# commands from Home Assistant via MQTT
+#####
+def send_mqtt_command(command):
+    # sends the FUN_MSG only, returns the cookie without waiting for the device
+    def send():
+        return send_cmd(client_handle, command.device_id, command.unit_id, command.interface_id,
+                        command.msg_type, command.cmd_id, str(command.data, encoding='ISO-8859-1'))
+
+    if command.msg_type == MSG_TYPE_GET_ATTRIBUTE:
+        cookies = []
+        status, values = attribute_cache.lookup(
+            (command.device_id, command.unit_id, command.interface_id, command.cmd_id),
+            lambda key: cookies.append(send()), command.bypass)
+        if cookies:
+            return cookies[0]
+        # cached values are acked, a pending value is pushed to /events/ule when it arrives
+        return Answered(status, values)
+    return send()
+
+# acks are published by the MQTT publisher thread, not coalesced
+command_ingest = CommandIngest(send=send_mqtt_command, ack=mqttc.publish_ack)
+client_handle.subscribe("fun_msg_res", command_ingest.handle_fun_msg_res)
+mqttc.message_callback_add(COMMAND_TOPIC, command_ingest.on_message)
+mqttc.subscriptions.append(COMMAND_TOPIC)
+
+@bottle.route("/mqtt_commands/stats", name='mqtt_commands_stats', method=['GET'], no_i18n = True)
+def return_mqtt_command_stats():
+    return command_ingest.stats()
+
+# queue depth and action latency of the scenes (DECTULEAction)
+@bottle.route("/scenes/stats", name='scenes_stats', method=['GET'], no_i18n = True)
+def return_scene_stats():
+    return scene_executor.stats()
+
+# requests, retries and latency of the shared action HTTP client
+@bottle.route("/actions/http/stats", name='action_http_stats', method=['GET'], no_i18n = True)
+def return_action_http_stats():
+    return action_http.stats()
+
+
+#####
+# live device state, pushed to web views and phones
+#####
+# fed by the FUN_MSG handler through hf_devices.set_attribute_values
+device_events = DeviceEvents()
+hf_devices.add_listener(device_events.attribute_changed)
+
+def query_int(name, default=None):
+    value = request.query.get(name)
+    return int(value, 0) if value not in (None, '') else default
+
+def query_filter():
+    return dict(device_id=query_int('dev_id'), unit_id=query_int('unit_id'), interface_id=query_int('interface_id'))
+
+# server-sent events: /events/ule?dev_id=5&unit_id=1&interface_id=769
+@bottle.route("/events/ule", name='device_events_stream', method=['GET'], no_i18n = True)
+def return_device_events_stream():
+    try:
+        # EventSource sends the last id on reconnect
+        since = request.headers.get('Last-Event-ID') or request.query.get('since')
+        filters = query_filter()
+    except ValueError:
+        bottle.abort(400, 'dev_id, unit_id and interface_id must be numbers')
+    if not device_events.open_stream():
+        # every stream holds a server thread, keep some for the pages
+        bottle.abort(503, 'too many event streams, use /events/ule/poll')
+    bottle.response.content_type = 'text/event-stream'
+    bottle.response.set_header('Cache-Control', 'no-cache')
+    return device_events.stream(since, **filters)
+
+# long-poll: /events/ule/poll?since=3f9a0c1e-42&dev_id=5&timeout=25, returns {"id": .., "events": [..]}
+@bottle.route("/events/ule/poll", name='device_events_poll', method=['GET'], no_i18n = True)
+def return_device_events_poll():
+    try:
+        since = request.query.get('since')
+        timeout = min(float(request.query.get('timeout') or 25.0), 60.0)
+        filters = query_filter()
+    except ValueError:
+        bottle.abort(400, 'dev_id, unit_id, interface_id and timeout must be numbers')
+    last_id, events = device_events.wait(since, timeout=timeout, **filters)
+    bottle.response.set_header('Cache-Control', 'no-cache')
+    return {'id': last_id, 'events': events}
+
+
 def on_connect(client, userdata, flags, rc):
     print('MQTT connected', rc)
+    # (re)subscribe here, the subscription is lost with the session
+    client.subscribe(COMMAND_TOPIC)
 
 def on_subscribe(client, userdata, mid, granted_qos):
     print('topic subscribed', mid)
 
 def on_hanfun_message(client, obj, msg):
-    #print(client)
-    print('HAN-FUN Message:', msg.topic+" "+
-        str(msg.qos)+" "+
-        msg.payload.decode("utf-8") )
-    payload_str = msg.payload.decode("utf-8") 
+    # runs in the MQTT network loop, queue commands only
+    if mqtt.topic_matches_sub(COMMAND_TOPIC, msg.topic):
+        command_ingest.on_message(client, obj, msg)
+        return
+    logger.debug('HAN-FUN Message: %s %s %s', msg.topic, msg.qos, msg.payload)
 
 
 def on_log(client, userdata, level, buff):  # mqtt logs function
@@ -521,7 +603,8 @@ if __name__ == "__main__":
     # run web server
     HOST = "0.0.0.0"
     
-    bottle.run(app=app, server='waitress', threads=8, host=HOST, port=8881, reloader=False, debug=True, quiet=True)
+    # event streams hold a thread each (at most MAX_STREAMS), the rest serve the pages
+    bottle.run(app=app, server='waitress', threads=24, host=HOST, port=8881, reloader=False, debug=True, quiet=True)
 
     while True:
         gevent.sleep(0.1)
@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+#
+# SPDX-License-Identifier: MIT
+"""
+Shared HTTP client for scene actions and gateway requests.
+
+The scene actions call URLs of phones, relays and the KNX gateway. A new
+connection per request costs a TCP handshake each time and a sequence of
+actions went out one after another. This client keeps one requests.Session
+with keep-alive connection pools per host and sends from a small thread
+pool, so actions to several hosts run in parallel.
+
+Requests which could not connect are retried, limited by a retry budget:
+every request adds retry_ratio tokens, every retry takes one. Read timeouts
+and 5xx responses are retried only with retry_reads=True, the server may
+have acted on the request already and most actions switch something (a
+relay, a KNX group), which must not happen twice. A host that is down therefore causes at most retry_ratio extra
+requests per request instead of multiplying the load.
+
+    action_http = PooledHTTPClient()
+    future = action_http.get_async(url)           # returns at once
+    futures = action_http.fan_out([url1, url2])   # in parallel
+    response = action_http.get(url)               # blocks, None on failure
+    response = action_http.get(url, retry_reads=True)   # idempotent reads only
+"""
+
+import collections
+import logging
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+import requests
+
+
+# (connect, read) timeout in seconds
+TIMEOUT = (2.0, 5.0)
+# retries of one request, if the budget allows
+RETRIES = 2
+# retry tokens earned per request, and the most tokens kept
+RETRY_RATIO = 0.2
+RETRY_BUDGET_MAX = 10.0
+# pause before a retry, multiplied by the attempt number
+RETRY_BACKOFF = 0.1
+
+
+def connect_failed(error):
+    """True if the request failed before it reached the server."""
+    if isinstance(error, requests.exceptions.ConnectTimeout):
+        return True
+    # urllib3 reports a failed connect (refused, unreachable, DNS) as MaxRetryError
+    # with the reason; errors on an open connection, e.g. a reset after the request
+    # was sent, are passed on as they are
+    return isinstance(error, requests.exceptions.ConnectionError) and \
+        bool(error.args) and hasattr(error.args[0], 'reason')
+
+
+class RetryBudget(object):
+    """Token bucket limiting retries to a share of the requests."""
+
+    def __init__(self, ratio=RETRY_RATIO, maximum=RETRY_BUDGET_MAX):
+        self.ratio = ratio
+        self.maximum = maximum
+        self._tokens = maximum
+        self._lock = threading.Lock()
+
+    def deposit(self):
+        with self._lock:
+            self._tokens = min(self.maximum, self._tokens + self.ratio)
+
+    def withdraw(self):
+        with self._lock:
+            if self._tokens < 1.0:
+                return False
+            self._tokens -= 1.0
+            return True
+
+
+class PooledHTTPClient(object):
+    """Keep-alive HTTP GET with per-host pools, timeouts and a retry budget."""
+
+    def __init__(self, workers=8, pool_maxsize=4, timeout=TIMEOUT, retries=RETRIES, budget=None):
+        self.timeout = timeout
+        self.retries = retries
+        self.budget = budget or RetryBudget()
+        self._session = requests.Session()
+        # pool_connections hosts are kept, each with up to pool_maxsize connections;
+        # retries are done here, within the budget
+        adapter = requests.adapters.HTTPAdapter(pool_connections=16, pool_maxsize=pool_maxsize, max_retries=0)
+        self._session.mount("http://", adapter)
+        self._session.mount("https://", adapter)
+        self._executor = ThreadPoolExecutor(max_workers=workers, thread_name_prefix='action-http')
+
+        self.counters = collections.Counter()
+        self._latencies = collections.deque(maxlen=1024)
+        self._lock = threading.Lock()
+
+    def get(self, url, timeout=None, retry_reads=False):
+        """GET url and return the response, None if it failed after the retries.
+
+        Only failed connects are retried; read timeouts and 5xx as well
+        if retry_reads is set. A 5xx which is not retried returns None."""
+        self.budget.deposit()
+        timeout = timeout or self.timeout
+        attempt = 0
+        start = time.monotonic()
+        while True:
+            try:
+                response = self._session.get(url, timeout=timeout)
+                if response.status_code < 500:
+                    self._count('ok', start)
+                    return response
+                error = 'HTTP {}'.format(response.status_code)
+                retry = retry_reads
+            except (requests.exceptions.ConnectionError, requests.exceptions.Timeout) as e:
+                error = e
+                retry = retry_reads or connect_failed(e)
+            except Exception:
+                logging.exception("GET %s failed", url)
+                self._count('failed', start)
+                return None
+            if not retry or attempt >= self.retries or not self.budget.withdraw():
+                logging.warning("GET %s failed: %s", url, error)
+                self._count('failed', start)
+                return None
+            attempt += 1
+            with self._lock:
+                self.counters['retries'] += 1
+            time.sleep(RETRY_BACKOFF * attempt)
+
+    def get_async(self, url, timeout=None, retry_reads=False):
+        """Send GET url from the pool, returns a Future of the response (or None)."""
+        return self._executor.submit(self.get, url, timeout, retry_reads)
+
+    def fan_out(self, urls, timeout=None, retry_reads=False):
+        """Send all urls in parallel, returns their Futures in order."""
+        return [self.get_async(url, timeout, retry_reads) for url in urls]
+
+    def stats(self):
+        with self._lock:
+            latencies = sorted(self._latencies)
+            stats = dict(self.counters)
+        for pct in (50, 99):
+            stats['p{}_ms'.format(pct)] = round(latencies[min(len(latencies) - 1, len(latencies) * pct // 100)] * 1000, 3) \
+                if latencies else None
+        return stats
+
+    def close(self):
+        self._executor.shutdown(wait=True)
+        self._session.close()
+
+    def _count(self, result, start):
+        with self._lock:
+            self.counters[result] += 1
+            self._latencies.append(time.monotonic() - start)
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+#
+# SPDX-License-Identifier: MIT
+"""
+Read-through cache of server attribute values.
+
+Reading an attribute (get attribute, MSGTYPE 4) wakes the device and costs
+air time, battery powered nodes pay for every request. Reports and get
+attribute responses already carry the values: HFDevices.set_attribute_values
+stores them and the cache records when each (device, unit, interface,
+attribute) was last received.
+
+A read within the TTL of the attribute is answered from the cache. A read of
+a missing or expired value sends one request; further reads of the same
+attribute do not send again while the request is outstanding. bypass=True
+always sends.
+
+    cache = AttributeCache()
+    hf_devices.add_listener(cache.attribute_updated, changes_only=False)
+    cache.set_ttl(0x0301, 1, 300)      # Simple Temperature, reported every 5 min
+    values = cache.read((dev, unit, interface, attribute), send_request)
+    status, values = cache.lookup((dev, unit, interface, attribute), send_request)
+"""
+
+import threading
+import time
+
+
+# seconds a received value is served without asking the device again
+DEFAULT_TTL = 60.0
+# seconds a request is outstanding, no further request is sent before
+REQUEST_TIMEOUT = 5.0
+
+# status of lookup(): answered from the cache, request outstanding, request sent
+CACHED = "cached"
+PENDING = "pending"
+REQUESTED = "requested"
+
+
+class AttributeCache(object):
+    """Received attribute values by (device_id, unit_id, interface_id, attribute_id)."""
+
+    def __init__(self, default_ttl=DEFAULT_TTL, request_timeout=REQUEST_TIMEOUT):
+        self.default_ttl = default_ttl
+        self.request_timeout = request_timeout
+        # (interface_id, attribute_id) or (interface_id, None) -> ttl
+        self._ttls = {}
+        # key -> (time received, values)
+        self._entries = {}
+        # key -> time requested
+        self._requested = {}
+        self._lock = threading.Lock()
+
+        self.hits = 0
+        self.misses = 0
+        self.requests = 0
+
+    def set_ttl(self, interface_id, attribute_id, ttl):
+        """TTL of one attribute, or of all attributes of the interface with attribute_id None."""
+        self._ttls[(interface_id, attribute_id)] = ttl
+
+    def ttl(self, interface_id, attribute_id):
+        ttl = self._ttls.get((interface_id, attribute_id))
+        if ttl is None:
+            ttl = self._ttls.get((interface_id, None), self.default_ttl)
+        return ttl
+
+    def attribute_updated(self, dev, unit_id, interface_id, attribute):
+        """HFDevices listener (changes_only=False), called for every received value."""
+        self.put((dev.device_id, unit_id, interface_id, attribute.attribute_id), attribute.attribute_values)
+
+    def put(self, key, values, now=None):
+        with self._lock:
+            self._entries[key] = (time.monotonic() if now is None else now, list(values))
+            self._requested.pop(key, None)
+
+    def get(self, key, now=None):
+        """Values of key if received within its TTL, else None."""
+        now = time.monotonic() if now is None else now
+        with self._lock:
+            entry = self._entries.get(key)
+        if entry is None or now - entry[0] > self.ttl(key[2], key[3]):
+            return None
+        return entry[1]
+
+    def read(self, key, request, bypass=False):
+        """Return the cached values of key, or call request(key) and return None.
+
+        The response fills the cache through attribute_updated."""
+        return self.lookup(key, request, bypass)[1]
+
+    def lookup(self, key, request, bypass=False):
+        """Like read(), returns (CACHED, values), (PENDING, None) if a request of key is
+        outstanding, or (REQUESTED, None) after calling request(key)."""
+        now = time.monotonic()
+        values = None if bypass else self.get(key, now)
+        if values is not None:
+            self.hits += 1
+            return CACHED, values
+        self.misses += 1
+        with self._lock:
+            requested = self._requested.get(key)
+            if not bypass and requested is not None and now - requested < self.request_timeout:
+                return PENDING, None
+            self._requested[key] = now
+        self.requests += 1
+        request(key)
+        return REQUESTED, None
+
+    def invalidate(self, device_id=None):
+        """Forget the values of one device (e.g. deleted or re-registered), or of all."""
+        with self._lock:
+            for entries in (self._entries, self._requested):
+                for key in [key for key in entries if device_id is None or key[0] == device_id]:
+                    del entries[key]
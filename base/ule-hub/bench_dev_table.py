@@ -0,0 +1,88 @@
+#!/usr/bin/env python
+#
+# SPDX-License-Identifier: MIT
+"""Measure device table retrieval against the local HAN server simulator.
+
+Usage:
+    python bench_dev_table.py [--devices 50 200 500] [--latency 0.01] [--max-page 32]
+
+For each table size the following are timed:
+    serial      get_dev_table with 5 devices per request, one request at a time
+                (as done by list_devices of the apps before)
+    full        HANClient.get_full_dev_table
+    snapshot    HANClient.get_dev_snapshot without known devices (DEV_INFO for all)
+    unchanged   HANClient.get_dev_snapshot with the previous snapshot (table only)
+"""
+
+from __future__ import print_function
+
+import argparse
+import time
+
+import han_client
+from han_server_sim import HANServerSim
+
+
+def serial_dev_table(client):
+    devices = []
+    index = 0
+    count = han_client.DEV_TABLE_COUNT
+    while True:
+        resp = client.get_dev_table(index=index, count=count)
+        devices += resp.devices
+        if len(resp.devices) < count:
+            return devices
+        index += count
+
+
+def timed(sim, func):
+    requests = sum(sim.requests.values())
+    start = time.monotonic()
+    result = func()
+    return result, time.monotonic() - start, sum(sim.requests.values()) - requests
+
+
+def run(num_devices, latency, max_page):
+    sim = HANServerSim(devices=num_devices, latency=latency, max_page=max_page).start()
+    client = han_client.HANClient(port=sim.port)
+    client.start()
+    try:
+        results = []
+        devices, duration, requests = timed(sim, lambda: serial_dev_table(client))
+        assert len(devices) == num_devices
+        results.append(("serial", duration, requests))
+
+        devices, duration, requests = timed(sim, client.get_full_dev_table)
+        assert len(devices) == num_devices
+        results.append(("full", duration, requests))
+
+        snapshot, duration, requests = timed(sim, client.get_dev_snapshot)
+        assert len(snapshot) == num_devices
+        results.append(("snapshot", duration, requests))
+
+        known = {dev.id: dev for dev in snapshot}
+        snapshot, duration, requests = timed(sim, lambda: client.get_dev_snapshot(known))
+        assert len(snapshot) == num_devices
+        results.append(("unchanged", duration, requests))
+        return results
+    finally:
+        client.destroy()
+        sim.stop()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--devices", type=int, nargs="+", default=[50, 200, 500])
+    parser.add_argument("--latency", type=float, default=0.01, help="response delay in seconds")
+    parser.add_argument("--max-page", type=int, default=32, help="devices per DEV_TABLE response")
+    args = parser.parse_args()
+
+    print("latency {:.0f} ms, max page {}".format(args.latency * 1000, args.max_page))
+    for num_devices in args.devices:
+        for name, duration, requests in run(num_devices, args.latency, args.max_page):
+            print("{:5d} devices  {:10s} {:8.3f} s  {:5d} requests".format(
+                num_devices, name, duration, requests))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,148 @@
+#!/usr/bin/env python
+#
+# SPDX-License-Identifier: MIT
+"""Replay HAN server traffic through the han_client message parser.
+
+Usage:
+    python bench_han_client.py [capture.txt ...]
+
+A capture file holds received HAN server messages as printed by the HAN client debug output
+(HANClient.set_debug_printing(1)); messages are separated by empty lines, lines starting with
+"HAN Client" are ignored. Without a capture, the messages of test_han_client.py are replayed.
+
+The parser of han_client.Message is compared to the former implementation (subclass scan and
+two-pass parameter split), which is kept below for reference only. The class lookup by message
+name is also timed on its own: the full parse includes the subclass specific parsing (e.g.
+decoding FUN_MSG DATA), which both implementations share.
+"""
+
+from __future__ import print_function
+
+import sys
+import timeit
+
+from han_client import EOL, PARAM_DELIM, Message
+
+
+def load_capture(path):
+    with open(path) as f:
+        text = f.read().replace("\r\n", "\n")
+
+    messages = []
+    for block in text.split("\n\n"):
+        lines = [line for line in block.split("\n") if line and not line.startswith("HAN Client")]
+        if lines:
+            messages.append(EOL.join(lines) + EOL + EOL)
+    return messages
+
+
+def sample_messages():
+    import test_han_client as t
+    return [t.FUN_MSG_MESSAGE] * 20 + [
+        t.INIT_RESPONSE,
+        t.OPEN_REG_RESPONSE,
+        t.DEV_INFO_PHASE_2_RESPONSE,
+        t.DEV_TABLE_PHASE_2_RESPONSE,
+        t.GET_TARGET_HW_VERSION_RESPONSE,
+    ]
+
+
+def legacy_camelcase(str):
+    str = str.lower()
+    str = str[0].upper() + str[1:]
+
+    while True:
+        pos = str.find("_")
+        if pos == -1:
+            break
+        str = str[:pos] + str[pos+1].upper() + str[pos+2:]
+
+    return str
+
+
+def legacy_class(msgname):
+    """Former class lookup of Message.__new__"""
+    clsname = legacy_camelcase(msgname) + "Message"
+    for subclass in Message.__subclasses__():
+        if subclass.__name__ == clsname:
+            return subclass
+    return Message
+
+
+def legacy_parse(data):
+    """Former Message.__new__ and Message._parse_data"""
+    msgname, _ = data.split(EOL, 1)
+    cls = legacy_class(msgname)
+
+    msg = object.__new__(cls)
+    msg.service = None
+
+    data = data.strip()
+    first, rest = data.split(EOL, 1)
+    if first.startswith("["):
+        msg.service = first
+        msg.name, params = rest.split(EOL, 1)
+    else:
+        msg.name = first
+        params = rest
+
+    msg._params = []
+    for param in params.split(EOL):
+        param = param.strip()
+        try:
+            key, value = param.split(PARAM_DELIM)
+            value = value.strip()
+        except ValueError:
+            key, value = param, True
+        msg._params.append((key, value))
+
+    if cls is Message:
+        msg.params = {}
+        for key, value in msg._params:
+            msg.params[key] = value
+    else:
+        # subclass specific parsing is shared with the current implementation
+        msg._parse_params()
+    return msg
+
+
+def current_parse(data):
+    return Message(data)
+
+
+def rates(parsers, messages, repeat):
+    """Messages per second of each parser, best of repeat runs, runs are interleaved"""
+    best = [None] * len(parsers)
+    for _ in range(repeat):
+        for i, parse in enumerate(parsers):
+            duration = timeit.timeit(lambda: [parse(m) for m in messages], number=1)
+            if best[i] is None or duration < best[i]:
+                best[i] = duration
+    return [len(messages) / duration for duration in best]
+
+
+def main(argv):
+    messages = []
+    for path in argv[1:]:
+        messages += load_capture(path)
+    if not messages:
+        messages = sample_messages()
+
+    # make the replay long enough for stable numbers
+    messages = messages * max(1, 20000 // len(messages))
+
+    before, after = rates([legacy_parse, current_parse], messages, 10)
+    names = [Message._split_data(m)[1] for m in messages]
+    lookup_before, lookup_after = rates([legacy_class, Message._class_for], names, 10)
+
+    print("messages:      {}".format(len(messages)))
+    print("parse before:  {:10.0f} msg/s".format(before))
+    print("parse after:   {:10.0f} msg/s".format(after))
+    print("speedup:       {:10.2f}x".format(after / before))
+    print("class before:  {:10.0f} msg/s".format(lookup_before))
+    print("class after:   {:10.0f} msg/s".format(lookup_after))
+    print("speedup:       {:10.2f}x".format(lookup_after / lookup_before))
+
+
+if __name__ == "__main__":
+    main(sys.argv)
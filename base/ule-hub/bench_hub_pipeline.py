@@ -0,0 +1,151 @@
+#!/usr/bin/env python
+#
+# SPDX-License-Identifier: MIT
+"""Measure report latency and throughput of the hub against the local HAN server simulator.
+
+Usage:
+    python bench_hub_pipeline.py [--devices 100] [--motion-detectors 25] [--rates 100 1000 ...]
+                                 [--duration 3] [--jitter 0] [--loss 0] [--max-p99 0.05]
+
+The simulator is started on the HAN server port before snom_HF_app is imported, so the HANClient
+of the app connects to it and the FUN_MSG handler of the app (snom_handle_fun_msg) handles every
+report: temperature reports update HFDevices, the Alert status commands of the motion detectors
+run the server command and publish the state to Home Assistant. The MQTT publisher of the app
+sends to a stub transport which counts the messages instead of a broker. The latency is measured
+from sending the datagram in the simulator to the return of the handler of the app, MQTT
+messages are counted per rate, they are sent after the coalescing window of the publisher.
+
+Rates are total reports per second over all devices. A rate is sustainable if all reports
+which were sent are handled and the p99 latency stays below --max-p99. The simulator runs in
+the same process, so the maximum rate found is a lower bound for the hub alone. The output of
+the app goes to /dev/null.
+"""
+
+from __future__ import print_function
+
+import argparse
+import contextlib
+import importlib
+import os
+import tempfile
+import threading
+import time
+
+from han_server_sim import HANServerSim
+from snom_sss_mqtt_hassio import CoalescingPublisher
+
+
+class StubTransport(object):
+    """Takes the place of the MQTT broker connection, counts the published messages."""
+
+    def __init__(self):
+        self.published = 0
+
+    def publish(self, topic, payload):
+        self.published += 1
+
+
+class LatencyRecorder(object):
+    """FUN_MSG subscriber after the handler of the app, records the latency of every report."""
+
+    def __init__(self, sim):
+        self.sim = sim
+        self.latencies = []
+        self.lock = threading.Lock()
+
+    def handle_fun_msg(self, client, msg):
+        done = time.monotonic()
+        sent = self.sim.sent_reports.pop((msg.src_dev_id, msg.msg_seq), None)
+        if sent is not None:
+            with self.lock:
+                self.latencies.append(done - sent)
+
+    def reset(self):
+        with self.lock:
+            latencies, self.latencies = self.latencies, []
+        return latencies
+
+
+def load_app(window):
+    """Import snom_HF_app with its MQTT publisher on a stub transport and read the device table."""
+    import DECTULEMiniBrowser
+    # the app writes its minibrowser pages on every device table update
+    DECTULEMiniBrowser.XML_FILE_PATH = tempfile.mkdtemp(prefix="bench_hub_")
+
+    app = importlib.import_module("snom_HF_app")
+    transport = StubTransport()
+    app.mqttc.publisher.stop()
+    app.mqttc.publisher = CoalescingPublisher(transport.publish, window=window)
+    app.open_device_store(":memory:")
+    app.list_devices(app.client_handle, "")
+    return app, transport
+
+
+def percentile(values, pct):
+    if not values:
+        return float("nan")
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * pct / 100.0))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--devices", type=int, default=100)
+    parser.add_argument("--motion-detectors", type=int, default=25,
+                        help="devices sending Alert status commands, published to MQTT")
+    parser.add_argument("--rates", type=float, nargs="+", default=[100, 500, 1000, 2000, 4000, 8000, 16000])
+    parser.add_argument("--duration", type=float, default=3.0, help="seconds per rate")
+    parser.add_argument("--jitter", type=float, default=0.0, help="random report delay in seconds")
+    parser.add_argument("--loss", type=float, default=0.0, help="probability of lost reports")
+    parser.add_argument("--max-p99", type=float, default=0.05, help="p99 latency limit in seconds")
+    parser.add_argument("--window", type=float, default=0.1, help="MQTT coalescing window in seconds")
+    args = parser.parse_args()
+
+    # the app connects to the default HAN server address when it is imported
+    sim = HANServerSim(devices=args.devices, port=3490, jitter=args.jitter,
+                       motion_detectors=args.motion_detectors).start()
+    devnull = open(os.devnull, "w")
+    with contextlib.redirect_stdout(devnull):
+        app, transport = load_app(args.window)
+    # loss is applied to the reports only, the device table must be complete
+    sim.loss = args.loss
+
+    recorder = LatencyRecorder(sim)
+    app.client_handle.subscribe("fun_msg", recorder.handle_fun_msg)
+
+    print("{} devices ({} motion detectors), jitter {:.0f} ms, loss {:.1%}, MQTT window {:.0f} ms".format(
+        args.devices, args.motion_detectors, args.jitter * 1000, args.loss, args.window * 1000))
+    print("{:>10s} {:>10s} {:>10s} {:>10s} {:>10s} {:>10s}".format(
+        "rate/s", "handled/s", "p50 ms", "p99 ms", "lost", "mqtt/s"))
+
+    sustainable = 0
+    for rate in args.rates:
+        sent_before = sim.reports_sent
+        published_before = transport.published
+        with contextlib.redirect_stdout(devnull):
+            sim.run_reports(rate / args.devices, args.duration)
+            # let the queues drain
+            time.sleep(max(0.5, args.jitter * 2))
+            app.mqttc.publisher.flush(timeout=1.0)
+        sent = sim.reports_sent - sent_before
+        published = transport.published - published_before
+        latencies = recorder.reset()
+        # reports not handled, lost in the socket buffers or still queued
+        lost = sent - len(latencies)
+        sim.sent_reports.clear()
+
+        p50 = percentile(latencies, 50)
+        p99 = percentile(latencies, 99)
+        print("{:10.0f} {:10.0f} {:10.2f} {:10.2f} {:10d} {:10.0f}".format(
+            rate, len(latencies) / args.duration, p50 * 1000, p99 * 1000, lost, published / args.duration))
+        if lost == 0 and p99 < args.max_p99:
+            sustainable = max(sustainable, rate)
+
+    print("max sustainable rate: {:.0f} reports/s".format(sustainable))
+    app.mqttc.publisher.stop()
+    app.client_handle.destroy()
+    sim.stop()
+
+
+if __name__ == "__main__":
+    main()
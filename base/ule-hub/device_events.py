@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+#
+# SPDX-License-Identifier: MIT
+"""
+Live device state for push clients of the gateway.
+
+Every attribute change made by HFDevices.set_attribute_values (reports and
+get attribute responses handled by the FUN_MSG handler) becomes an event:
+
+    {"id": "3f9a0c1e-42", "seq": 42, "time": 1700000000.1, "device_id": 5, "unit_id": 1, "interface_id": 769,
+     "attribute_id": 1, "attribute_name": "Measured Temperature", "values": [8, 52],
+     "decoded": {"Measured Temperature": 2100}}
+
+Clients read the events as server-sent events or by long-poll, filtered by
+device, unit and interface. A client passes the id of the last event it
+has seen, "<epoch>-<seq>" with an epoch new for every gateway process. A
+client which is too far behind, new (no id) or has an id of another epoch (the
+gateway was restarted) gets the current state of every attribute first. No
+client request causes HAN traffic.
+"""
+
+import binascii
+import collections
+import json
+import os
+import threading
+import time
+
+
+# events kept for clients catching up
+HISTORY = 1024
+# concurrent event streams, each one holds a web server thread
+MAX_STREAMS = 16
+# seconds between SSE comments keeping idle connections open
+KEEPALIVE = 15.0
+
+
+def _matches(event, device_id, unit_id, interface_id):
+    return ((device_id is None or event["device_id"] == device_id)
+            and (unit_id is None or event["unit_id"] == unit_id)
+            and (interface_id is None or event["interface_id"] == interface_id))
+
+
+class DeviceEvents(object):
+    """Attribute change events of HFDevices.
+
+    Usage:
+
+        events = DeviceEvents()
+        hf_devices.add_listener(events.attribute_changed)
+
+        last_id, changes = events.wait(since=None, device_id=5, timeout=25)   # long-poll
+        for chunk in events.stream(since=last_id, device_id=5): ...          # SSE
+    """
+
+    def __init__(self, history=HISTORY, max_streams=MAX_STREAMS):
+        self.max_streams = max_streams
+        # seqs restart with the process, ids of an earlier one are not taken
+        self.epoch = binascii.hexlify(os.urandom(4)).decode("ascii")
+        self._history = collections.deque(maxlen=history)
+        # (device, unit, interface, attribute) -> last event
+        self._state = {}
+        self._seq = 0
+        self._streams = 0
+        self._run = True
+        self._cond = threading.Condition()
+
+    @property
+    def seq(self):
+        return self._seq
+
+    def event_id(self, seq):
+        return "{}-{}".format(self.epoch, seq)
+
+    def _parse_id(self, event_id):
+        # seq of an id of this epoch, None for no id, other epochs and ids not understood
+        epoch, _, seq = str(event_id or "").partition("-")
+        if epoch != self.epoch or not seq.isdigit():
+            return None
+        return int(seq)
+
+    def attribute_changed(self, dev, unit_id, interface_id, attribute):
+        """HFDevices listener, called from the HAN client rx thread."""
+        event = {
+            "time": time.time(),
+            "device_id": dev.device_id,
+            "unit_id": unit_id,
+            "interface_id": interface_id,
+            "attribute_id": attribute.attribute_id,
+            "attribute_name": attribute.attribute_name,
+            "values": list(attribute.attribute_values),
+            "decoded": attribute.get_decoded_values(),
+        }
+        with self._cond:
+            self._seq += 1
+            event["seq"] = self._seq
+            event["id"] = self.event_id(self._seq)
+            self._history.append(event)
+            self._state[(dev.device_id, unit_id, interface_id, attribute.attribute_id)] = event
+            self._cond.notify_all()
+
+    def stop(self):
+        with self._cond:
+            self._run = False
+            self._cond.notify_all()
+
+    def _since(self, since, device_id, unit_id, interface_id):
+        # called with the lock held
+        if (since is None or since <= 0 or since > self._seq
+                or not self._history or self._history[0]["seq"] > since + 1):
+            # new client or missed events, the current state replaces them
+            events = self._state.values()
+        else:
+            events = (event for event in self._history if event["seq"] > since)
+        events = [event for event in events if _matches(event, device_id, unit_id, interface_id)]
+        events.sort(key=lambda event: event["seq"])
+        return events
+
+    def wait(self, since=None, device_id=None, unit_id=None, interface_id=None, timeout=25.0):
+        """Return (id, events) after the event id since, waits up to timeout seconds for a
+        matching event.
+
+        id is the value to pass as since in the next call."""
+        deadline = time.monotonic() + timeout
+        since = self._parse_id(since)
+        with self._cond:
+            while True:
+                events = self._since(since, device_id, unit_id, interface_id)
+                remaining = deadline - time.monotonic()
+                if events or remaining <= 0 or not self._run:
+                    return self.event_id(self._seq), events
+                # the next call starts from here, events of other devices are skipped
+                since = self._seq
+                self._cond.wait(remaining)
+
+    def open_stream(self):
+        """Reserve a stream, False if max_streams are open."""
+        with self._cond:
+            if self._streams >= self.max_streams:
+                return False
+            self._streams += 1
+            return True
+
+    def stream(self, since=None, device_id=None, unit_id=None, interface_id=None, keepalive=KEEPALIVE):
+        """Generator of server-sent event text, for a stream reserved by open_stream()."""
+        try:
+            # the client reconnects after 3 s and sends the last id as Last-Event-ID
+            yield "retry: 3000\n\n"
+            while self._run:
+                since, events = self.wait(since, device_id, unit_id, interface_id, keepalive)
+                if not events:
+                    yield ": keepalive\n\n"
+                for event in events:
+                    yield "id: {}\nevent: attribute\ndata: {}\n\n".format(event["id"], json.dumps(event))
+        finally:
+            with self._cond:
+                self._streams -= 1
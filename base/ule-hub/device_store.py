@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+#
+# SPDX-License-Identifier: MIT
+"""
+Persistent copy of the HAN server device table.
+
+The apps rebuild their device list from DEV_TABLE at startup, which takes one
+round trip per 5 devices plus the profile setup per device. The store keeps
+the last known table in a SQLite database (WAL journal, one row per device),
+so the apps start from it and reconcile with the HAN server afterwards.
+
+Rows are written on every change: DEV_REGISTERED, delete and the full table
+fetched during reconciliation. The devices are stored as they were parsed by
+han_client.DevTableParser and loaded back as the same objects.
+"""
+
+import json
+import logging
+import sqlite3
+import threading
+
+import han_client
+
+
+DEFAULT_PATH = "han_devices.db"
+
+
+class DeviceStore(object):
+    """Device table in SQLite, safe to use from the HAN client rx thread.
+
+    Usage:
+
+        store = DeviceStore("han_devices.db")
+        devices = store.load()      # list of DevTableParser.Device
+        store.put(device)           # DEV_REGISTERED
+        store.delete(device_id)     # device deleted
+        store.replace_all(devices)  # full DEV_TABLE, returns True if changed
+    """
+
+    def __init__(self, path=DEFAULT_PATH):
+        self._lock = threading.Lock()
+        self._db = sqlite3.connect(path, check_same_thread=False)
+        # WAL keeps the last committed table readable after a crash, NORMAL
+        # sync is enough for WAL and avoids an fsync per registration
+        self._db.execute("PRAGMA journal_mode=WAL")
+        self._db.execute("PRAGMA synchronous=NORMAL")
+        self._db.execute("CREATE TABLE IF NOT EXISTS devices ("
+                         "id INTEGER PRIMARY KEY, "
+                         "data TEXT NOT NULL)")
+        self._db.commit()
+
+    def close(self):
+        with self._lock:
+            self._db.close()
+
+    def load(self):
+        """Return the stored devices ordered by device id."""
+        with self._lock:
+            rows = self._db.execute("SELECT data FROM devices ORDER BY id").fetchall()
+        devices = []
+        for (data,) in rows:
+            try:
+                devices.append(_decode_device(data))
+            except (ValueError, KeyError, TypeError):
+                logging.exception("skip unreadable device entry %s", data)
+        return devices
+
+    def put(self, device):
+        with self._lock, self._db:
+            self._db.execute("INSERT OR REPLACE INTO devices (id, data) VALUES (?, ?)",
+                             (device.id, _encode_device(device)))
+
+    def delete(self, device_id):
+        with self._lock, self._db:
+            self._db.execute("DELETE FROM devices WHERE id = ?", (int(device_id),))
+
+    def replace_all(self, devices):
+        """Make the store equal to devices in one transaction.
+
+        Only changed rows are written. Returns True if anything changed.
+        """
+        wanted = {device.id: _encode_device(device) for device in devices}
+        with self._lock, self._db:
+            stored = dict(self._db.execute("SELECT id, data FROM devices"))
+            removed = [(device_id,) for device_id in stored if device_id not in wanted]
+            changed = [(device_id, data) for device_id, data in wanted.items()
+                       if stored.get(device_id) != data]
+            self._db.executemany("DELETE FROM devices WHERE id = ?", removed)
+            self._db.executemany("INSERT OR REPLACE INTO devices (id, data) VALUES (?, ?)", changed)
+        return bool(removed or changed)
+
+
+def _fields(obj):
+    return {key: value for key, value in vars(obj).items()
+            if key not in ("units", "interfaces")}
+
+
+def _encode_device(device):
+    data = _fields(device)
+    data["units"] = [dict(_fields(unit), interfaces=[_fields(intrf) for intrf in unit.interfaces])
+                     for unit in device.units]
+    return json.dumps(data, sort_keys=True)
+
+
+def _make(cls, fields):
+    obj = cls()
+    for key, value in fields.items():
+        setattr(obj, key, value)
+    return obj
+
+
+def _decode_device(text):
+    data = json.loads(text)
+    units = data.pop("units")
+    device = _make(han_client.DevTableParser.Device, data)
+    device.units = []
+    for unit_data in units:
+        interfaces = unit_data.pop("interfaces")
+        unit = _make(han_client.DevTableParser.Unit, unit_data)
+        unit.interfaces = [_make(han_client.DevTableParser.Interface, intrf) for intrf in interfaces]
+        device.units.append(unit)
+    return device
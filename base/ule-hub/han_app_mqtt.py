@@ -18,6 +18,9 @@ from prompt_toolkit.contrib.completers import WordCompleter
  
 import han_client
 import _thread
+import threading
+from device_store import DeviceStore
+from attribute_cache import AttributeCache
 
 import logging
 import copy
@@ -48,6 +51,10 @@ def process_rx_data(client, data_str):
 def handle_dev_registered(client, msg):
     device_id = int(msg.params["DEV_ID"])
     log("Device {}: registered (or registration updated)".format(device_id))
+    # the units may have changed, read the values again
+    attribute_cache.invalidate(device_id)
+    # requests to the HAN server cannot be made from the rx thread
+    threading.Thread(target=reconcile_devices, args=(client,), daemon=True).start()
 
 
 def handle_reg_closed(client, msg):
@@ -56,9 +63,9 @@ def handle_reg_closed(client, msg):
 
 
 def handle_fun_msg(client, msg):
-    device_id = int(msg.params["SRC_DEV_ID"])
-    unit_id = int(msg.params["SRC_UNIT_ID"])
-    interface_id = int(msg.params["INTRF_ID"])
+    device_id = msg.src_dev_id
+    unit_id = msg.src_unit_id
+    interface_id = msg.interface_id
 
     if unit_id == 0 and interface_id == 0x0115:
         # device management unit, keep-alive interface
@@ -280,6 +287,17 @@ FUN_MSG
 #
 
 devices_list = []
+# device id -> position in devices_list
+devices_list_index = ListIndex('id')
+# serializes the updates of devices_list and hf_devices (startup, reconcile, delete)
+devices_lock = threading.RLock()
+# last known device table, opened by main()
+DEVICE_STORE_PATH = 'han_app_mqtt_devices.db'
+stored_devices = None
+
+def open_device_store(path=DEVICE_STORE_PATH):
+    global stored_devices
+    stored_devices = DeviceStore(path)
 
 def list_devices(client_handle, argv):
     """
@@ -293,32 +311,63 @@ DESCRIPTION
 Lists the all the information for each device registered to the hub.
     """
     global devices_list
-    devices_list = []
-
-
-    index = 0
-    count = 5
-    while True:
-        resp = client_handle.get_dev_table(index=index, count=count)
-        for dev in resp.devices:
-            print(dev)
-            devices_list.append(dev)
-
-        # If there are fewer devices than we have asked for we have retrieved them all,
-        # otherwise we need to move the index and check if there are more.
-        if len(resp.devices) < count:
-            break
-        else:
-            index += count
+    try:
+        devices = fetch_dev_table(client_handle)
+    except (han_client.TimeoutException, han_client.ResponseException) as e:
+        # a partial table would drop the devices not read, keep the current one
+        log(f'device table not read from HAN server, devices unchanged: {e}')
+        return
 
-    for dev in devices_list:
+    for dev in devices:
         for unit in dev.units:
             log('dev {}: unit #{}={}'.format(dev.id,unit.id, hex(unit.type)))
             for interface in unit.interfaces:
                 log('interface {}, type={}'.format(hex(interface.id), hex(interface.type)))
 
-    # save all in the HF structure
-    snom_store_devices(client_handle, argv)
+    with devices_lock:
+        devices_list = devices
+        stored_devices.replace_all(devices)
+
+        # save all in the HF structure
+        snom_store_devices(client_handle, argv)
+
+def fetch_dev_table(client_handle) -> list:
+    # all pages, requested ahead with the largest page size the HAN server accepts
+    devices = client_handle.get_full_dev_table()
+    for dev in devices:
+        print(dev)
+    return devices
+
+def load_stored_devices(client_handle) -> bool:
+    """Start from the stored device table, False if the store is empty."""
+    global devices_list
+
+    devices = stored_devices.load()
+    if not devices:
+        return False
+    log(f'{len(devices)} devices loaded from store')
+    with devices_lock:
+        devices_list = devices
+        snom_store_devices(client_handle, '')
+    return True
+
+def reconcile_devices(client_handle):
+    """Compare the stored device table with the HAN server, rebuild on changes only."""
+    global devices_list
+
+    with devices_lock:
+        known = {dev.id: dev for dev in devices_list}
+    try:
+        # DEV_INFO is requested for new and changed devices only
+        devices = client_handle.get_dev_snapshot(known=known)
+    except (han_client.TimeoutException, han_client.ResponseException) as e:
+        log(f'device table not read from HAN server, keep the stored one: {e}')
+        return
+    with devices_lock:
+        if stored_devices.replace_all(devices):
+            log('device table changed on HAN server, update devices')
+            devices_list = devices
+            snom_store_devices(client_handle, '')
 
 def snom_store_devices(client_handle, argv):
     """
@@ -326,53 +375,39 @@ NAME
 snom_store_devices - store information about all the devices in HFDevices
 
 DESCRIPTION
-Stores all the information for each device registered to the hub in HFDevices  
+Stores all the information for each device in devices_list in HFDevices. The
+device table is not read from the hub, use devices for that.
     """
     global devices_list
     global hf_devices
 
-    devices_list = []
-
-    index = 0
-    count = 5
-    while True:
-        resp = client_handle.get_dev_table(index=index, count=count)
-        for dev in resp.devices:
-            print(dev)
-            devices_list.append(dev)
-
-        # If there are fewer devices than we have asked for we have retrieved them all,
-        # otherwise we need to move the index and check if there are more.
-        if len(resp.devices) < count:
-            break
-        else:
-            index += count
-
-    for dev in devices_list:
-        new_units_list = []
-        for unit in dev.units:
-            new_profile = HFProfiles().get_profile_by_id(unit.type) or HFProfile(profile_id=unit.type)
-            new_interfaces_list = []  
-            for interface in unit.interfaces:
-                # unknown interfaces will add 'ID' to the interface list
-                new_interface = hf_interfaces.get_interface_by_id(interface.id)
-                if new_interface != None:
-                    new_interfaces_list.append(new_interface)
-                #print(new_interface)
-                #log('interface {}, type={}'.format(hex(interface.id), hex(interface.type)))
-            new_unit = HFUnit(unit_id=unit.id, unit_name=str(unit.id), profile=new_profile, interfaces=new_interfaces_list)
-            new_units_list.append(new_unit)
-            #print(new_unit)
-        new_device = HFDevice(device_id=dev.id, device_name=str(dev.id), device_ipui=dev.ipui, units=new_units_list)
-        hf_devices.update_device(new_device)
-        
-    print('####################################################')
-    print('correct interface attributes depending on profile')
-    print('apply known profile changes for interfaces')
-    for dev in hf_devices.get_devices():
-        print(f'update dev {dev.device_id}:{dev.device_name}')
-        dev_update_profile_changes(dev)    
-    print('####################################################')
+    # devices_list is set by the caller (list_devices, load_stored_devices, reconcile_devices)
+    with devices_lock:
+        for dev in devices_list:
+            new_units_list = []
+            for unit in dev.units:
+                new_profile = HFProfiles().get_profile_by_id(unit.type) or HFProfile(profile_id=unit.type)
+                new_interfaces_list = []  
+                for interface in unit.interfaces:
+                    # unknown interfaces will add 'ID' to the interface list
+                    new_interface = hf_interfaces.get_interface_by_id(interface.id)
+                    if new_interface != None:
+                        new_interfaces_list.append(new_interface)
+                    #print(new_interface)
+                    #log('interface {}, type={}'.format(hex(interface.id), hex(interface.type)))
+                new_unit = HFUnit(unit_id=unit.id, unit_name=str(unit.id), profile=new_profile, interfaces=new_interfaces_list)
+                new_units_list.append(new_unit)
+                #print(new_unit)
+            new_device = HFDevice(device_id=dev.id, device_name=str(dev.id), device_ipui=dev.ipui, units=new_units_list)
+            # applied before hf_devices takes the device over, its entries are not changed in place
+            print(f'update dev {new_device.device_id}:{new_device.device_name}')
+            dev_update_profile_changes(new_device)
+            hf_devices.update_device(new_device)
+
+        known_ids = {dev.id for dev in devices_list}
+        for dev in list(hf_devices.get_devices()):
+            if dev.device_id not in known_ids:
+                hf_devices.delete_device_by_id(dev.device_id)
     
     print(hf_devices)
 
@@ -522,7 +557,10 @@ delete device_id * - where * is not y or Y, blacklists the device for future del
 
     client_handle.delete_dev(device_id, local=local_delete)
     # remove it from snom data 
-    hf_devices.delete_device_by_id(device_id)
+    with devices_lock:
+        hf_devices.delete_device_by_id(device_id)
+        stored_devices.delete(device_id)
+    attribute_cache.invalidate(device_id)
 
 
 def start_voice_call(client_handle, argv):
@@ -586,12 +624,17 @@ NAME
 send_get_attribute_request - requests attribute with id from interface on device 
 
 SYNOPSIS
-send_get_attribute_request device_id unit_id interface attribute_id
+send_get_attribute_request device_id unit_id interface attribute_id [bypass]
 
 DESCRIPTION
-Requests an attribute from unit-interface on device 
+Requests an attribute from unit-interface on device. A value received within
+its TTL is shown from the attribute cache instead, bypass always asks the device.
     """
 
+    bypass = argv[-1] == 'bypass'
+    if bypass:
+        argv = argv[:-1]
+
     if len(argv) == 6:
         _, device_id, unit_id, interface_id, attr_id, user_data = argv
         print("deviceID={}, interface_id={}, attr_id={} and data=({})".format(device_id, unit_id, interface_id, attr_id, user_data))
@@ -612,8 +655,12 @@ Requests an attribute from unit-interface on device
         print("The device ID ({}), unit_id={}, interface_id ({}) attr_id ({}) has to be a number".format(device_id, unit_id, interface_id, attr_id))
         return
 
-    ## create attribute request 
-    send_attr_request(client_handle, device_id, unit_id, interface_id, attr_id) # request attribute # ID
+    ## create attribute request, unless the value is cached
+    values = attribute_cache.read((device_id, unit_id, interface_id, attr_id),
+                                  lambda key: send_attr_request(client_handle, *key), bypass) # request attribute # ID
+    if values is not None:
+        log("Device {}: attribute {} on unit {}-interface {} from cache: {}".format(device_id, attr_id, unit_id, interface_id, values))
+        return
     log("Device {}: attribute {} requested on unit {}-interface {}. message has been queued for delivery ...".format(device_id, attr_id, unit_id, interface_id))
 
 
@@ -623,12 +670,18 @@ NAME
 send_get_attributes_pack_request - requests mandatory and optional attributes from interface on device 
 
 SYNOPSIS
-send_get_attributes_pack_request device_id interface
+send_get_attributes_pack_request device_id interface [bypass]
 
 DESCRIPTION
-Requests and attribute from interface on device 
+Requests and attribute from interface on device. If all attributes of the
+interface were received within their TTL, they are shown from the attribute
+cache instead, bypass always asks the device.
     """
 
+    bypass = argv[-1] == 'bypass'
+    if bypass:
+        argv = argv[:-1]
+
     if len(argv) == 5:
         _, device_id, interface_id, attr_id, user_data = argv
         print("deviceID={}, interface_id={}, attr_id={} and data=({})".format(device_id, interface_id, attr_id, user_data))
@@ -647,6 +700,16 @@ Requests and attribute from interface on device
         print("The device ID ({}), interface_id ({}) has to be a number".format(device_id, interface_id, attr_id))
         return
 
+    # the pack request goes to unit 1
+    dev = hf_devices.get_device_by_id(device_id)
+    unit = dev.get_unit_by_id(1) if dev else None
+    interface = unit.get_interface_by_id(interface_id) if unit else None
+    if interface and not bypass:
+        cached = [attribute_cache.get((device_id, 1, interface_id, a.attribute_id)) for a in interface.server_attributes]
+        if cached and None not in cached:
+            log("Device {}: attribute pack on interface {} from cache: {}".format(device_id, interface_id, cached))
+            return
+
     ## create attribute request 
     send_attr_pack_request(client_handle, int(device_id), int(interface_id)) # request all attributes # ID
     log("Device {}: attribute pack requested on interface {}. message has been queued for delivery ...".format(device_id, interface_id))
@@ -1319,7 +1382,7 @@ def handle_light_bulb(device_id, message_type, interface_id, interface_member, h
         interface = dev.get_unit_by_id(1).get_interface_by_id(interface_id)
         if len(hl) >= 2:
             # cut the code
-            interface.set_attribute_values_by_id(interface_member, hl[1:])
+            hf_devices.set_attribute_values(device_id, 1, interface_id, interface_member, hl[1:])
         print(interface.get_attribute_by_id(interface_member))
   
 def handle_blind(device_id, message_type, interface_id, interface_member, data):
@@ -1545,18 +1608,17 @@ def snom_handle_server_cmds(device_id, unit_id, interface_id, cmd_id, hl):
         print(f'action {command_routine} on server command {cmd_id} for interface {interface_id} is not possible!')
     return
 
-def  get_list_id_by_device_id(device_id: int) -> int:
-    for idx, dev in enumerate(devices_list):
-        if dev.id == device_id:
-            return idx
-    return -1
+def get_list_id_by_device_id(device_id: int) -> int:
+    global devices_list
+    return devices_list_index.position(devices_list, device_id)
 
 def snom_handle_fun_msg(client, msg):
-    device_id = int(msg.params["SRC_DEV_ID"])
-    unit_id = int(msg.params["SRC_UNIT_ID"])
-    interface_id = int(msg.params["INTRF_ID"])
-    interface_member = int(msg.params["INTRF_MEMBER"])
-    message_type = int(msg.params["MSGTYPE"])
+    device_id = msg.src_dev_id
+    unit_id = msg.src_unit_id
+    interface_id = msg.interface_id
+    interface_member = msg.interface_member
+    message_type = msg.msg_type
+    hl = list(msg.data)
     
     list_id = get_list_id_by_device_id(device_id)
     if list_id == -1:
@@ -1574,15 +1636,11 @@ def snom_handle_fun_msg(client, msg):
     log(f'MSGTYPE received={global_message_type(int(message_type))}:{message_type}')
     if message_type == 8:
         # answer to set attribute
-        datastr=msg.params["DATA"]
-        hl = [int(x, 16) for x in datastr.split(' ')]
         print(f'Response to Set Attribute {global_response_code(hl[0])}')
         log("data raw {}".format(hl))
         #return   
     if message_type == 5:
         # answer to get attribute
-        datastr=msg.params["DATA"]
-        hl = [int(x, 16) for x in datastr.split(' ')]
         if hl[0] == 0x03:
             log("get attr not supported".format(hl))    
         log("data raw {}".format(hl))
@@ -1604,11 +1662,8 @@ def snom_handle_fun_msg(client, msg):
         log("Device {}: message from unit {}".format(device_id, unit_id))
         #for entry in msg.params:
         #    log("param {}".format(entry))
-        log("LEN {}".format(int(msg.params["DATALEN"])))
-        log("data raw {}".format(msg.params["DATA"]))
-        datastr=msg.params["DATA"]
-
-        hl = [int(x, 16) for x in datastr.split(' ')]
+        log("LEN {}".format(len(hl)))
+        log("data raw {}".format(msg.params.get("DATA", "")))
         if len(hl) == 0:
             profile = devices_list[list_id].units[unit_id].type
             print('Profile: # unit={}, unit_id={}, profile(type)={}'.format(unit_id,
@@ -1617,11 +1672,6 @@ def snom_handle_fun_msg(client, msg):
             log('we got as message from unit={},profile={} without payload'.format(unit_id, hex(profile)))
         # incoming message from device!     
         if message_type == 1: # server command
-            try:
-                datastr=msg.params["DATA"]
-                hl = [int(x, 16) for x in datastr.split(' ')]
-            except:
-                hl=[]
             snom_handle_server_cmds(device_id, unit_id, interface_id, interface_member, hl)
 
         if message_type == 5:
@@ -1632,7 +1682,7 @@ def snom_handle_fun_msg(client, msg):
             interface = dev.get_unit_by_id(unit_id).get_interface_by_id(interface_id)
             if len(hl) >= 2:
                 # cut the code
-                interface.set_attribute_values_by_id(interface_member, hl[1:])
+                hf_devices.set_attribute_values(device_id, unit_id, interface_id, interface_member, hl[1:])
             print(interface.get_attribute_by_id(interface_member))
     
    
@@ -1794,6 +1844,11 @@ hf_interfaces.create_known_interfaces()
 global hf_devices
 hf_devices = HFDevices()
 
+# values of reports and responses, reads within the TTL are answered without asking the device
+global attribute_cache
+attribute_cache = AttributeCache()
+hf_devices.add_listener(attribute_cache.attribute_updated, changes_only=False)
+
 # MQTT MQTT MQTT
 from snom_sss_mqtt_hassio import snomSSSMqttHasssioClient
 mqttc = snomSSSMqttHasssioClient()
@@ -1824,7 +1879,7 @@ def my_callback(inp):
 
 import time
 
-def main():
+def main(store_path=DEVICE_STORE_PATH):
 
     client_handle = han_client.HANClient()
     print("1", client_handle)
@@ -1853,7 +1908,12 @@ def main():
     # get a global list of the currently available devices..
     # remember to update frequently on register dereg etc....
     print("Gather current device information")
-    list_devices(client_handle, '')
+    open_device_store(store_path)
+    if load_stored_devices(client_handle):
+        # check against the HAN server in the background
+        threading.Thread(target=reconcile_devices, args=(client_handle,), daemon=True).start()
+    else:
+        list_devices(client_handle, '')
 
     CMD_LINE = False 
     if CMD_LINE:
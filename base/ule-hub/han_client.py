@@ -15,6 +15,8 @@ from __future__ import print_function
 import threading
 import socket
 import collections
+import itertools
+import asyncio
 import _thread
 
 #from multiprocessing import Process
@@ -66,11 +68,101 @@ def _hexstr(str):
     return "".join(format(int(x), "02x") for x in str.split())
 
 
+# parameter identifying the request a response belongs to, by response name
+WAITER_KEY_PARAMS = {
+    "DEV_TABLE": "DEV_INDEX",
+    "DEV_TABLE_PHASE_2": "DEV_INDEX",
+    "BLACK_LIST_DEV_TABLE": "DEV_INDEX",
+    "DEV_INFO": "DEV_ID",
+    "DEV_INFO_PHASE_2": "DEV_ID",
+}
+# the cookie, for all other responses (e.g. FUN_MSG_RES)
+WAITER_KEY_DEFAULT = "MSG_SEQ"
+# cookies wrap at the width of MSG_SEQ, a u8 in the HAN-FUN message header
+MSG_SEQ_MODULO = 256
+
+
+def _waiter_key(msg):
+    """Value of the key parameter of msg, None if msg does not carry it (e.g. an error response)."""
+    return msg.waiter_key(WAITER_KEY_PARAMS.get(msg.name, WAITER_KEY_DEFAULT))
+
+
+def _waiter_keys(msg):
+    """Return waiter keys of msg in order of preference, ending with None (any key)."""
+    key = _waiter_key(msg)
+    return [None] if key is None else [key, None]
+
+
+def _keyed_waiters(waiters, msg):
+    """Waiter registry keys of all keyed waiters for msg, if msg is a response without key.
+
+    Such a response (e.g. an error response) cannot be matched to one request, so every
+    keyed waiter of that name takes it."""
+    if _waiter_key(msg) is not None:
+        return []
+    return [waiter_key for waiter_key, pending in waiters.items()
+            if waiter_key[0] == msg.name and waiter_key[1] is not None and pending]
+
+
+# devices per DEV_TABLE request accepted by every HAN server
+DEV_TABLE_COUNT = 5
+# devices per DEV_TABLE request tried first, the server cuts the page to what it supports
+DEV_TABLE_MAX_COUNT = 32
+# requests sent ahead of the responses by the bulk requests
+PIPELINE_WINDOW = 4
+
+
+def _device_signature(device):
+    """Registration data of a parsed device, equal if the device has not changed."""
+    return (device.id, getattr(device, "ipui", None),
+            tuple((unit.id, unit.type, tuple(intrf.id for intrf in unit.interfaces))
+                  for unit in device.units))
+
+
+def _dev_table_request(index, count, phase2):
+    """(msg, respname, key) of a device table page request, shared by both clients."""
+    if phase2:
+        msg = Message(name="GET_DEV_TABLE_PHASE_2")
+        respname = "DEV_TABLE_PHASE_2"
+    else:
+        msg = Message(name="GET_DEV_TABLE")
+        respname = "DEV_TABLE"
+
+    msg.params["DEV_INDEX"] = str(index)
+    msg.params["HOW_MANY"] = str(count)
+    return msg, respname, index
+
+
+def _table_page(resp):
+    """Return the DEV_TABLE page resp, raise ResponseException if it is an error response."""
+    if resp.index is None:
+        raise ResponseException("Error: '{}' failed: {}".format(resp.name, resp.params))
+    return resp
+
+
+def _dev_info_request(device_id, phase2):
+    """(msg, respname, key) of a device info request, shared by both clients."""
+    if phase2:
+        msg = Message(name="GET_DEV_INFO_PHASE_2")
+        respname = "DEV_INFO_PHASE_2"
+    else:
+        msg = Message(name="GET_DEV_INFO")
+        respname = "DEV_INFO"
+
+    msg.params["DEV_ID"] = str(device_id)
+    return msg, respname, device_id
+
+
 class TimeoutException(Exception):
     """Exception raised when a waiting for a response times out."""
     pass
 
 
+class ResponseException(Exception):
+    """Exception raised when the HAN server answers a request with an error."""
+    pass
+
+
 class BlockedRxException(Exception):
     """Exception raised when a blocking API method is called from a callback."""
     pass
@@ -97,9 +189,14 @@ class Message(object):
 
     """
 
+    # message name -> class, filled on first use (all subclasses are defined in this module)
+    _classes = {}
+
     def __new__(cls, data=None, service=None, name=None):
         """Factory for generating a matching response (sub)class instance from data
 
+        The data is split into service, name and parameters only once here, __init__ reuses it.
+
         Based on: https://stackoverflow.com/questions/5953759/using-a-class-new-method-as-a-factory-init-gets-called-twice
         """  # noqa
 
@@ -108,15 +205,12 @@ class Message(object):
         if not data:
             return new(cls)
 
-        subclasses = cls.__subclasses__()
-
-        msgname, params = data.split(EOL, 1)
-        clsname = cls.camelcase(msgname) + "Message"
+        parsed = cls._split_data(data)
+        subclass = cls._class_for(parsed[1]) if cls is Message else cls
 
-        for subclass in subclasses:
-            if subclass.__name__ == clsname:
-                return new(subclass)
-        return new(cls)
+        obj = new(subclass)
+        obj._parsed = parsed
+        return obj
 
     def __init__(self, data=None, service=None, name=None):
         """Initialize message instance. If data is supplied, parse it"""
@@ -127,45 +221,56 @@ class Message(object):
         if data:
             self._parse_data(data)
 
-    def _parse_data(self, data):
-        """Parse data into .service, .name and ._params, call _parse_params()"""
-        data = data.strip()
+    @staticmethod
+    def _class_for(msgname):
+        """Return the subclass parsing msgname (e.g. DevTableMessage for DEV_TABLE), or Message"""
+        subclass = Message._classes.get(msgname)
+        if subclass is None:
+            clsname = Message.camelcase(msgname) + "Message"
+            subclass = next((c for c in Message.__subclasses__() if c.__name__ == clsname), Message)
+            Message._classes[msgname] = subclass
+        return subclass
+
+    @staticmethod
+    def _split_data(data):
+        """Split data into (service, name, [(key, value), ...]) in a single pass over the lines"""
+        first, _, rest = data.strip().partition(EOL)
 
         # some messages are prefixed with a service identifier (e.g. "[HAN]"), some are not
-        first, rest = data.split(EOL, 1)
+        service = None
         if first.startswith("["):
-            self.service = first
-            self.name, params = rest.split(EOL, 1)
-        else:
-            self.name = first
-            params = rest
+            service = first
+            first, _, rest = rest.partition(EOL)
 
-        if not self.service:
-            self.service = "[HAN]"
+        params = []
+        for line in rest.split(EOL):
+            key, delim, value = line.strip().partition(PARAM_DELIM)
+            if delim:
+                params.append((key, value.strip()))
+            elif key == "SUCCEED" or key == "FAIL":
+                params.append((key, True))
 
-        params = params.split(EOL)
+        return service, first, params
 
-        self._params = []
-        for param in params:
-            param = param.strip()
-            try:
-                key, value = param.split(PARAM_DELIM)
-                value = value.strip()
-            except ValueError:
-                if param == "SUCCEED":
-                    key, value = "SUCCEED", True
-                if param == "FAIL":
-                    key, value = "FAIL", True
-            finally:
-                self._params.append((key, value))
+    def _parse_data(self, data):
+        """Parse data into .service, .name and ._params, call _parse_params()"""
+        parsed = self.__dict__.pop("_parsed", None) or self._split_data(data)
+        service, self.name, self._params = parsed
+
+        self.service = service or self.service or "[HAN]"
 
         self._parse_params()
 
     def _parse_params(self):
         """Parse ._params into .params using a more appropriate presentation (dict/classes)"""
-        self.params = {}
-        for key, value in self._params:
-            self.params[key] = value
+        self.params = dict(self._params)
+
+    def waiter_key(self, name):
+        """Return value of parameter name as waiter key, None if not present."""
+        try:
+            return self._find_param(name)
+        except KeyError:
+            return None
 
     def _find_param(self, name):
         for key, value in self._params:
@@ -176,16 +281,7 @@ class Message(object):
     @staticmethod
     def camelcase(str):
         """Convert a message name to camelcase (e.g. "DEV_TABLE" to "DevTable")"""
-        str = str.lower()
-        str = str[0].upper() + str[1:]
-
-        while True:
-            pos = str.find("_")
-            if pos == -1:
-                break
-            str = str[:pos] + str[pos+1].upper() + str[pos+2:]
-
-        return str
+        return "".join(part.capitalize() for part in str.lower().split("_"))
 
     @staticmethod
     def encode(data):
@@ -267,11 +363,16 @@ class DevTableParser(object):
         }
 
     def _parse_params(self):
-        self.index = int(self._find_param("DEV_INDEX"))
+        self.devices = []
+        index = self.waiter_key("DEV_INDEX")
+        if index is None:
+            # error response, e.g. STATUS: FAIL
+            self.index = None
+            return
+        self.index = int(index)
 
         params = self._params[2:]  # skip dev_index and no_of_devices
 
-        self.devices = []
         while params:
             device, params = self._parse_device(params)
             self.devices.append(device)
@@ -329,6 +430,10 @@ class DevTableParser(object):
 
 class DevParser(DevTableParser):
     def _parse_params(self):
+        if self.waiter_key("DEV_ID") is None:
+            # error response, e.g. STATUS: FAIL
+            self.device = None
+            return
         device, _ = self._parse_device(self._params)
         self.device = device
 
@@ -397,16 +502,50 @@ class BlackListDevTableMessage(DevTableParser, Message):
 
 
 class FunMsgMessage(Message):
+    """Parse a FUN_MSG message.
+
+    The header fields are converted to int and the DATA hex string is decoded once, handlers
+    should use these instead of parsing .params again.
+
+    Result:
+        .src_dev_id, .src_unit_id, .dst_dev_id, .dst_unit_id = <int>
+        .msg_seq, .msg_type = <int>
+        .interface_type, .interface_id, .interface_member = <int>
+        .data = <bytes>
+    """
+
+    _fields = (
+        ("SRC_DEV_ID", "src_dev_id"),
+        ("SRC_UNIT_ID", "src_unit_id"),
+        ("DST_DEV_ID", "dst_dev_id"),
+        ("DST_UNIT_ID", "dst_unit_id"),
+        ("MSG_SEQ", "msg_seq"),
+        ("MSGTYPE", "msg_type"),
+        ("INTRF_TYPE", "interface_type"),
+        ("INTRF_ID", "interface_id"),
+        ("INTRF_MEMBER", "interface_member"),
+    )
 
     def _parse_params(self):
         super(FunMsgMessage, self)._parse_params()
 
-        datalen = int(self.params["DATALEN"])
-        if datalen:
-            data = self._find_param("DATA")
-            self.data = bytearray([int(x, 16) for x in data.split()])
-        else:
-            self.data = bytearray()
+        params = self.params
+        for key, attr in self._fields:
+            value = params.get(key)
+            setattr(self, attr, None if value is None else int(value))
+
+        self.data = b""
+        if int(params.get("DATALEN", 0)):
+            self.data = self.decode_data(params["DATA"])
+
+    @staticmethod
+    def decode_data(data):
+        """Decode space separated hex bytes (e.g. "48 65 6c") into bytes"""
+        try:
+            return bytes.fromhex(data)
+        except ValueError:
+            # bytes not zero padded, e.g. "1 F 13"
+            return bytes(int(x, 16) for x in data.split())
 
 
 class HANClient(object):
@@ -414,10 +553,11 @@ class HANClient(object):
 
     class Waiter(object):
         """Wait for a specific message, carry message once received."""
-        def __init__(self, msgname):
+        def __init__(self, msgname, key=None):
             self.event = threading.Event()
             #self.event = multiprocessing.Event()
             self.msgname = msgname.upper()
+            self.key = None if key is None else str(key)
             self.message = None
 
         # cannot subclass threading.Event() in python2, so we proxy
@@ -425,9 +565,9 @@ class HANClient(object):
         def __getattr__(self, attr):
             return getattr(self.event, attr)
 
-    def __init__(self):
-        self._ip_address = "127.0.0.1"
-        self._port = 3490
+    def __init__(self, ip_address="127.0.0.1", port=3490):
+        self._ip_address = ip_address
+        self._port = port
         self._sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
         self._rxthread = threading.Thread(target=self._receive)
         self._rxthread.daemon = True
@@ -438,6 +578,7 @@ class HANClient(object):
 
         self._debug_print = False
         self._cookie = 0
+        self._cookie_lock = threading.Lock()
 
         self.run = True
 
@@ -448,46 +589,70 @@ class HANClient(object):
         }
 
         self._subscribers = {}
-        self._waiter = None
+        # (msgname, key) -> deque of waiters, oldest first
+        self._waiters = {}
+        self._waiters_lock = threading.Lock()
         self._rx_message_processor = None
 
     def _receive(self):
         """Receives data from the HAN server UDP socket and handles it."""
-        #while True:
-        #print('_receive thread')
         while self.run:
-            #print('run', self.run)
-
-            data, _ = self._sock.recvfrom(4096)
-            data_str = data.decode("utf-8")
-
-            if self._debug_print:
-                print("\n\nHAN Client <<-- HAN Server:")
-                print(data_str)
-
-            if self._rx_message_processor:
-                self._rx_message_processor(self, data_str)
-
-            msg = Message(data_str)
-
-            # handled internally?
-            handler = self._handlers.get((msg.service, msg.name))
-            if handler:
-                handler(msg)
-                continue
-
-            # wakeup any waiter
-            if self._waiter:
-                if self._waiter.msgname == msg.name:
-                    self._waiter.message = msg
-                    self._waiter.set()
-                    self._waiter = None
-
-            # subscribers
-            if msg.name in self._subscribers:
-                subscribers = self._subscribers[msg.name]
-                for subscriber in subscribers:
-                    subscriber(self, msg)
+            try:
+                # large enough for any datagram, DEV_TABLE pages may exceed 4k
+                data, _ = self._sock.recvfrom(65535)
+            except OSError:
+                if not self.run:
+                    break  # socket closed after destroy()
+                raise
+            self._dispatch(data.decode("utf-8"))
+
+    def _dispatch(self, data_str):
+        """Parse a received message and hand it to handlers, waiters and subscribers."""
+        if self._debug_print:
+            print("\n\nHAN Client <<-- HAN Server:")
+            print(data_str)
+
+        if self._rx_message_processor:
+            self._rx_message_processor(self, data_str)
+
+        msg = Message(data_str)
+
+        # handled internally?
+        handler = self._handlers.get((msg.service, msg.name))
+        if handler:
+            handler(msg)
+            return
+
+        # wakeup matching waiters
+        for waiter in self._pop_waiters(msg):
+            waiter.message = msg
+            waiter.set()
+
+        # subscribers
+        if msg.name in self._subscribers:
+            subscribers = self._subscribers[msg.name]
+            for subscriber in subscribers:
+                subscriber(self, msg)
+
+    def _pop_waiters(self, msg):
+        """Remove and return the waiters woken by msg, an empty list if there are none.
+
+        The oldest waiter matching msg is woken, waiters registered with a key are preferred
+        over waiters for any message of that name. A message without its key parameter
+        (WAITER_KEY_PARAMS, e.g. an error response) can not be told apart: if no waiter
+        without key is registered, all keyed waiters of that name are woken with it."""
+        with self._waiters_lock:
+            for waiter_key in [(msg.name, key) for key in _waiter_keys(msg)]:
+                waiters = self._waiters.get(waiter_key)
+                if waiters:
+                    waiter = waiters.popleft()
+                    if not waiters:
+                        del self._waiters[waiter_key]
+                    return [waiter]
+            woken = []
+            for waiter_key in _keyed_waiters(self._waiters, msg):
+                woken.extend(self._waiters.pop(waiter_key))
+            return woken
 
     def _keep_alive_handler(self, resp):
         """Send keep alive response.
@@ -511,8 +676,10 @@ class HANClient(object):
 
     @property
     def cookie(self):
-        cookie = self._cookie
-        self._cookie += 1
+        """Next MSG_SEQ, wraps at MSG_SEQ_MODULO."""
+        with self._cookie_lock:
+            cookie = self._cookie
+            self._cookie = (cookie + 1) % MSG_SEQ_MODULO
         return cookie
 
     def start(self):
@@ -560,21 +727,68 @@ class HANClient(object):
             self._subscribers[msgname] = []
         self._subscribers[msgname].append(callback)
 
-    def waiter(self, msgname):
-        """Create and registers a waiter which will trigger once msgname is received."""
-        self._waiter = self.Waiter(msgname)
-        return self._waiter
-
-    def send_and_wait(self, msg, respname):
-        """Send msg to the HAN server and wait for a message with respname."""
+    def waiter(self, msgname, key=None):
+        """Create and registers a waiter which will trigger once msgname is received.
+
+        Any number of waiters may be pending at the same time. With a key, only a message
+        carrying that value in the key parameter of msgname (WAITER_KEY_PARAMS: table index
+        for tables, device id for device info, else the cookie) wakes the waiter. Without a
+        key, the next message named msgname does."""
+        waiter = self.Waiter(msgname, key)
+        with self._waiters_lock:
+            waiters = self._waiters.setdefault((waiter.msgname, waiter.key), collections.deque())
+            waiters.append(waiter)
+        return waiter
+
+    def cancel_waiter(self, waiter):
+        """Unregister a waiter which has not been triggered yet."""
+        with self._waiters_lock:
+            waiters = self._waiters.get((waiter.msgname, waiter.key))
+            if waiters and waiter in waiters:
+                waiters.remove(waiter)
+                if not waiters:
+                    del self._waiters[(waiter.msgname, waiter.key)]
+
+    def send_and_wait(self, msg, respname, key=None):
+        """Send msg to the HAN server and wait for a message with respname (and key)."""
         self._check_rx_will_block()
 
-        waiter = self.waiter(respname)
+        waiter = self.waiter(respname, key)
         self.send(msg)
         if not waiter.wait(4):  # wait at most four seconds
+            self.cancel_waiter(waiter)
             raise TimeoutException("Error: timed out waiting for '{}'".format(respname))
         return waiter.message
 
+    def _pipeline(self, requests, window=PIPELINE_WINDOW):
+        """Send requests with up to window responses pending, yield the responses in order.
+
+        Args:
+            requests: iterable of (msg, respname, key), may be endless
+            window: maximum number of requests waiting for a response
+
+        Closing the generator early unregisters the waiters of requests already sent."""
+        self._check_rx_will_block()
+
+        requests = iter(requests)
+        pending = collections.deque()
+        try:
+            while True:
+                for msg, respname, key in itertools.islice(requests, window - len(pending)):
+                    pending.append(self.waiter(respname, key))
+                    self.send(msg)
+                if not pending:
+                    return
+
+                waiter = pending.popleft()
+                if not waiter.wait(4):  # wait at most four seconds
+                    self.cancel_waiter(waiter)
+                    raise TimeoutException("Error: timed out waiting for '{}'".format(waiter.msgname))
+                yield waiter.message
+        finally:
+            for waiter in pending:
+                self.cancel_waiter(waiter)
+
     #  Methods called by the app to do things
     # This is the API for the HAN app to talk to the HAN client
     # Begin API
@@ -731,7 +945,7 @@ class HANClient(object):
         msg.params["DEV_INDEX"] = str(index)
         msg.params["HOW_MANY"] = str(count)
 
-        return self.send_and_wait(msg, respname)
+        return self.send_and_wait(msg, respname, key=index)
 
     def get_dev_table(self, index=0, count=5, phase2=True):
         """Get a list of registered devices.
@@ -745,17 +959,92 @@ class HANClient(object):
 
         Returns:
             The parsed DEV_TABLE response. See :class:`DevTablePhase2Message`."""
-        if phase2:
-            msg = Message(name="GET_DEV_TABLE_PHASE_2")
-            respname = "DEV_TABLE_PHASE_2"
-        else:
-            msg = Message(name="GET_DEV_TABLE")
-            respname = "DEV_TABLE"
+        return self.send_and_wait(*_dev_table_request(index, count, phase2))
 
-        msg.params["DEV_INDEX"] = str(index)
-        msg.params["HOW_MANY"] = str(count)
+    def get_full_dev_table(self, count=DEV_TABLE_MAX_COUNT, phase2=True, window=PIPELINE_WINDOW):
+        """Get all registered devices.
+
+        The first page is requested with <count> devices, the HAN server may return fewer.
+        The following pages are requested with the size of the first page, up to <window>
+        of them before the responses arrive, until a page is not full. If the first page
+        is not full, one more page is read before requesting ahead.
+
+        Args:
+            count: devices requested in the first page
+            window: maximum number of pages requested ahead
+
+        Returns:
+            List of devices, see :class:`DevTablePhase2Message`.
+
+        Raises:
+            TimeoutException, ResponseException: a page was not answered or answered with
+            an error, the table is never returned in part."""
+        first = None
+        if count > DEV_TABLE_COUNT:
+            try:
+                first = self.get_dev_table(index=0, count=count, phase2=phase2)
+            except TimeoutException:
+                pass
+            if first is None or first.index is None:
+                # large page not answered or rejected, use the page size every server accepts
+                first = None
+                count = DEV_TABLE_COUNT
+        if first is None:
+            first = self.get_dev_table(index=0, count=count, phase2=phase2)
+
+        devices = list(_table_page(first).devices)
+        page = len(devices)
+        if page == 0:
+            return devices
+
+        index = page
+        if page < count:
+            # end of table or page cut by the server, check before requesting ahead
+            resp = _table_page(self.get_dev_table(index=index, count=page, phase2=phase2))
+            devices += resp.devices
+            if len(resp.devices) < page:
+                return devices
+            index += page
+
+        requests = (_dev_table_request(i, page, phase2)
+                    for i in itertools.count(index, page))
+        responses = self._pipeline(requests, window)
+        try:
+            for resp in responses:
+                devices += _table_page(resp).devices
+                if len(resp.devices) < page:
+                    break
+        finally:
+            responses.close()
+        return devices
+
+    def get_dev_snapshot(self, known=None, window=PIPELINE_WINDOW):
+        """Get phase 2 information of all registered devices.
+
+        The device table is read with :meth:`get_full_dev_table`. DEV_INFO_PHASE_2 is requested
+        for new devices and devices whose units or interfaces differ from <known> only, up to
+        <window> requests at the same time.
+
+        Args:
+            known: dict device id -> device from an earlier snapshot, None to request all
 
-        return self.send_and_wait(msg, respname)
+        Returns:
+            List of devices in order of the device table. Unchanged devices are taken from
+            <known>, new devices whose DEV_INFO_PHASE_2 failed are missing.
+
+        Raises:
+            TimeoutException, ResponseException: the device table was not read completely."""
+        known = known or {}
+        table = self.get_full_dev_table(phase2=False, window=window)
+
+        changed = [dev.id for dev in table
+                   if dev.id not in known or _device_signature(dev) != _device_signature(known[dev.id])]
+        requests = (_dev_info_request(device_id, True) for device_id in changed)
+        infos = {resp.device.id: resp.device for resp in self._pipeline(requests, window) if resp.device}
+
+        # devices whose info request failed are left out, unless known
+        return [infos[dev.id] if dev.id in infos else known[dev.id]
+                for dev in table if dev.id in infos or dev.id in known]
 
     def get_dev_info(self, device_id, phase2=True):
         """Get information for a specific device.
@@ -765,16 +1054,7 @@ class HANClient(object):
 
         Returns:
             The DEV_INFO response. See :class:`Message`."""
-        if phase2:
-            msg = Message(name="GET_DEV_INFO_PHASE_2")
-            respname = "DEV_INFO_PHASE_2"
-        else:
-            msg = Message(name="GET_DEV_INFO")
-            respname = "DEV_INFO"
-
-        msg.params["DEV_ID"] = str(device_id)
-
-        return self.send_and_wait(msg, respname)
+        return self.send_and_wait(*_dev_info_request(device_id, phase2))
 
     def call_release(self, call_id):
         """Release a voice call.
@@ -822,3 +1102,171 @@ class HANClient(object):
         msg.params["NAME"] = parameter
         msg.params["DATA"] = value
         return self.send_and_wait(msg, "SET_EEPROM_PARAM_RES")
+
+
+class AsyncHANClient(object):
+    """HAN Protocol client for asyncio.
+
+    Runs on the event loop of the caller, no receive thread is needed. Responses are
+    matched to requests the same way as in :class:`HANClient`, by message name and an
+    optional key (cookie, device id or table index).
+
+    Example:
+
+        client = AsyncHANClient()
+        await client.start()
+        resp = await client.request(Message(name="GET_DEV_INFO_PHASE_2"), "DEV_INFO_PHASE_2", key=1)
+    """
+
+    class _Protocol(asyncio.DatagramProtocol):
+        def __init__(self, client):
+            self.client = client
+
+        def datagram_received(self, data, addr):
+            self.client._dispatch(data.decode("utf-8"))
+
+        def error_received(self, exc):
+            self.client._fail_all(exc)
+
+        def connection_lost(self, exc):
+            self.client._fail_all(exc or ConnectionError("HAN server connection closed"))
+
+    def __init__(self, ip_address="127.0.0.1", port=3490, timeout=4, max_pending=16):
+        """Create client.
+
+        Args:
+            ip_address, port: address of the HAN server
+            timeout: default seconds to wait for a response
+            max_pending: maximum requests waiting for a response, further requests wait
+                for a free slot before being sent (back-pressure)
+        """
+        self._ip_address = ip_address
+        self._port = port
+        self._timeout = timeout
+        self._transport = None
+        self._cookie = 0
+        self._pending = asyncio.Semaphore(max_pending)
+
+        # (msgname, key) -> deque of futures, oldest first
+        self._waiters = {}
+        self._subscribers = {}
+        self._handlers = {
+            ("[HAN]", "KEEP_ALIVE"): self._keep_alive_handler,
+        }
+
+    @property
+    def cookie(self):
+        """Next MSG_SEQ, wraps at MSG_SEQ_MODULO (only used on the event loop, no lock)."""
+        cookie = self._cookie
+        self._cookie = (cookie + 1) % MSG_SEQ_MODULO
+        return cookie
+
+    async def start(self):
+        """Connect to the HAN server and initialize HAN by sending INIT message."""
+        loop = asyncio.get_running_loop()
+        self._transport, _ = await loop.create_datagram_endpoint(
+            lambda: self._Protocol(self), remote_addr=(self._ip_address, self._port))
+
+        msg = Message(name="INIT")
+        msg.params["VERSION"] = "1"
+        return await self.request(msg, "INIT_RES")
+
+    def close(self):
+        if self._transport:
+            self._transport.close()
+            self._transport = None
+
+    def send(self, msg):
+        """Send message to the HAN server, does not wait for anything."""
+        self._transport.sendto(msg.to_bytes())
+
+    def subscribe(self, msgname, callback):
+        """Permanently subscribe callback(client, msg) to the specific incoming message."""
+        self._subscribers.setdefault(msgname.upper(), []).append(callback)
+
+    async def wait_for(self, respname, key=None, timeout=None):
+        """Wait for a message with respname (and key) without sending anything."""
+        future = self._add_waiter(respname, key)
+        try:
+            return await asyncio.wait_for(future, self._timeout if timeout is None else timeout)
+        except asyncio.TimeoutError:
+            raise TimeoutException("Error: timed out waiting for '{}'".format(respname))
+        finally:
+            self._remove_waiter(respname, key, future)
+
+    async def request(self, msg, respname, key=None, timeout=None):
+        """Send msg and return the response with respname (and key).
+
+        Cancelling the calling task drops the pending response. Raises
+        TimeoutException if no response arrives within timeout seconds (None for the
+        client's default)."""
+        async with self._pending:
+            future = self._add_waiter(respname, key)
+            try:
+                self.send(msg)
+                return await asyncio.wait_for(future, self._timeout if timeout is None else timeout)
+            except asyncio.TimeoutError:
+                raise TimeoutException("Error: timed out waiting for '{}'".format(respname))
+            finally:
+                self._remove_waiter(respname, key, future)
+
+    async def get_dev_table(self, index=0, count=5, phase2=True):
+        """Get a list of registered devices, see :meth:`HANClient.get_dev_table`."""
+        return await self.request(*_dev_table_request(index, count, phase2))
+
+    async def get_dev_info(self, device_id, phase2=True):
+        """Get information for a specific device, see :meth:`HANClient.get_dev_info`."""
+        return await self.request(*_dev_info_request(device_id, phase2))
+
+    def _add_waiter(self, respname, key):
+        future = asyncio.get_running_loop().create_future()
+        waiters = self._waiters.setdefault((respname.upper(), None if key is None else str(key)),
+                                           collections.deque())
+        waiters.append(future)
+        return future
+
+    def _remove_waiter(self, respname, key, future):
+        waiter_key = (respname.upper(), None if key is None else str(key))
+        waiters = self._waiters.get(waiter_key)
+        if waiters is None:
+            return
+        if future in waiters:
+            waiters.remove(future)
+        if not waiters:
+            del self._waiters[waiter_key]
+
+    def _dispatch(self, data_str):
+        msg = Message(data_str)
+
+        handler = self._handlers.get((msg.service, msg.name))
+        if handler:
+            handler(msg)
+            return
+
+        for waiter_key in [(msg.name, key) for key in _waiter_keys(msg)]:
+            waiters = self._waiters.get(waiter_key)
+            # skip futures whose task was cancelled but not yet cleaned up
+            while waiters and waiters[0].done():
+                waiters.popleft()
+            if waiters:
+                waiters.popleft().set_result(msg)
+                break
+        else:
+            # a response without key can not be told apart, all keyed waiters take it
+            for waiter_key in _keyed_waiters(self._waiters, msg):
+                for future in self._waiters.pop(waiter_key):
+                    if not future.done():
+                        future.set_result(msg)
+
+        for subscriber in self._subscribers.get(msg.name, []):
+            subscriber(self, msg)
+
+    def _fail_all(self, exc):
+        for waiters in self._waiters.values():
+            for future in waiters:
+                if not future.done():
+                    future.set_exception(exc)
+        self._waiters = {}
+
+    def _keep_alive_handler(self, resp):
+        self.send(Message(name="KEEP_ALIVE_RES"))
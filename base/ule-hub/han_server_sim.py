@@ -0,0 +1,332 @@
+#!/usr/bin/env python3
+#
+# SPDX-License-Identifier: MIT
+"""
+Local HAN server simulator.
+
+Speaks the text protocol of the HAN server on a UDP port, so han_client and
+the apps can be exercised without a base station. Virtual devices are
+generated with a node profile (unit 0) and one application unit each.
+
+Supported requests:
+    INIT, GET_DEV_TABLE, GET_DEV_TABLE_PHASE_2, GET_DEV_INFO, GET_DEV_INFO_PHASE_2,
+    FUN_MSG (confirmed with FUN_MSG_RES for registered devices)
+
+The virtual devices send FUN_MSG attribute reports (Simple Temperature,
+measured temperature) to all clients which sent INIT, at a configurable
+rate per device. Motion detectors (the last <motion_detectors> devices)
+send Alert status commands instead.
+
+Servers which do not cut large device table pages reject them (reject_large_pages),
+pages at the indexes in fail_pages are answered with STATUS: FAIL.
+
+Responses and reports are delayed by latency (+ random jitter) and dropped
+with the probability loss, to emulate the air interface and a busy base.
+
+Usage:
+    python han_server_sim.py [--devices N] [--port 3490] [--latency S] [--rate R]
+"""
+
+import argparse
+import collections
+import heapq
+import random
+import socket
+import threading
+import time
+
+from han_client import EOL, Message
+
+
+# largest number of devices in one DEV_TABLE response, bigger requests are cut
+MAX_DEV_TABLE_PAGE = 32
+
+# interface and attribute of the reports sent by the virtual devices
+REPORT_INTERFACE = 0x0301   # Simple Temperature
+REPORT_ATTRIBUTE = 1        # Measured Temperature, S16 1/100 of C
+# FUN_MSG message type of a get attribute response
+MSG_TYPE_GET_ATTR_RES = 5
+# FUN_MSG message type of a command, Alert interface and its status command
+MSG_TYPE_COMMAND = 1
+ALERT_INTERFACE = 0x0100
+ALERT_STATUS_CMD = 1
+MOTION_DETECTOR = 0x0203
+
+# unit types of the virtual devices: smoke detector, on-off switchable, AC outlet
+UNIT_TYPES = [
+    (0x0204, [0x0100, REPORT_INTERFACE]),
+    (0x0100, [0x0200, REPORT_INTERFACE]),
+    (0x0101, [0x0200, 0x0300, REPORT_INTERFACE]),
+]
+
+# interfaces of the device management unit: device info, keep alive, SUOTA
+NODE_INTERFACES = [0x0101, 0x0115, 0x0400]
+
+
+class VirtualDevice(object):
+    """Registration data of one simulated device."""
+
+    def __init__(self, device_id, unit_type=None, interfaces=None):
+        if unit_type is None:
+            unit_type, interfaces = UNIT_TYPES[device_id % len(UNIT_TYPES)]
+        self.id = device_id
+        self.ipui = [2, 233, 229, (device_id >> 8) & 0xff, device_id & 0xff]
+        self.units = [
+            (0, 0, NODE_INTERFACES),
+            (1, unit_type, interfaces),
+        ]
+
+    def table_lines(self, phase2):
+        lines = [
+            " DEV_ID: {}".format(self.id),
+            " DEV_IPUI: {}".format(" ".join(str(b) for b in self.ipui)),
+            " DEV_EMC: 235 15",
+        ]
+        if phase2:
+            lines += [
+                " ULE_CAPABILITIES: 5",
+                " ULE_PROTOCOL_ID: 1",
+                " ULE_PROTOCOL_VERSION: 2",
+            ]
+        lines.append(" NO_UNITS: {}".format(len(self.units)))
+        for unit_id, unit_type, interfaces in self.units:
+            lines += [
+                " UNIT_ID: {}".format(unit_id),
+                " UNIT_TYPE: {}".format(unit_type),
+                " NO_OF_INTRF: {}".format(len(interfaces)),
+            ]
+            for intrf_id in interfaces:
+                lines += [" INTRF_TYPE: 1", " INTRF_ID: {}".format(intrf_id)]
+        return lines
+
+
+class HANServerSim(object):
+    """Simulated HAN server on a UDP socket, runs in two daemon threads.
+
+    Example:
+
+        sim = HANServerSim(devices=200, latency=0.005)
+        sim.start()
+        client = han_client.HANClient(port=sim.port)
+        ...
+        sim.stop()
+    """
+
+    def __init__(self, devices=10, ip_address="127.0.0.1", port=0,
+                 latency=0.0, jitter=0.0, loss=0.0, max_page=MAX_DEV_TABLE_PAGE, seed=None,
+                 motion_detectors=0, reject_large_pages=False, fail_pages=()):
+        first_detector = devices - motion_detectors + 1
+        self.devices = collections.OrderedDict(
+            (dev.id, dev) for dev in (
+                VirtualDevice(i, MOTION_DETECTOR, [ALERT_INTERFACE]) if i >= first_detector else VirtualDevice(i)
+                for i in range(1, devices + 1)))
+        self.latency = latency
+        self.jitter = jitter
+        self.loss = loss
+        self.max_page = max_page
+        self.reject_large_pages = reject_large_pages
+        self.fail_pages = set(fail_pages)
+        # requests received by message name
+        self.requests = collections.Counter()
+        # (device id, MSG_SEQ) -> time.monotonic() the report was sent, for latency measurement
+        self.sent_reports = {}
+        self.reports_sent = 0
+        self._clients = set()
+        self._msg_seq = collections.Counter()
+
+        self._random = random.Random(seed)
+        self._sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self._sock.bind((ip_address, port))
+        self._run = False
+        # (due time, sequence, data, address, report key), sent by the tx thread
+        self._outgoing = []
+        self._seq = 0
+        self._cond = threading.Condition()
+
+        self._handlers = {
+            "INIT": self._init,
+            "GET_DEV_TABLE": self._dev_table,
+            "GET_DEV_TABLE_PHASE_2": self._dev_table,
+            "GET_DEV_INFO": self._dev_info,
+            "GET_DEV_INFO_PHASE_2": self._dev_info,
+            "FUN_MSG": self._fun_msg,
+        }
+
+    @property
+    def port(self):
+        return self._sock.getsockname()[1]
+
+    def start(self):
+        self._run = True
+        for target in (self._receive, self._transmit):
+            thread = threading.Thread(target=target)
+            thread.daemon = True
+            thread.start()
+        return self
+
+    def stop(self):
+        self._run = False
+        with self._cond:
+            self._cond.notify()
+        self._sock.close()
+
+    def send(self, name, lines, addr, delay=None, report=None):
+        """Queue a message to addr, delayed like a response."""
+        if self.loss and self._random.random() < self.loss:
+            return
+        if delay is None:
+            delay = self.latency
+        if self.jitter:
+            delay += self._random.uniform(0, self.jitter)
+        data = EOL.join([name] + lines + ["", ""]).encode("utf-8")
+        with self._cond:
+            self._seq += 1
+            heapq.heappush(self._outgoing, (time.monotonic() + delay, self._seq, data, addr, report))
+            self._cond.notify()
+
+    def report(self, device_id, value):
+        """Send an attribute report of device_id to all clients, value in 1/100 of C."""
+        data = (value & 0xffff).to_bytes(2, "big")
+        # response code 0 (OK) and the attribute value
+        self._send_fun_msg(device_id, MSG_TYPE_GET_ATTR_RES, REPORT_INTERFACE, REPORT_ATTRIBUTE,
+                           bytes([0]) + data)
+
+    def alert(self, device_id, state):
+        """Send an Alert status command of device_id to all clients, state is a U32 bit mask."""
+        # profile UID and the alert state
+        data = MOTION_DETECTOR.to_bytes(2, "big") + (state & 0xffffffff).to_bytes(4, "big")
+        self._send_fun_msg(device_id, MSG_TYPE_COMMAND, ALERT_INTERFACE, ALERT_STATUS_CMD, data)
+
+    def _send_fun_msg(self, device_id, msg_type, interface_id, member, data):
+        seq = self._msg_seq[device_id] % 256
+        self._msg_seq[device_id] += 1
+        lines = [
+            " SRC_DEV_ID: {}".format(device_id),
+            " SRC_UNIT_ID: 1",
+            " DST_DEV_ID: 0",
+            " DST_UNIT_ID: 0",
+            " DEST_ADDRESS_TYPE: 0",
+            " MSG_TRANSPORT: 0",
+            " MSG_SEQ: {}".format(seq),
+            " MSGTYPE: {}".format(msg_type),
+            " INTRF_TYPE: 1",
+            " INTRF_ID: {}".format(interface_id),
+            " INTRF_MEMBER: {}".format(member),
+            " DATALEN: {}".format(len(data)),
+            " DATA: {}".format(" ".join("{:02x}".format(b) for b in data)),
+        ]
+        for addr in list(self._clients):
+            self.send("FUN_MSG", lines, addr, report=(device_id, seq))
+
+    def run_reports(self, rate, duration):
+        """Send reports of all devices for duration seconds, rate reports per second per device.
+
+        Blocks until done. The devices start at random offsets within the first interval."""
+        interval = 1.0 / rate
+        start = time.monotonic()
+        end = start + duration
+        schedule = [(start + self._random.uniform(0, interval), device_id) for device_id in self.devices]
+        heapq.heapify(schedule)
+        while schedule and self._run:
+            due, device_id = schedule[0]
+            if due >= end:
+                break
+            now = time.monotonic()
+            if due > now:
+                time.sleep(due - now)
+            heapq.heapreplace(schedule, (due + interval, device_id))
+            if self.devices[device_id].units[1][1] == MOTION_DETECTOR:
+                self.alert(device_id, self._random.randint(0, 1))
+            else:
+                self.report(device_id, self._random.randint(1500, 2500))
+
+    def _receive(self):
+        while self._run:
+            try:
+                data, addr = self._sock.recvfrom(65535)
+            except OSError:
+                break
+            msg = Message(data.decode("utf-8"))
+            self.requests[msg.name] += 1
+            handler = self._handlers.get(msg.name)
+            if handler:
+                handler(msg, addr)
+
+    def _transmit(self):
+        while True:
+            with self._cond:
+                while self._run and (not self._outgoing or self._outgoing[0][0] > time.monotonic()):
+                    timeout = self._outgoing[0][0] - time.monotonic() if self._outgoing else None
+                    self._cond.wait(timeout)
+                if not self._run:
+                    return
+                _, _, data, addr, report = heapq.heappop(self._outgoing)
+            try:
+                if report:
+                    self.sent_reports[report] = time.monotonic()
+                    self.reports_sent += 1
+                self._sock.sendto(data, addr)
+            except OSError:
+                return
+
+    def _init(self, msg, addr):
+        self._clients.add(addr)
+        self.send("INIT_RES", [" VERSION: 1"], addr)
+
+    def _dev_table(self, msg, addr):
+        index = int(msg.params.get("DEV_INDEX", 0))
+        count = int(msg.params.get("HOW_MANY", 5))
+        if index in self.fail_pages or (self.reject_large_pages and count > self.max_page):
+            # error responses carry no DEV_INDEX
+            self.send(msg.name[len("GET_"):], [" STATUS: FAIL"], addr)
+            return
+        count = min(count, self.max_page)
+        page = list(self.devices.values())[index:index + count]
+
+        lines = [" DEV_INDEX: {}".format(index), " NO_OF_DEVICES: {}".format(len(page))]
+        phase2 = msg.name.endswith("_PHASE_2")
+        for dev in page:
+            lines += dev.table_lines(phase2)
+        self.send(msg.name[len("GET_"):], lines, addr)
+
+    def _dev_info(self, msg, addr):
+        dev = self.devices.get(int(msg.params.get("DEV_ID", -1)))
+        if dev is None:
+            # the HAN server does not answer for unknown devices either
+            return
+        self.send(msg.name[len("GET_"):], dev.table_lines(msg.name.endswith("_PHASE_2")), addr)
+
+    def _fun_msg(self, msg, addr):
+        device_id = int(msg.params.get("DST_DEV_ID", -1))
+        if device_id not in self.devices:
+            return
+        self.send("FUN_MSG_RES", [" DEV_ID: {}".format(device_id),
+                                  " MSG_SEQ: {}".format(msg.params.get("MSG_SEQ", 0))], addr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Local HAN server simulator")
+    parser.add_argument("--devices", type=int, default=10)
+    parser.add_argument("--port", type=int, default=3490)
+    parser.add_argument("--latency", type=float, default=0.0, help="response delay in seconds")
+    parser.add_argument("--jitter", type=float, default=0.0, help="random extra delay in seconds")
+    parser.add_argument("--loss", type=float, default=0.0, help="probability of dropped responses")
+    parser.add_argument("--rate", type=float, default=0.0, help="reports per second and device")
+    args = parser.parse_args()
+
+    sim = HANServerSim(devices=args.devices, port=args.port,
+                       latency=args.latency, jitter=args.jitter, loss=args.loss)
+    sim.start()
+    print("HAN server simulator with {} devices on port {}".format(args.devices, sim.port))
+    try:
+        while True:
+            if args.rate:
+                sim.run_reports(args.rate, 1.0)
+            else:
+                time.sleep(1)
+    except KeyboardInterrupt:
+        sim.stop()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,309 @@
+#!/usr/bin/env python3
+#
+# SPDX-License-Identifier: MIT
+"""
+Commands from Home Assistant to HAN-FUN devices over MQTT.
+
+A command is published to
+
+    homeassistant/ule/<device_id>/<unit_id>/<interface_id>/<command_id>/set
+
+with the payload bytes of the command, either as space separated numbers
+("1 255", "0x01 0xff") or as a JSON list ([1, 255]). An empty payload sends
+the command without data. A JSON object may also give the message type:
+{"msg_type": 4, "data": []} (default 1 = command, HF Protocol 7.3.1), and
+"bypass": true to read an attribute from the device even if it is cached.
+
+The MQTT callback only parses the topic and queues the command, the send
+worker hands it to the HAN client (FUN_MSG). Each command is acknowledged
+on the same topic with /ack instead of /set:
+
+    {"status": "delivered", "cookie": 12, "queue_ms": 0.3, "send_ms": 0.1, "delivery_ms": 85.2}
+
+status is one of delivered (FUN_MSG_RES received), cached (answered by the
+gateway with the cached attribute values in "values", nothing sent), pending
+(the same attribute is already being read, its value is pushed when it
+arrives), ambiguous (a FUN_MSG_RES without MSG_SEQ while several commands to
+the device were waiting, one of them was answered), timeout, dropped (queue
+full), invalid (payload not understood) and error (send failed).
+"""
+
+import collections
+import json
+import logging
+import queue
+import threading
+import time
+
+
+TOPIC_PREFIX = "homeassistant/ule"
+# MQTT subscription matching all command topics
+COMMAND_TOPIC = TOPIC_PREFIX + "/+/+/+/+/set"
+
+# FUN_MSG message types of a command and a get attribute request
+MSG_TYPE_COMMAND = 1
+MSG_TYPE_GET_ATTRIBUTE = 4
+
+# number of delivery latencies kept for the percentiles of stats()
+LATENCY_SAMPLES = 1024
+
+
+class Answered(object):
+    """Returned by send() for a command answered without sending a FUN_MSG."""
+
+    def __init__(self, status, values=None):
+        # "cached" with the attribute values, or "pending"
+        self.status = status
+        self.values = values
+
+
+class Command(object):
+    """One parsed command, with the times of its way through the pipeline."""
+
+    def __init__(self, device_id, unit_id, interface_id, cmd_id, data=b"", msg_type=MSG_TYPE_COMMAND, bypass=False):
+        self.device_id = device_id
+        self.unit_id = unit_id
+        self.interface_id = interface_id
+        self.cmd_id = cmd_id
+        self.data = data
+        self.msg_type = msg_type
+        self.bypass = bypass
+
+        self.cookie = None
+        self.received = time.monotonic()
+        self.sent = None
+        self.send_done = None
+
+    @property
+    def ack_topic(self):
+        return "{}/{}/{}/{}/{}/ack".format(TOPIC_PREFIX, self.device_id, self.unit_id,
+                                           self.interface_id, self.cmd_id)
+
+    def __repr__(self):
+        return "Command(device={}, unit={}, interface=0x{:04x}, cmd={}, data={})".format(
+            self.device_id, self.unit_id, self.interface_id, self.cmd_id, list(self.data))
+
+
+def _parse_int(value):
+    return int(value, 0) if isinstance(value, str) else int(value)
+
+
+def parse_payload(payload):
+    """Return (msg_type, data bytes, bypass) of a command payload (bytes or str)."""
+    if isinstance(payload, bytes):
+        payload = payload.decode("utf-8")
+    payload = payload.strip()
+    msg_type = MSG_TYPE_COMMAND
+    bypass = False
+    if payload[:1] in ("[", "{"):
+        values = json.loads(payload)
+        if isinstance(values, dict):
+            msg_type = _parse_int(values.get("msg_type", MSG_TYPE_COMMAND))
+            bypass = bool(values.get("bypass", False))
+            values = values.get("data", [])
+    else:
+        values = payload.split()
+    return msg_type, bytes(_parse_int(value) for value in values), bypass
+
+
+def parse_command(topic, payload):
+    """Parse a command topic and payload into a Command, ValueError if it is none."""
+    if not topic.startswith(TOPIC_PREFIX + "/") or not topic.endswith("/set"):
+        raise ValueError("not a command topic: {}".format(topic))
+    ids = topic[len(TOPIC_PREFIX) + 1:-len("/set")].split("/")
+    if len(ids) != 4:
+        raise ValueError("expected <device>/<unit>/<interface>/<command>: {}".format(topic))
+    device_id, unit_id, interface_id, cmd_id = (_parse_int(value) for value in ids)
+    msg_type, data, bypass = parse_payload(payload)
+    return Command(device_id, unit_id, interface_id, cmd_id, data, msg_type, bypass)
+
+
+def _percentile(values, pct):
+    if not values:
+        return None
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * pct / 100.0))]
+
+
+def _ms(start, end):
+    return None if start is None or end is None else round((end - start) * 1000, 3)
+
+
+class CommandIngest(object):
+    """Queue MQTT commands and send them to the HAN client from a worker thread.
+
+    Usage:
+
+        ingest = CommandIngest(send=lambda cmd: send_cmd(client_handle, ...), ack=mqttc.publish_ack)
+        mqttc.message_callback_add(COMMAND_TOPIC, ingest.on_message)
+        client_handle.subscribe("fun_msg_res", ingest.handle_fun_msg_res)
+
+    send(command) sends the FUN_MSG and returns its cookie (MSG_SEQ), or an Answered if
+    the command was answered without sending (e.g. a cached attribute). None counts as
+    cached without values.
+    ack(topic, payload) publishes the acknowledgement, it must not block either.
+    on_message() never blocks: if maxsize commands are queued, the command is dropped.
+    Commands not confirmed by FUN_MSG_RES within timeout seconds are acknowledged
+    with status timeout.
+    """
+
+    def __init__(self, send, ack, maxsize=256, timeout=5.0):
+        self._send = send
+        self._ack = ack
+        self.timeout = timeout
+        self._queue = queue.Queue(maxsize)
+        # cookie -> Command sent and waiting for FUN_MSG_RES, in order of sending
+        self._pending = collections.OrderedDict()
+        # command in send(), and cookie -> time of the FUN_MSG_RES received before it is pending
+        self._sending = None
+        self._early = {}
+        self._lock = threading.Lock()
+        self._latencies = collections.deque(maxlen=LATENCY_SAMPLES)
+        self.counters = collections.Counter()
+
+        self._worker = threading.Thread(target=self._work, name='mqtt-commands')
+        self._worker.daemon = True
+        self._worker.start()
+
+    def on_message(self, client, userdata, msg):
+        """paho on_message callback for COMMAND_TOPIC."""
+        self.put(msg.topic, msg.payload)
+
+    def put(self, topic, payload):
+        """Parse and queue a command, returns the Command or None."""
+        self._count("received")
+        try:
+            command = parse_command(topic, payload)
+        except (ValueError, TypeError, AttributeError) as e:
+            self._count("invalid")
+            logging.warning("invalid command %s %r: %s", topic, payload, e)
+            if topic.endswith("/set"):
+                self._publish_ack(topic[:-len("/set")] + "/ack", {"status": "invalid", "error": str(e)})
+            return None
+        try:
+            self._queue.put_nowait(command)
+        except queue.Full:
+            self._count("dropped")
+            self._acknowledge(command, "dropped")
+            return None
+        return command
+
+    def stop(self):
+        self._queue.put(None)
+        self._worker.join(2 * self.timeout)
+
+    def handle_fun_msg_res(self, client, msg):
+        """HAN client subscriber for FUN_MSG_RES, acknowledges the command delivered."""
+        done = time.monotonic()
+        seq = msg.params.get("MSG_SEQ")
+        with self._lock:
+            if seq is not None:
+                command = self._pending.pop(int(seq), None)
+                if command is None and self._sending is not None:
+                    # answered before send() returned, taken over by _work
+                    self._early[int(seq)] = done
+                    return
+                commands = [command] if command is not None else []
+            else:
+                # no cookie in the response: only a single command to that device is answered
+                device_id = int(msg.params.get("DEV_ID", -1))
+                cookies = [cookie for cookie, cmd in self._pending.items() if cmd.device_id == device_id]
+                commands = [self._pending.pop(cookie) for cookie in cookies]
+            status = "delivered" if len(commands) == 1 else "ambiguous"
+            for command in commands:
+                self._latencies.append(done - command.received)
+                self.counters[status] += 1
+        for command in commands:
+            self._acknowledge(command, status, done)
+
+    def stats(self):
+        """Counters and p50/p99 of the time from MQTT to FUN_MSG_RES in ms."""
+        with self._lock:
+            latencies = list(self._latencies)
+            pending = len(self._pending)
+            stats = dict(self.counters, queued=self._queue.qsize(), pending=pending)
+        for pct in (50, 99):
+            value = _percentile(latencies, pct)
+            stats["p{}_ms".format(pct)] = None if value is None else round(value * 1000, 3)
+        return stats
+
+    def _acknowledge(self, command, status, done=None, values=None):
+        payload = {
+            "status": status,
+            "cookie": command.cookie,
+            "queue_ms": _ms(command.received, command.sent),
+            "send_ms": _ms(command.sent, command.send_done),
+            "delivery_ms": _ms(command.received, done),
+        }
+        if values is not None:
+            payload["values"] = list(values)
+        self._publish_ack(command.ack_topic, payload)
+
+    def _count(self, name):
+        # counters are written by the MQTT, worker and HAN rx threads
+        with self._lock:
+            self.counters[name] += 1
+
+    def _publish_ack(self, topic, payload):
+        try:
+            self._ack(topic, payload)
+        except Exception:
+            logging.exception("command ack failed: %s", topic)
+
+    def _expire(self):
+        now = time.monotonic()
+        with self._lock:
+            expired = [cookie for cookie, cmd in self._pending.items() if now - cmd.send_done > self.timeout]
+            expired = [self._pending.pop(cookie) for cookie in expired]
+            self.counters["timeout"] += len(expired)
+        for command in expired:
+            self._acknowledge(command, "timeout")
+
+    def _work(self):
+        while True:
+            try:
+                command = self._queue.get(timeout=min(1.0, self.timeout))
+            except queue.Empty:
+                self._expire()
+                continue
+            if command is None:
+                return
+            command.sent = time.monotonic()
+            # not sent under the lock, the HAN rx thread takes it for FUN_MSG_RES
+            with self._lock:
+                self._sending = command
+            try:
+                result = self._send(command)
+            except Exception:
+                with self._lock:
+                    self._sending = None
+                    self._early.clear()
+                    self.counters["error"] += 1
+                logging.exception("sending %s failed", command)
+                command.send_done = time.monotonic()
+                self._acknowledge(command, "error")
+                self._expire()
+                continue
+            command.send_done = time.monotonic()
+            done = None
+            with self._lock:
+                self._sending = None
+                if result is not None and not isinstance(result, Answered):
+                    command.cookie = result
+                    # FUN_MSG_RES may have arrived before send() returned
+                    done = self._early.pop(command.cookie, None)
+                    if done is None:
+                        self._pending[command.cookie] = command
+                    else:
+                        self._latencies.append(done - command.received)
+                        self.counters["delivered"] += 1
+                    self.counters["sent"] += 1
+                self._early.clear()
+            if command.cookie is None:
+                answer = result or Answered("cached")
+                # stats() has "pending" for the commands waiting for FUN_MSG_RES
+                self._count("read_pending" if answer.status == "pending" else answer.status)
+                self._acknowledge(command, answer.status, command.send_done, answer.values)
+            elif done is not None:
+                self._acknowledge(command, "delivered", done)
+            self._expire()
@@ -5,6 +5,93 @@ from typing import List
 import copy
 
 
+class ListIndex:
+    """Lookup of list entries by one attribute (e.g. device_id) in O(1).
+
+    Keeps the position of the first entry per key. The list stays the owner of the entries and
+    their order, its owner keeps the index up to date: add() after appending an entry, remove()
+    after removing one, rebuild() after changing the list otherwise. A list replaced by another
+    list object, or whose length has changed, is indexed on the next lookup. Otherwise a key which
+    is not indexed is a miss, the list is not searched again.
+    """
+    def __init__(self, attr: str):
+        self.attr = attr
+        self.positions = {}
+        self._items = None
+        self._length = 0
+
+    def rebuild(self, items: list):
+        self._items = items
+        self._length = len(items)
+        self.positions = {}
+        for pos, item in enumerate(items):
+            if item:
+                self.positions.setdefault(getattr(item, self.attr), pos)
+
+    def add(self, items: list, item):
+        # item has been appended to items
+        if items is not self._items or len(items) != self._length + 1:
+            self.rebuild(items)
+            return
+        self._length += 1
+        if item:
+            self.positions.setdefault(getattr(item, self.attr), len(items) - 1)
+
+    def remove(self, items: list):
+        # an entry has been removed from items, the entries after it have moved
+        self.rebuild(items)
+
+    def find(self, items: list, key):
+        if items is not self._items or len(items) != self._length:
+            self.rebuild(items)
+        pos = self.positions.get(key)
+        if pos is None:
+            return None
+        if pos >= len(items) or getattr(items[pos], self.attr) != key:
+            # the list was changed without telling the index
+            self.rebuild(items)
+            pos = self.positions.get(key)
+            if pos is None:
+                return None
+        return items[pos]
+
+    def position(self, items: list, key) -> int:
+        item = self.find(items, key)
+        return -1 if item is None else self.positions[key]
+
+
+def _index_field(attr: str):
+    return field(default_factory=lambda: ListIndex(attr), init=False, repr=False, compare=False)
+
+
+class HFBitField:
+    """One entry of HFServerAttribute.attribute_descriptions: (label, start, end[, sign]).
+
+    start/end are bit positions counted from the LSB of the attribute value, end exclusive.
+    Signed fields are two's complement.
+    """
+    __slots__ = ('description', 'label', 'shift', 'width', 'mask', 'sign_bit', 'option')
+
+    def __init__(self, label: str, start: int, end: int, sign: bool = False, option: bool = False):
+        self.description = (label, start, end, sign) if sign else (label, start, end)
+        self.label = label
+        self.shift = start
+        self.width = end - start
+        self.mask = (1 << self.width) - 1
+        self.sign_bit = (1 << (self.width - 1)) if sign and self.width > 0 else 0
+        self.option = option
+
+    def decode(self, value: int) -> int:
+        number = (value >> self.shift) & self.mask
+        if number & self.sign_bit:
+            number -= self.mask + 1
+        return number
+
+    def encode(self, value: int, number: int) -> int:
+        # out of range numbers are cut to the field width
+        return (value & ~(self.mask << self.shift)) | ((number & self.mask) << self.shift)
+
+
 @dataclass
 class HFServerAttribute:
     attribute_id : int
@@ -12,6 +99,7 @@ class HFServerAttribute:
     attribute_type : int # length in bytes
     attribute_values: List[bytes] = field(default_factory=lambda: [])
     attribute_descriptions: List[dict] = field(default_factory=lambda: [])
+    _bitfields : tuple = field(default=None, init=False, repr=False, compare=False)
 
     def f_comma(self, my_str, group=8, char='|') -> str:
         my_str = str(my_str)
@@ -35,127 +123,83 @@ class HFServerAttribute:
         header += "{0}\n".format('-'.rjust(len(header)-1, '-'))
         printout += header
         # -----------------------------
-        option_header = ''
-        for dd in self.attribute_descriptions:
-            if type(dd) != list:
-                # build a one element List - not a options list
-                d_list = [dd]
-            else:
-                # use the options list
-                d_list = dd
-                option_header = 'opt:'
-
-            for d in d_list:
-                sign = False
-                if len(d) == 3:
-                    label, start, end = d
-                if len(d) == 4: # with sign 
-                    label, start, end, sign = d
-                    
-                # bit position 0 starts from left
-                end_t = bit_length - start
-                start = bit_length - end
-                end = end_t
-                number = int(f'0b{bitstring[start:end]}', 2)
-                if sign:
-                    signed_bitstring = bitstring[start:end]
-                    if signed_bitstring[0] == '1':
-                        number ^= 2**(end-start)-1
-                        number += 1
-                        number= -number    
-                printout_t = "{}0b{} :{} = {} ({})\n".format(option_header,
-                    self.f_comma(bitstring[start:end].rjust(end,'.').ljust(bit_length, '.')),
-                    label, 
-                    number,
-                    hex(int(f'0b{bitstring[start:end]}', 2))
-                    )
-                printout += printout_t
+        for bf in self._get_bitfields():
+            # bit position 0 starts from left
+            start = bit_length - bf.shift - bf.width
+            end = bit_length - bf.shift
+            printout_t = "{}0b{} :{} = {} ({})\n".format('opt:' if bf.option else '',
+                self.f_comma(bitstring[start:end].rjust(end,'.').ljust(bit_length, '.')),
+                bf.label, 
+                bf.decode(int_val),
+                hex((int_val >> bf.shift) & bf.mask)
+                )
+            printout += printout_t
         return printout
 
     def __repr__(self) -> str:
         return self._pp_to_str()
 
-    def get_description_tuple_by_name(self, attr_desc) -> tuple:
-        for dd in self.attribute_descriptions:
-            if type(dd) != list:
-                # build a one element List
-                d_list = [dd]
-            else:
-                # use the options list
-                d_list = dd
-            for d in d_list:
-                if len(d) == 3:
-                    label, start, end = d
-                elif len(d) == 4: # with sign 
-                    label, start, end, sign = d
+    def _get_bitfields(self) -> List['HFBitField']:
+        # compiled once per attribute_descriptions list, deepcopy keeps the cache valid
+        if self._bitfields is None or self._bitfields[0] is not self.attribute_descriptions:
+            bitfields = []
+            option = False
+            for dd in self.attribute_descriptions:
+                if type(dd) != list:
+                    # build a one element List - not a options list
+                    d_list = [dd]
                 else:
-                    return None
-                if attr_desc in label:
-                    return d
-        return None
+                    # use the options list, once an option list was seen all following fields are printed as options
+                    d_list = dd
+                    option = True
+                for d in d_list:
+                    if len(d) in (3, 4):
+                        bitfields.append(HFBitField(*d, option=option))
+            self._bitfields = (self.attribute_descriptions, bitfields, {})
+        return self._bitfields[1]
+
+    def get_bitfield_by_name(self, attr_desc) -> 'HFBitField':
+        bitfields = self._get_bitfields()
+        by_name = self._bitfields[2]
+        if attr_desc not in by_name:
+            by_name[attr_desc] = next((bf for bf in bitfields if attr_desc in bf.label), None)
+        return by_name[attr_desc]
+
+    def get_description_tuple_by_name(self, attr_desc) -> tuple:
+        bf = self.get_bitfield_by_name(attr_desc)
+        return bf.description if bf else None
 
     def set_attribute_value_by_description(self, attr_desc: str, new_slice_value: int) -> bool:        
-        sign = False
-        # get all value bytes
+        bf = self.get_bitfield_by_name(attr_desc)
+        if bf is None:
+            print(f'attribute_description: {attr_desc} does not exist. value unchanged!')
+            return False
         try:
             full_value = int.from_bytes(bytes(self.attribute_values), "big")
-            desc = self.get_description_tuple_by_name(attr_desc) 
-            if desc == None:
-                print(f'attribute_description: {attr_desc} does not exist. value unchanged!')
-                return False
+            full_value = bf.encode(full_value, new_slice_value)
+            self.attribute_values = list(full_value.to_bytes(len(self.attribute_values), 'big'))
         except:
             print('set_attribute_value_by_description: something went wrong!')
             return False
-        if len(desc) == 3:
-            label, start, end = desc
-        elif len(desc) == 4: # with sign 
-            label, start, end, sign = desc
-        else:
-            return False   
-        
-        slice_length = end - start
-        slice_mask = 2**slice_length-1
-        slice_mask = slice_mask << start
-        full_value &= ~slice_mask
-        if sign == True and new_slice_value < 0:
-            # cut slice vlaue to valid range
-            new_slice_value = abs(new_slice_value)
-            new_slice_value &= 2**(slice_length) - 1
-            new_slice_value *= -1
-        else:
-            new_slice_value &= 2**(slice_length) - 1
-             
-        full_value += new_slice_value << start 
-        bytes_val = full_value.to_bytes(len(self.attribute_values), 'big')
-        self.attribute_values = list(bytes_val)
         return True 
     
     def get_attribute_value_by_description(self, attr_desc: str) -> int:
-        ad = self.get_description_tuple_by_name(attr_desc)
-        if ad != None:
-            sign = False
-            if len(ad) == 3:
-                label, start, end = ad
-            if len(ad) == 4: # with sign 
-                label, start, end, sign = ad
-            if attr_desc in label:
-                int_val = int.from_bytes(bytes(self.attribute_values), "big")
-                bit_length = self.attribute_type*8
-                end_t = bit_length - start
-                start = bit_length - end
-                end = end_t
-                bitstring_t = bin(int_val)
-                bitstring = bitstring_t[2:].rjust(bit_length,'0')
-                #print(f"0b{bitstring[start:end]} == {int(f'0b{bitstring[start:end]}', 2)}, {hex(int(f'0b{bitstring[start:end]}', 2))}")
-                number = int(f'0b{bitstring[start:end]}', 2)
-                if sign:
-                    signed_bitstring = bitstring[start:end]
-                    if signed_bitstring[0] == '1':
-                        number ^= 2**(end-start)-1
-                        number += 1
-                        number= -number            
-                return number
-        return 'NaN'
+        bf = self.get_bitfield_by_name(attr_desc)
+        if bf is None:
+            return 'NaN'
+        return bf.decode(int.from_bytes(bytes(self.attribute_values), "big"))
+
+    def get_decoded_values(self) -> dict:
+        # label -> value of every field, options of the same bits are decoded once with the first label
+        int_val = int.from_bytes(bytes(self.attribute_values), "big")
+        values = {}
+        seen = set()
+        for bf in self._get_bitfields():
+            if (bf.shift, bf.width) in seen:
+                continue
+            seen.add((bf.shift, bf.width))
+            values[bf.label.strip()] = bf.decode(int_val)
+        return values
 
     def add_attribute_values(self, l):
         # l must be list of bytes
@@ -184,29 +228,9 @@ class HFC2SCommand:
     payload_descriptions : List[HFServerAttribute] = field(default_factory=lambda: [])
 
     def get_attribute_value_by_description(self, attr_desc: str) -> int:
-        for ad in self.payload_descriptions:     
-            sign = False
-            if len(ad) == 3:
-                label, start, end = ad
-            if len(ad) == 4: # with sign 
-                label, start, end, sign = ad
-            if attr_desc in label:
-                int_val = int.from_bytes(bytes(self.attribute_values), "big")
-                bit_length = self.attribute_type*8
-                end_t = bit_length - start
-                start = bit_length - end
-                end = end_t
-                bitstring_t = bin(int_val)
-                bitstring = bitstring_t[2:].rjust(bit_length,'0')
-                #print(f"0b{bitstring[start:end]} == {int(f'0b{bitstring[start:end]}', 2)}, {hex(int(f'0b{bitstring[start:end]}', 2))}")
-                number = int(f'0b{bitstring[start:end]}', 2)
-                if sign:
-                    signed_bitstring = bitstring[start:end]
-                    if signed_bitstring[0] == '1':
-                        number ^= 2**(end-start)-1
-                        number += 1
-                        number= -number            
-                return number
+        for pd in self.payload_descriptions:
+            if pd.get_bitfield_by_name(attr_desc) is not None:
+                return pd.get_attribute_value_by_description(attr_desc)
         return 0
 
 @dataclass
@@ -337,12 +361,16 @@ class HFInterface:
 class HFInterfaces:
     intrf_list_name : str = 'Currently available Interfaces'
     interfaces : List[HFInterface] = field(default_factory=lambda: [])
+    _by_id : ListIndex = _index_field('intrf_id')
+    _by_name : ListIndex = _index_field('intrf_name')
 
     def add_interface(self, interface: HFInterface):
         # l must be list of bytes
         # dataclass does not know .add for lists
         try:
             self.interfaces.append(copy.deepcopy(interface))
+            self._by_id.add(self.interfaces, self.interfaces[-1])
+            self._by_name.add(self.interfaces, self.interfaces[-1])
         except:
             logging.exception(f'cannot add Interface {interface} to list.') 
 
@@ -354,7 +382,7 @@ class HFInterfaces:
 
     def get_interface_by_name(self, intrf_name) -> HFInterface:
         if len(self.interfaces) > 0:
-            match = next((interface for interface in self.interfaces if interface and interface.intrf_name == intrf_name), None)
+            match = self._by_name.find(self.interfaces, intrf_name)
             if match:
                 return match
             else:
@@ -366,7 +394,7 @@ class HFInterfaces:
     def get_interface_by_id(self, intrf_id) -> HFInterface:
         ## hex value as string should also be supported.
         if len(self.interfaces) > 0:
-            match = next((interface for interface in self.interfaces if interface and interface.intrf_id == intrf_id), None)
+            match = self._by_id.find(self.interfaces, intrf_id)
             if match:
                 return match
             else:
@@ -378,10 +406,12 @@ class HFInterfaces:
     def delete_interface_by_id(self, intrf_id) -> bool:
         ## hex value as string should also be supported.
         if len(self.interfaces) > 0:
-            match = next((interface for interface in self.interfaces if interface and interface.intrf_id == intrf_id), None)
+            match = self._by_id.find(self.interfaces, intrf_id)
             if match:
                 try:
                     self.interfaces.remove(match)
+                    self._by_id.remove(self.interfaces)
+                    self._by_name.remove(self.interfaces)
                 except:
                     logging.exception('Could not remove element {} unexpectedly.', match)
                 return True
@@ -1266,11 +1296,12 @@ class HFUnit:
         self.unit_name = unit_name
         self.interfaces = copy.deepcopy(interfaces)
         #print('deepcopy profile and interfaces')
+        self._by_id = ListIndex('intrf_id')
 
     def get_interface_by_id(self, intrf_id) -> HFInterface:
         ## hex value as string should also be supported.
         if len(self.interfaces) > 0:
-            match = next((interface for interface in self.interfaces if interface and interface.intrf_id == intrf_id), None)
+            match = self._by_id.find(self.interfaces, intrf_id)
             if match:
                 return match
             else:
@@ -1283,10 +1314,12 @@ class HFUnit:
 class HFUnitsa:
     unit_list_name : str = 'Current available Units'
     units : List[HFUnit] = field(default_factory=lambda: [])
+    _by_id : ListIndex = _index_field('unit_id')
 
     def add_unit(self, unit: HFUnit):
         try:
             self.units.append(copy.deepcopy(unit))
+            self._by_id.add(self.units, self.units[-1])
         except:
             logging.exception(f'cannot add Unit {unit} to list.') 
 
@@ -1299,7 +1332,7 @@ class HFUnitsa:
     def get_unit_by_id(self, unit_id) -> HFUnit:
         ## hex value as string should also be supported.
         if len(self.units) > 0:
-            match = next((unit for unit in self.units if unit and unit.unit_id == unit_id), None)
+            match = self._by_id.find(self.units, unit_id)
             if match:
                 return match
             else:
@@ -1314,11 +1347,13 @@ class HFDevice:
     device_ipui : str
     device_name : str
     units : List[HFUnit] = field(default_factory=lambda: [])
+    version : int = field(default=0, compare=False)  # incremented by HFDevices on every change
+    _by_id : ListIndex = _index_field('unit_id')
 
     def get_unit_by_id(self, unit_id: int) -> HFUnit:
         ## hex value as string should also be supported.
         if len(self.units) > 0:
-            match = next((unit for unit in self.units if unit and unit.unit_id == unit_id), None)
+            match = self._by_id.find(self.units, unit_id)
             if match:
                 return match
             else:
@@ -1331,10 +1366,23 @@ class HFDevice:
 class HFDevices:
     device_list_name : str = 'Currently available Devices'
     devices : List[HFDevice] = field(default_factory=lambda: [])
-
-    def add_device(self, device: HFDevice) -> bool:
+    version : int = field(default=0, compare=False)  # incremented on every change of the devices
+    _by_id : ListIndex = _index_field('device_id')
+    _by_name : ListIndex = _index_field('device_name')
+    _listeners : list = field(default_factory=lambda: [], init=False, repr=False, compare=False)
+
+    def add_listener(self, callback, changes_only: bool = True) -> None:
+        # callback(device, unit_id, intrf_id, attribute) after set_attribute_values changed a value,
+        # with changes_only=False for every value received
+        self._listeners.append((callback, changes_only))
+
+    def add_device(self, device: HFDevice, copy_device: bool = True) -> bool:
+        # copy_device=False hands the device over, the caller must not modify it afterwards
         try:
-            self.devices.append(copy.deepcopy(device))
+            self.devices.append(copy.deepcopy(device) if copy_device else device)
+            self._by_id.add(self.devices, self.devices[-1])
+            self._by_name.add(self.devices, self.devices[-1])
+            self.version += 1
             return True
         except:
             logging.exception(f'cannot add Device {device} to list.') 
@@ -1345,21 +1393,76 @@ class HFDevices:
         if dev != None:
             try:
                 self.devices.remove(dev)
+                self._by_id.remove(self.devices)
+                self._by_name.remove(self.devices)
+                self.version += 1
             except:
                 logging.exception(f'cannot remove device {device_id}: {dev}.')
                 return False
         return True
 
     def update_device(self, device: HFDevice) -> bool:
+        # the device (and its units) is taken over without copy, an existing entry
+        # is updated in place and keeps its position
         try:
-            dev = self.get_device_by_id(device.device_id)
-            if dev != None:
-                self.delete_device_by_id(dev.device_id)
-            self.devices.append(copy.deepcopy(device))
-            return True
+            if self._by_id.find(self.devices, device.device_id) is None:
+                return self.add_device(device, copy_device=False)
+            return self.update_device_fields(device.device_id, device_ipui=device.device_ipui,
+                                             device_name=device.device_name, units=device.units)
         except:
             logging.exception(f'cannot update Device {device}.')
             return False
+
+    def update_device_fields(self, device_id: int, **fields) -> bool:
+        # e.g. update_device_fields(3, device_name='Kitchen'), unchanged values do not count as change
+        dev = self._by_id.find(self.devices, device_id)
+        if dev is None:
+            print(f'cannot find Device={device_id}')
+            return False
+
+        changed = False
+        for name, value in fields.items():
+            if name not in ('device_ipui', 'device_name', 'units'):
+                raise AttributeError(f'HFDevice has no updatable field {name}')
+            current = getattr(dev, name)
+            if current is value or current == value:
+                continue
+            setattr(dev, name, value)
+            changed = True
+            if name == 'device_name':
+                self._by_name.rebuild(self.devices)
+
+        if changed:
+            self._touch(dev)
+        return True
+
+    def set_attribute_values(self, device_id: int, unit_id: int, intrf_id: int, attribute_id: int, values) -> bool:
+        # in place update of one server attribute, e.g. from a get attribute response
+        dev = self._by_id.find(self.devices, device_id)
+        unit = dev.get_unit_by_id(unit_id) if dev else None
+        interface = unit.get_interface_by_id(intrf_id) if unit else None
+        attribute = interface.get_attribute_by_id(attribute_id) if interface else None
+        if attribute is None:
+            return False
+        if len(attribute.attribute_values) != len(values):
+            print(f'set_attribute_values: data={values} does not fit attribute={attribute.attribute_name},data={attribute.attribute_values}')
+            return False
+
+        changed = list(attribute.attribute_values) != list(values)
+        if changed:
+            attribute.attribute_values = list(values)
+            self._touch(dev)
+        for callback, changes_only in self._listeners:
+            if changed or not changes_only:
+                try:
+                    callback(dev, unit_id, intrf_id, attribute)
+                except:
+                    logging.exception(f'attribute listener {callback} failed.')
+        return True
+
+    def _touch(self, dev: HFDevice):
+        dev.version += 1
+        self.version += 1
     
     def get_devices(self) -> List[HFDevice]:
         if len(self.devices) > 0:
@@ -1369,7 +1472,7 @@ class HFDevices:
 
     def get_device_by_name(self, device_name) -> HFDevice:
         if len(self.devices) > 0:
-            match = next((device for device in self.devices if device and device.device_name == device_name), None)
+            match = self._by_name.find(self.devices, device_name)
             if match:
                 return match
             else:
@@ -1381,7 +1484,7 @@ class HFDevices:
     def get_device_by_id(self, device_id) -> HFDevice:
         ## hex value as string should also be supported.
         if len(self.devices) > 0:
-            match = next((device for device in self.devices if device and device.device_id == device_id), None)
+            match = self._by_id.find(self.devices, device_id)
             if match:
                 return match
             else:
@@ -1424,6 +1527,7 @@ def dev_update_to_becker_rolladen(dev: HFDevice) -> bool:
         # lamellar
         if u.profile.profile_id == 0x011A:
             dev.device_name = 'Becker Rolladen, Lamellensteuerung'
+        u._by_id.rebuild(u.interfaces)
 
 def dev_update_profile_changes(dev: HFDevice) -> bool:
     known_interfaces = HFInterfaces()
@@ -1579,6 +1683,8 @@ def dev_update_profile_changes(dev: HFDevice) -> bool:
             else: 
                 return False       
 
+    for u in dev.units:
+        u._by_id.rebuild(u.interfaces)
     return True
 
 
@@ -18,6 +18,9 @@ import prompt_toolkit.completion
  
 import han_client
 import _thread
+import threading
+from device_store import DeviceStore
+from attribute_cache import AttributeCache
 
 import logging
 import copy
@@ -48,47 +51,33 @@ def process_rx_data(client, data_str):
 
 
 def handle_dev_registered(client, msg):
-    global devices_list
-    global hf_devices
-
     device_id = int(msg.params["DEV_ID"])
     log("Device {}: registered (or registration updated)".format(device_id))
-    # search for new ULE device
+    # the units may have changed, read the values again
+    attribute_cache.invalidate(device_id)
+    # requests to the HAN server cannot be made from the rx thread
+    threading.Thread(target=update_registered_device, args=(client, device_id), daemon=True).start()
+
+
+def update_registered_device(client_handle, device_id):
+    """Read a new or re-registered device from the HAN server and take it over."""
+    global devices_list
+
     try:
-        list_id = get_list_id_by_device_id(device_id)
-        if list_id == -1:
-            print('FATAL, dev id not found')
-            return 
-        dev = devices_list[list_id]
-    except ValueError:
-        print("The device ID has to be a number")
+        dev = client_handle.get_dev_info(device_id).device
+    except han_client.TimeoutException:
+        log("Device {}: no device info from HAN server".format(device_id))
+        return
+    if dev is None:
+        log("Device {}: device info failed".format(device_id))
+        return
 
-    # add to snom data structure
-    new_units_list = []
-    for unit in dev.units:
-        new_profile = HFProfiles().get_profile_by_id(unit.type) or HFProfile(profile_id=unit.type)
-        new_interfaces_list = []  
-        for interface in unit.interfaces:
-            # unknown interfaces will add 'ID' to the interface list
-            new_interface = hf_interfaces.get_interface_by_id(interface.id)
-            if new_interface != None:
-                new_interfaces_list.append(new_interface)
-            #print(new_interface)
-            #log('interface {}, type={}'.format(hex(interface.id), hex(interface.type)))
-        new_unit = HFUnit(unit_id=unit.id, unit_name=str(unit.id), profile=new_profile, interfaces=new_interfaces_list)
-        new_units_list.append(new_unit)
-        #print(new_unit)
-    new_device = HFDevice(device_id=dev.id, device_name=str(dev.id), device_ipui=dev.ipui, units=new_units_list)
-    hf_devices.update_device(new_device)
-    # update deletes the old device and replaces it with the new one
-    # we need to get the new device
-    final_device = hf_devices.get_device_by_id(new_device.device_id)
-    print('####################################################')
-    print('correct interface attributes depending on profile')
-    print('apply known profile changes for interfaces')
-    print(f'update dev {final_device.device_id}:{final_device.device_name}')
-    dev_update_profile_changes(final_device)
-    print('####################################################')
+    with devices_lock:
+        # replaced, not changed in place, readers keep the list they got
+        devices_list = sorted([d for d in devices_list if d.id != dev.id] + [dev], key=lambda d: d.id)
+        if stored_devices is not None:
+            stored_devices.put(dev)
+        hf_devices.update_device(make_hf_device(dev))
     
 
 def handle_reg_closed(client, msg):
@@ -97,9 +86,9 @@ def handle_reg_closed(client, msg):
 
 
 def handle_fun_msg(client, msg):
-    device_id = int(msg.params["SRC_DEV_ID"])
-    unit_id = int(msg.params["SRC_UNIT_ID"])
-    interface_id = int(msg.params["INTRF_ID"])
+    device_id = msg.src_dev_id
+    unit_id = msg.src_unit_id
+    interface_id = msg.interface_id
 
     if unit_id == 0 and interface_id == 0x0115:
         # device management unit, keep-alive interface
@@ -312,6 +301,26 @@ FUN_MSG
 #
 
 devices_list = []
+# device id -> position in devices_list
+devices_list_index = ListIndex('id')
+# serializes the updates of devices_list and hf_devices (startup, reconcile, registration,
+# delete); devices_list is replaced as a whole, hf_devices entries get new units
+devices_lock = threading.RLock()
+# last known device table, opened by main_*()
+DEVICE_STORE_PATH = 'snom_hf_devices.db'
+stored_devices = None
+
+def open_device_store(path=DEVICE_STORE_PATH):
+    global stored_devices
+    stored_devices = DeviceStore(path)
+
+def start_devices(client_handle, store_path=DEVICE_STORE_PATH):
+    """Start from the stored device table and check it against the HAN server in the background."""
+    open_device_store(store_path)
+    if load_stored_devices(client_handle):
+        threading.Thread(target=reconcile_devices, args=(client_handle,), daemon=True).start()
+    else:
+        list_devices(client_handle, '')
 
 def list_devices(client_handle, argv):
     """
@@ -325,23 +334,12 @@ DESCRIPTION
 Lists the all the information for each device registered to the hub.
     """
     global devices_list
-    devices_list = []
-
-
-    index = 0
-    count = 5
-    while True:
-        resp = client_handle.get_dev_table(index=index, count=count)
-        for dev in resp.devices:
-            print(f'device on DCX81: {dev}')
-            devices_list.append(dev)
-
-        # If there are fewer devices than we have asked for we have retrieved them all,
-        # otherwise we need to move the index and check if there are more.
-        if len(resp.devices) < count:
-            break
-        else:
-            index += count
+    try:
+        devices = fetch_dev_table(client_handle)
+    except (han_client.TimeoutException, han_client.ResponseException) as e:
+        # a partial table would drop the devices not read, keep the current one
+        log(f'device table not read from HAN server, devices unchanged: {e}')
+        return
 
     #for dev in devices_list:
     #    for unit in dev.units:
@@ -349,8 +347,71 @@ Lists the all the information for each device registered to the hub.
     #        for interface in unit.interfaces:
     #            log('interface {}, type={}'.format(hex(interface.id), hex(interface.type)))
 
-    # save all in the HF structure
-    snom_store_devices(client_handle, argv)
+    with devices_lock:
+        devices_list = devices
+        stored_devices.replace_all(devices)
+
+        # save all in the HF structure
+        snom_store_devices(client_handle, argv)
+
+def fetch_dev_table(client_handle) -> list:
+    # all pages, requested ahead with the largest page size the HAN server accepts
+    devices = client_handle.get_full_dev_table()
+    for dev in devices:
+        print(f'device on DCX81: {dev}')
+    return devices
+
+def load_stored_devices(client_handle) -> bool:
+    """Start from the stored device table, False if the store is empty."""
+    global devices_list
+
+    devices = stored_devices.load()
+    if not devices:
+        return False
+    log(f'{len(devices)} devices loaded from store')
+    with devices_lock:
+        devices_list = devices
+        snom_store_devices(client_handle, '')
+    return True
+
+def reconcile_devices(client_handle):
+    """Compare the stored device table with the HAN server, rebuild on changes only."""
+    global devices_list
+
+    with devices_lock:
+        known = {dev.id: dev for dev in devices_list}
+    try:
+        # DEV_INFO is requested for new and changed devices only
+        devices = client_handle.get_dev_snapshot(known=known)
+    except (han_client.TimeoutException, han_client.ResponseException) as e:
+        log(f'device table not read from HAN server, keep the stored one: {e}')
+        return
+    with devices_lock:
+        if stored_devices.replace_all(devices):
+            log('device table changed on HAN server, update devices')
+            devices_list = devices
+            snom_store_devices(client_handle, '')
+
+def make_hf_device(dev) -> HFDevice:
+    """HFDevice of a device table entry, with the known profile changes applied.
+
+    The device is complete before hf_devices takes it over, the entries read by the
+    HAN rx and web server threads are not changed in place."""
+    new_units_list = []
+    for unit in dev.units:
+        new_profile = HFProfiles().get_profile_by_id(unit.type) or HFProfile(profile_id=unit.type)
+        new_interfaces_list = []  
+        for interface in unit.interfaces:
+            # unknown interfaces will add 'ID' to the interface list
+            new_interface = hf_interfaces.get_interface_by_id(interface.id)
+            if new_interface != None:
+                new_interfaces_list.append(new_interface)
+        new_unit = HFUnit(unit_id=unit.id, unit_name=str(unit.id), profile=new_profile, interfaces=new_interfaces_list)
+        new_units_list.append(new_unit)
+    new_device = HFDevice(device_id=dev.id, device_name=str(dev.id), device_ipui=dev.ipui, units=new_units_list)
+    print(f'update dev {new_device.device_id}:{new_device.device_name}')
+    dev_update_profile_changes(new_device)
+    return new_device
 
 def snom_store_devices(client_handle, argv):
     """
@@ -358,40 +419,30 @@ NAME
 snom_store_devices - store information about all the devices in HFDevices
 
 DESCRIPTION
-Stores all the information for each device registered to the hub in HFDevices  
+Stores all the information for each device in devices_list in HFDevices. The
+device table is not read from the hub, use devices for that.
     """
     global devices_list
     global hf_devices
 
-    for dev in devices_list:
-        new_units_list = []
-        for unit in dev.units:
-            new_profile = HFProfiles().get_profile_by_id(unit.type) or HFProfile(profile_id=unit.type)
-            new_interfaces_list = []  
-            for interface in unit.interfaces:
-                # unknown interfaces will add 'ID' to the interface list
-                new_interface = hf_interfaces.get_interface_by_id(interface.id)
-                if new_interface != None:
-                    new_interfaces_list.append(new_interface)
-                #print(new_interface)
-                #log('interface {}, type={}'.format(hex(interface.id), hex(interface.type)))
-            new_unit = HFUnit(unit_id=unit.id, unit_name=str(unit.id), profile=new_profile, interfaces=new_interfaces_list)
-            new_units_list.append(new_unit)
-            #print(new_unit)
-        new_device = HFDevice(device_id=dev.id, device_name=str(dev.id), device_ipui=dev.ipui, units=new_units_list)
-        hf_devices.update_device(new_device)
-        
-    print('####################################################')
-    print('correct interface attributes depending on profile')
-    print('apply known profile changes for interfaces')
-    for dev in hf_devices.get_devices():
-        print(f'update dev {dev.device_id}:{dev.device_name}')
-        dev_update_profile_changes(dev)    
-    print('####################################################')
-    # read data from attributes - which attributes are related to cmds cannot be known 
-    #device_info(client_handle, ['aa', '12'])
-    #print('Create Snom Minibrowser Files ')
-    create_minibrowser_ULE(hf_devices)
+    with devices_lock:
+        print('####################################################')
+        print('correct interface attributes depending on profile')
+        print('apply known profile changes for interfaces')
+        for dev in devices_list:
+            hf_devices.update_device(make_hf_device(dev))
+
+        known_ids = {dev.id for dev in devices_list}
+        for dev in list(hf_devices.get_devices()):
+            if dev.device_id not in known_ids:
+                hf_devices.delete_device_by_id(dev.device_id)
+        print('####################################################')
+        # read data from attributes - which attributes are related to cmds cannot be known 
+        #device_info(client_handle, ['aa', '12'])
+        #print('Create Snom Minibrowser Files ')
+        create_minibrowser_ULE(hf_devices)
+        # render all pages again
+        render_cache.clear()
     print('####################################################')
 
     
@@ -490,6 +541,11 @@ def snom_attrib_info(client_handle, argv):
     """
     """
 
+    # 'bypass' as last argument always asks the device
+    bypass = argv[-1] == 'bypass'
+    if bypass:
+        argv = argv[:-1]
+
     if len(argv) < 5:
         print("attrib_info requires a device ID, unit ID, Interface ID, Attribute ID")
         return
@@ -503,8 +559,9 @@ def snom_attrib_info(client_handle, argv):
             try:
                 attribute_id = int(attribute_id)
                 attribute_id = int(attrb.attribute_id)
-                # read the attribute from the device.
-                send_cmd(client_handle, int(device_id), int(unit_id), int(interface_id), 4, attribute_id, '')
+                # read the attribute from the device, unless it is cached
+                attribute_cache.read((int(device_id), int(unit_id), int(interface_id), attribute_id),
+                                     lambda key: send_cmd(client_handle, key[0], key[1], key[2], 4, key[3], ''), bypass)
                 #time.sleep(1.5)
                 #print(interface.get_attribute_by_id(attribute_id))
             except:
@@ -560,7 +617,10 @@ delete device_id * - where * is not y or Y, blacklists the device for future del
     client_handle.delete_dev(device_id, local=local_delete)
 
     # remove it from snom data 
-    hf_devices.delete_device_by_id(device_id)
+    with devices_lock:
+        hf_devices.delete_device_by_id(device_id)
+        stored_devices.delete(device_id)
+    attribute_cache.invalidate(device_id)
 
 
 def start_voice_call(client_handle, argv):
@@ -624,12 +684,17 @@ NAME
 send_get_attribute_request - requests attribute with id from interface on device 
 
 SYNOPSIS
-send_get_attribute_request device_id unit_id interface attribute_id
+send_get_attribute_request device_id unit_id interface attribute_id [bypass]
 
 DESCRIPTION
-Requests an attribute from unit-interface on device 
+Requests an attribute from unit-interface on device. A value received within
+its TTL is shown from the attribute cache instead, bypass always asks the device.
     """
 
+    bypass = argv[-1] == 'bypass'
+    if bypass:
+        argv = argv[:-1]
+
     if len(argv) == 6:
         _, device_id, unit_id, interface_id, attr_id, user_data = argv
         print("deviceID={}, interface_id={}, attr_id={} and data=({})".format(device_id, unit_id, interface_id, attr_id, user_data))
@@ -650,8 +715,12 @@ Requests an attribute from unit-interface on device
         print("The device ID ({}), unit_id={}, interface_id ({}) attr_id ({}) has to be a number".format(device_id, unit_id, interface_id, attr_id))
         return
 
-    ## create attribute request 
-    send_attr_request(client_handle, device_id, unit_id, interface_id, attr_id) # request attribute # ID
+    ## create attribute request, unless the value is cached
+    values = attribute_cache.read((device_id, unit_id, interface_id, attr_id),
+                                  lambda key: send_attr_request(client_handle, *key), bypass) # request attribute # ID
+    if values is not None:
+        log("Device {}: attribute {} on unit {}-interface {} from cache: {}".format(device_id, attr_id, unit_id, interface_id, values))
+        return
     log("Device {}: attribute {} requested on unit {}-interface {}. message has been queued for delivery ...".format(device_id, attr_id, unit_id, interface_id))
 
 
@@ -661,12 +730,18 @@ NAME
 send_get_attributes_pack_request - requests mandatory and optional attributes from interface on device 
 
 SYNOPSIS
-send_get_attributes_pack_request device_id interface
+send_get_attributes_pack_request device_id interface [bypass]
 
 DESCRIPTION
-Requests and attribute from interface on device 
+Requests and attribute from interface on device. If all attributes of the
+interface were received within their TTL, they are shown from the attribute
+cache instead, bypass always asks the device.
     """
 
+    bypass = argv[-1] == 'bypass'
+    if bypass:
+        argv = argv[:-1]
+
     if len(argv) == 5:
         _, device_id, interface_id, attr_id, user_data = argv
         print("deviceID={}, interface_id={}, attr_id={} and data=({})".format(device_id, interface_id, attr_id, user_data))
@@ -685,6 +760,16 @@ Requests and attribute from interface on device
         print("The device ID ({}), interface_id ({}) has to be a number".format(device_id, interface_id, attr_id))
         return
 
+    # the pack request goes to unit 1
+    dev = hf_devices.get_device_by_id(device_id)
+    unit = dev.get_unit_by_id(1) if dev else None
+    interface = unit.get_interface_by_id(interface_id) if unit else None
+    if interface and not bypass:
+        cached = [attribute_cache.get((device_id, 1, interface_id, a.attribute_id)) for a in interface.server_attributes]
+        if cached and None not in cached:
+            log("Device {}: attribute pack on interface {} from cache: {}".format(device_id, interface_id, cached))
+            return
+
     ## create attribute request 
     send_attr_pack_request(client_handle, int(device_id), int(interface_id)) # request all attributes # ID
     log("Device {}: attribute pack requested on interface {}. message has been queued for delivery ...".format(device_id, interface_id))
@@ -1383,6 +1468,7 @@ Exit the han_app program.
     client_handle.destroy()
     # stop the mqtt thread
     print("Quitting MQTT Client...")
+    mqttc.publisher.stop()
     mqttc.loop_stop()
     print("Kill all han_app related processes...")
     subprocess.check_call(['pkill', '-f', '-9', 'han_app'])
@@ -1406,7 +1492,7 @@ def handle_light_bulb(device_id, message_type, interface_id, interface_member, h
         interface = dev.get_unit_by_id(1).get_interface_by_id(interface_id)
         if len(hl) >= 2:
             # cut the code
-            interface.set_attribute_values_by_id(interface_member, hl[1:])
+            hf_devices.set_attribute_values(device_id, 1, interface_id, interface_member, hl[1:])
         print(interface.get_attribute_by_id(interface_member))
   
 def handle_blind(device_id, message_type, interface_id, interface_member, data):
@@ -1600,8 +1686,8 @@ def snom_handle_x0100_state(device_id, unit_id, interface_id, cmd_id, hl):
     proximity = (hl[2] << 24) + (hl[3] << 16) + (hl[4] << 8) + hl[5]
 
     # store data in hf
+    hf_devices.set_attribute_values(device_id, unit_id, interface_id, 1, hl[2:])
     unit = hf_devices.get_device_by_id(device_id).get_unit_by_id(unit_id)
-    unit.get_interface_by_id(interface_id).set_attribute_values_by_id(1, hl[2:])
     print(unit.get_interface_by_id(interface_id).get_attribute_by_id(1))
 
     if snom_handle_window_open_close(device_id, proximity):
@@ -1681,7 +1767,7 @@ def snom_handle_server_attribute_reporting(device_id: int, unit_id: int , interf
                 #attribute_value = value
                 # finally set attribute values
                 data_slice = hl[hl_idx:hl_idx+length_value]
-                current_attribute.attribute_values = data_slice
+                hf_devices.set_attribute_values(device_id, unit, interface_id_t, attribute_id, data_slice)
                 log('received report attribute {} on Interface {}.'.format(current_attribute, interface.intrf_name))
 
                 hl_idx += length_value
@@ -1705,17 +1791,15 @@ def snom_handle_server_attribute_reporting(device_id: int, unit_id: int , interf
 
 def get_list_id_by_device_id(device_id: int) -> int:
     global devices_list
-    for idx, dev in enumerate(devices_list):
-        if dev.id == device_id:
-            return idx
-    return -1
+    return devices_list_index.position(devices_list, device_id)
 
 def snom_handle_fun_msg(client, msg):
-    device_id = int(msg.params["SRC_DEV_ID"])
-    unit_id = int(msg.params["SRC_UNIT_ID"])
-    interface_id = int(msg.params["INTRF_ID"])
-    interface_member = int(msg.params["INTRF_MEMBER"])
-    message_type = int(msg.params["MSGTYPE"])
+    device_id = msg.src_dev_id
+    unit_id = msg.src_unit_id
+    interface_id = msg.interface_id
+    interface_member = msg.interface_member
+    message_type = msg.msg_type
+    hl = list(msg.data)
     
     list_id = get_list_id_by_device_id(device_id)
     if list_id == -1:
@@ -1733,15 +1817,11 @@ def snom_handle_fun_msg(client, msg):
     log(f'MSGTYPE received={global_message_type(int(message_type))}:{message_type}')
     if message_type == 8:
         # answer to set attribute
-        datastr=msg.params["DATA"]
-        hl = [int(x, 16) for x in datastr.split(' ')]
         print(f'Response to Set Attribute: {global_response_code(hl[0])}')
         log("data raw {}".format(hl))
         #return   
     if message_type == 5:
         # answer to get attribute
-        datastr=msg.params["DATA"]
-        hl = [int(x, 16) for x in datastr.split(' ')]
         if hl[0] == 0x03:
             log("get attr not supported".format(hl))    
         log("data raw {}".format(hl))
@@ -1752,11 +1832,6 @@ def snom_handle_fun_msg(client, msg):
         if message_type == 1 and interface_id == 0x6:
             # Attribute Reporting unit
             log("Device {}: Attribute Reporting".format(device_id))
-            try:
-                datastr=msg.params["DATA"]
-                hl = [int(x, 16) for x in datastr.split(' ')]
-            except:
-                hl=[]
             log("Attribute data {}".format(hl))
             snom_handle_server_attribute_reporting(device_id, unit_id, interface_id, interface_member, hl)
 
@@ -1778,14 +1853,10 @@ def snom_handle_fun_msg(client, msg):
 
     if unit_id != 0:
         log("Device {}: message from unit {}".format(device_id, unit_id))
-        if int(msg.params["DATALEN"]) > 0:
-            log(f'data raw #{int(msg.params["DATALEN"])}, {msg.params["DATA"]}')
-            datastr=msg.params["DATA"]
-            hl = [int(x, 16) for x in datastr.split(' ')]
+        if hl:
+            log(f'data raw #{len(hl)}, {msg.params["DATA"]}')
         else:
             log(f'no data received')
-            datastr=''
-            hl = []
 
         if len(hl) == 0:
             profile = devices_list[list_id].units[unit_id].type
@@ -1795,11 +1866,6 @@ def snom_handle_fun_msg(client, msg):
             log('we got as message from unit={},profile={} without payload'.format(unit_id, hex(profile)))
         # incoming message from device!     
         if message_type == 1: # server command
-            try:
-                datastr=msg.params["DATA"]
-                hl = [int(x, 16) for x in datastr.split(' ')]
-            except:
-                hl=[]
             snom_handle_server_cmds(device_id, unit_id, interface_id, interface_member, hl)
 
         if message_type == 5:
@@ -1810,7 +1876,7 @@ def snom_handle_fun_msg(client, msg):
             interface = dev.get_unit_by_id(unit_id).get_interface_by_id(interface_id)
             if len(hl) >= 2:
                 # cut the code
-                interface.set_attribute_values_by_id(interface_member, hl[1:])
+                hf_devices.set_attribute_values(device_id, unit_id, interface_id, interface_member, hl[1:])
             print(interface.get_attribute_by_id(interface_member))
     
    
@@ -1968,6 +2034,11 @@ hf_interfaces.create_known_interfaces()
 global hf_devices
 hf_devices = HFDevices()
 
+# values of reports and responses, reads within the TTL are answered without asking the device
+global attribute_cache
+attribute_cache = AttributeCache()
+hf_devices.add_listener(attribute_cache.attribute_updated, changes_only=False)
+
 # MQTT MQTT MQTT
 from snom_sss_mqtt_hassio import snomSSSMqttHasssioClient
 mqttc = snomSSSMqttHasssioClient()
@@ -1998,7 +2069,7 @@ def my_callback(inp):
 
 import time
 
-def main_interactive():
+def main_interactive(store_path=DEVICE_STORE_PATH):
     history = InMemoryHistory()
 
     # Make the list of commands for the completer
@@ -2009,7 +2080,7 @@ def main_interactive():
     # get a global list of the currently available devices..
     # remember to update frequently on register dereg etc....
     print("Gather current device information")
-    list_devices(client_handle, '')
+    start_devices(client_handle, store_path)
 
     CMD_LINE = False 
     if CMD_LINE:
@@ -2058,9 +2129,9 @@ client_handle.start()
 log("HAN client started")
 
 
-def main_bottle():
+def main_bottle(store_path=DEVICE_STORE_PATH):
     print("Gather current device information")
-    list_devices(client_handle, '')
+    start_devices(client_handle, store_path)
     device_info()
 
     while True:
@@ -1,16 +1,144 @@
 import json
 import time
 import logging
+import threading
+import collections
 import schedule
 
 from mqtt.snomM900MqttClient import snomM900MqttClient as hassiomqtt
 
+
+class CoalescingPublisher(object):
+    """Publish MQTT messages from a worker thread, the last payload per topic wins.
+
+    put() never blocks: the message is queued and the worker publishes everything queued
+    after waiting window seconds, so a burst of updates for one topic is sent once.
+    At most max_topics topics are queued, the oldest one is dropped when a new topic
+    does not fit. Payloads which are not strings are encoded to JSON by the worker.
+    publish() may return an object with rc (paho MQTTMessageInfo), rc != 0 counts as failed.
+    Messages put with coalesce=False (e.g. command acks) are all sent, in order.
+    """
+    def __init__(self, publish, window=0.1, max_topics=1024):
+        self._publish = publish
+        self.window = window
+        self.max_topics = max_topics
+        # topic (or (topic, seq) if not coalesced) -> (topic, payload, on_published), in order of first update
+        self._pending = collections.OrderedDict()
+        self._seq = 0
+        self._busy = False
+        self._run = True
+        self._cond = threading.Condition()
+
+        self.published = 0
+        self.coalesced = 0
+        self.dropped = 0
+        self.failed = 0
+
+        self._worker = threading.Thread(target=self._work, name='mqtt-publisher')
+        self._worker.daemon = True
+        self._worker.start()
+
+    def put(self, topic, payload, on_published=None, coalesce=True):
+        """Queue payload for topic, on_published(topic, payload) is called by the worker
+        after it has been published."""
+        with self._cond:
+            key = topic
+            if not coalesce:
+                self._seq += 1
+                key = (topic, self._seq)
+            if key in self._pending:
+                self.coalesced += 1
+            elif len(self._pending) >= self.max_topics:
+                self._pending.popitem(last=False)
+                self.dropped += 1
+            self._pending[key] = (topic, payload, on_published)
+            self._cond.notify_all()
+
+    def flush(self, timeout=None):
+        """Wait until all queued messages are published, False on timeout."""
+        with self._cond:
+            return self._cond.wait_for(lambda: not self._pending and not self._busy, timeout)
+
+    def stop(self):
+        self.flush(timeout=2 * self.window + 1)
+        with self._cond:
+            self._run = False
+            self._cond.notify_all()
+
+    def _work(self):
+        while True:
+            with self._cond:
+                self._cond.wait_for(lambda: self._pending or not self._run)
+                if not self._run:
+                    return
+                self._busy = True
+            # collect further updates of the same topics
+            time.sleep(self.window)
+            with self._cond:
+                batch = list(self._pending.values())
+                self._pending.clear()
+            for topic, payload, on_published in batch:
+                self._send(topic, payload, on_published)
+            with self._cond:
+                self._busy = False
+                self._cond.notify_all()
+
+    def _send(self, topic, payload, on_published):
+        # one failed message must not drop the rest of the batch
+        try:
+            data = payload if isinstance(payload, str) else json.dumps(payload)
+            result = self._publish(topic, data)
+            if getattr(result, 'rc', 0) != 0:
+                logging.warning('mqtt publish to %s failed: rc=%s', topic, result.rc)
+                self.failed += 1
+                return
+            self.published += 1
+            if on_published:
+                on_published(topic, payload)
+        except Exception:
+            logging.exception('mqtt publish to %s failed', topic)
+            self.failed += 1
+
+
 class snomSSSMqttHasssioClient(hassiomqtt):
-    def __init__(self, enable=True):
+    def __init__(self, enable=True, window=0.1):
         hassiomqtt.__init__(self)
 
         self.enable = enable
-       
+        # state and config messages are sent by the publisher thread, never from the caller
+        self.publisher = CoalescingPublisher(lambda topic, payload: hassiomqtt.publish(self, topic, payload),
+                                             window=window)
+        # config topic -> payload last sent, unchanged configs are not sent again
+        self._config_cache = {}
+        self._config_lock = threading.Lock()
+        # topics subscribed on every connect, e.g. the command topics
+        self.subscriptions = []
+
+    def on_connect(self, mqttc, obj, flags, rc):
+        hassiomqtt.on_connect(self, mqttc, obj, flags, rc)
+        for topic in self.subscriptions:
+            self.subscribe(topic)
+        # the broker may have lost the configs, send them again on the next update
+        with self._config_lock:
+            self._config_cache.clear()
+
+    def publish_state(self, topic, payload):
+        self.publisher.put(topic, payload)
+
+    def publish_ack(self, topic, payload):
+        # every ack is sent, a later ack to the same topic does not replace it
+        self.publisher.put(topic, payload, coalesce=False)
+
+    def publish_config(self, topic, payload):
+        with self._config_lock:
+            if self._config_cache.get(topic) == payload:
+                return
+        # cached once it has been sent, a failed config is sent again on the next update
+        self.publisher.put(topic, payload, self._config_published)
+
+    def _config_published(self, topic, payload):
+        with self._config_lock:
+            self._config_cache[topic] = payload
 
     def publish_SSS_motion_detector_config_ha_disabled(self, ipui, device_id, toggle):
         if self.enable:
@@ -38,8 +166,8 @@ class snomSSSMqttHasssioClient(hassiomqtt):
                         "model": "SnomSSS",
                         "manufacturer": "Snom Technology GmbH"}
             }
-            # encode object to JSON
-            self.publish("%s" % device_topic, json.dumps(payload))
+            # queued, encoded to JSON by the publisher
+            self.publish_config(device_topic, payload)
 
 
     def publish_SSS_light_bulp_config_ha(self, ipui, device_id):
@@ -73,8 +201,8 @@ class snomSSSMqttHasssioClient(hassiomqtt):
                 #"value_template": "{{ value_json.data }}",
             }
             
-            # encode object to JSON
-            self.publish("%s" % device_topic, json.dumps(payload))
+            # queued, encoded to JSON by the publisher
+            self.publish_config(device_topic, payload)
 
 
     def publish_SSS_light_bulp_state_ha(self, ipui, device_id, h, s, v):
@@ -97,8 +225,8 @@ class snomSSSMqttHasssioClient(hassiomqtt):
                         "transition": 2,
                         }
             device_topic = "homeassistant/%s/%s/%s/state" % (component, node_id, object_id)
-            # encode object to JSON
-            self.publish("%s" % device_topic, json.dumps(payload))
+            # queued, encoded to JSON by the publisher
+            self.publish_state(device_topic, payload)
 
 
     def publish_SSS_light_bulp_set_ha(self, ipui, device_id, h, s, v):
@@ -121,8 +249,8 @@ class snomSSSMqttHasssioClient(hassiomqtt):
                         "transition": 2,
                         }
             device_topic = "homeassistant/%s/%s/%s/state" % (component, node_id, object_id)
-            # encode object to JSON
-            self.publish("%s" % device_topic, json.dumps(payload))
+            # queued, encoded to JSON by the publisher
+            self.publish_state(device_topic, payload)
 
 
     def publish_SSS_simple_power_meter_config_ha(self, ipui, device_id, energy):
@@ -155,8 +283,8 @@ class snomSSSMqttHasssioClient(hassiomqtt):
                 "payload_not_available": "offline",
             }
             
-            # encode object to JSON
-            self.publish("%s" % device_topic, json.dumps(payload))
+            # queued, encoded to JSON by the publisher
+            self.publish_config(device_topic, payload)
 
 
     def publish_SSS_simple_power_meter_state_ha(self, ipui, device_id, energy, energy_lreset, time_lreset,
@@ -184,8 +312,8 @@ class snomSSSMqttHasssioClient(hassiomqtt):
                          "report_interval": report_interval,
                       }
             device_topic = "homeassistant/%s/%s/%s/state" % (component, node_id, object_id)
-            # encode object to JSON
-            self.publish("%s" % device_topic, json.dumps(payload))
+            # queued, encoded to JSON by the publisher
+            self.publish_state(device_topic, payload)
 
 
     def publish_SSS_motion_detector_config_ha(self, ipui, device_id, toggle):
@@ -214,8 +342,8 @@ class snomSSSMqttHasssioClient(hassiomqtt):
                 "device_class": "%s" % device_class,
                 "state_topic": "homeassistant/%s/%s/%s/state" % (component, node_id, object_id),
             }
-            # encode object to JSON
-            self.publish("%s" % device_topic, json.dumps(payload))
+            # queued, encoded to JSON by the publisher
+            self.publish_config(device_topic, payload)
 
 
     def publish_SSS_motion_detector_state_ha_disabled(self, ipui, device_id, proximity):
@@ -231,8 +359,8 @@ class snomSSSMqttHasssioClient(hassiomqtt):
                                  }
                         }
             device_topic = "homeassistant/%s/%s/%s/state" % (component, node_id, object_id)
-            # encode object to JSON
-            self.publish("%s" % device_topic, json.dumps(payload))
+            # queued, encoded to JSON by the publisher
+            self.publish_state(device_topic, payload)
 
     def publish_SSS_motion_detector_state_ha(self, ipui, device_id, prox_msg):
         if self.enable:
@@ -244,8 +372,8 @@ class snomSSSMqttHasssioClient(hassiomqtt):
             # send payload to existing device
             payload = prox_msg
             device_topic = "homeassistant/%s/%s/%s/state" % (component, node_id, object_id)
-            # encode object to JSON
-            self.publish("%s" % device_topic, payload)
+            # queued, sent as is by the publisher
+            self.publish_state(device_topic, payload)
 
     
     def send_sensor_data(self, ipui, device_id, proximity):
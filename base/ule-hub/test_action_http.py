@@ -0,0 +1,94 @@
+# SPDX-License-Identifier: MIT
+import threading
+import unittest
+import requests
+import action_http
+from action_http import PooledHTTPClient, RetryBudget
+
+
+class Response(object):
+    def __init__(self, status_code):
+        self.status_code = status_code
+
+
+class MaxRetryError(Exception):
+    """urllib3's wrapper of a failed connect."""
+    reason = 'connection refused'
+
+
+class FakeSession(object):
+    """Answers with the given status codes in turn, None fails to connect, 'reset' and
+    'timeout' fail after the request was sent."""
+
+    def __init__(self, answers, delay=None):
+        self.answers = list(answers)
+        self.delay = delay
+        self.urls = []
+        self.lock = threading.Lock()
+
+    def get(self, url, timeout=None):
+        if self.delay:
+            self.delay.wait(5)
+        with self.lock:
+            self.urls.append(url)
+            answer = self.answers.pop(0) if self.answers else 200
+        if answer is None:
+            raise requests.exceptions.ConnectionError(MaxRetryError())
+        if answer == 'reset':
+            raise requests.exceptions.ConnectionError('Connection aborted.')
+        if answer == 'timeout':
+            raise requests.exceptions.ReadTimeout(url)
+        return Response(answer)
+
+    def close(self):
+        pass
+
+
+class PooledHTTPClientTest(unittest.TestCase):
+
+    def setUp(self):
+        action_http.RETRY_BACKOFF = 0
+        self.client = PooledHTTPClient(workers=4)
+
+    def tearDown(self):
+        self.client.close()
+
+    def test_retry(self):
+        self.client._session = FakeSession([None, None, 200])
+        self.assertEqual(self.client.get('http://relay/on').status_code, 200)
+        self.assertEqual(self.client.stats()['retries'], 2)
+
+        # the relay may have switched already
+        for answer in (503, 'reset', 'timeout'):
+            self.client._session = FakeSession([answer])
+            self.assertIsNone(self.client.get('http://relay/on'))
+            self.assertEqual(len(self.client._session.urls), 1)
+
+        # reads can be sent again
+        self.client._session = FakeSession(['timeout', 503, 200])
+        self.assertEqual(self.client.get('http://sensor/state', retry_reads=True).status_code, 200)
+        self.assertEqual(self.client.stats()['retries'], 4)
+
+        # client errors are not retried
+        self.client._session = FakeSession([404])
+        self.assertEqual(self.client.get('http://relay/on').status_code, 404)
+        self.assertEqual(len(self.client._session.urls), 1)
+
+    def test_retry_budget(self):
+        self.client.budget = RetryBudget(ratio=0.5, maximum=1)
+        self.client._session = FakeSession([None] * 100)
+        self.assertIsNone(self.client.get('http://down/1'))
+        # the first request used the token, the next ones earn half a retry each
+        self.assertIsNone(self.client.get('http://down/2'))
+        self.assertIsNone(self.client.get('http://down/3'))
+        self.assertEqual(len(self.client._session.urls), 5)
+        self.assertEqual(self.client.stats()['failed'], 3)
+
+    def test_fan_out(self):
+        # all requests are in flight at the same time
+        release = threading.Event()
+        self.client._session = FakeSession([], delay=release)
+        futures = self.client.fan_out(['http://a/1', 'http://b/1', 'http://c/1'])
+        self.assertFalse(any(future.done() for future in futures))
+        release.set()
+        self.assertEqual([future.result(5).status_code for future in futures], [200] * 3)
@@ -0,0 +1,58 @@
+# SPDX-License-Identifier: MIT
+import unittest
+import attribute_cache
+from attribute_cache import AttributeCache
+from test_device_events import TEMPERATURE, make_devices
+
+KEY = (1, 1, TEMPERATURE, 1)
+
+
+class AttributeCacheTest(unittest.TestCase):
+
+    def setUp(self):
+        self.devices = make_devices(1)
+        self.cache = AttributeCache(default_ttl=60, request_timeout=5)
+        self.devices.add_listener(self.cache.attribute_updated, changes_only=False)
+        self.sent = []
+
+    def test_read_through(self):
+        self.assertIsNone(self.cache.read(KEY, self.sent.append))
+        # outstanding, not sent again
+        self.assertIsNone(self.cache.read(KEY, self.sent.append))
+        self.assertEqual(self.sent, [KEY])
+
+        # response, same value as before still counts as received
+        self.devices.set_attribute_values(*KEY, self.devices.get_device_by_id(1).get_unit_by_id(1)
+                                          .get_interface_by_id(TEMPERATURE).get_attribute_by_id(1).attribute_values)
+        self.assertIsNotNone(self.cache.read(KEY, self.sent.append))
+        self.devices.set_attribute_values(*KEY, [8, 52])
+        self.assertEqual(self.cache.read(KEY, self.sent.append), [8, 52])
+        self.assertEqual(self.sent, [KEY])
+        self.assertEqual((self.cache.hits, self.cache.misses, self.cache.requests), (2, 2, 1))
+
+        self.assertIsNone(self.cache.read(KEY, self.sent.append, bypass=True))
+        self.assertEqual(self.sent, [KEY, KEY])
+
+    def test_lookup(self):
+        self.assertEqual(self.cache.lookup(KEY, self.sent.append), (attribute_cache.REQUESTED, None))
+        self.assertEqual(self.cache.lookup(KEY, self.sent.append), (attribute_cache.PENDING, None))
+        self.devices.set_attribute_values(*KEY, [8, 52])
+        self.assertEqual(self.cache.lookup(KEY, self.sent.append), (attribute_cache.CACHED, [8, 52]))
+        self.assertEqual(self.sent, [KEY])
+
+    def test_ttl(self):
+        self.cache.put(KEY, [8, 52], now=100)
+        self.assertEqual(self.cache.get(KEY, now=160), [8, 52])
+        self.assertIsNone(self.cache.get(KEY, now=161))
+
+        self.cache.set_ttl(TEMPERATURE, None, 300)
+        self.assertEqual(self.cache.get(KEY, now=400), [8, 52])
+        self.cache.set_ttl(TEMPERATURE, 1, 10)
+        self.assertIsNone(self.cache.get(KEY, now=111))
+
+    def test_invalidate(self):
+        self.cache.put(KEY, [8, 52])
+        self.cache.put((2, 1, TEMPERATURE, 1), [8, 52])
+        self.cache.invalidate(1)
+        self.assertIsNone(self.cache.get(KEY))
+        self.assertIsNotNone(self.cache.get((2, 1, TEMPERATURE, 1)))
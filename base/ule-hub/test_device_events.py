@@ -0,0 +1,92 @@
+# SPDX-License-Identifier: MIT
+import threading
+import time
+import unittest
+from device_events import DeviceEvents
+from profile_hanfun import HFDevice, HFDevices, HFInterfaces, HFProfile, HFUnit
+
+TEMPERATURE = 0x0301
+
+
+def make_devices(*device_ids):
+    interfaces = HFInterfaces()
+    interfaces.create_known_interfaces()
+    devices = HFDevices()
+    for device_id in device_ids:
+        unit = HFUnit(unit_id=1, unit_name='1', profile=HFProfile(profile_id=0x0100),
+                      interfaces=[interfaces.get_interface_by_id(TEMPERATURE)])
+        devices.add_device(HFDevice(device_id=device_id, device_ipui='', device_name=str(device_id), units=[unit]))
+    return devices
+
+
+class DeviceEventsTest(unittest.TestCase):
+
+    def setUp(self):
+        self.devices = make_devices(1, 2)
+        self.events = DeviceEvents(history=4)
+        self.devices.add_listener(self.events.attribute_changed)
+
+    def report(self, device_id, value):
+        self.devices.set_attribute_values(device_id, 1, TEMPERATURE, 1, list(value.to_bytes(2, 'big', signed=True)))
+
+    def test_events(self):
+        self.report(1, 2100)
+        # unchanged value, no event
+        self.report(1, 2100)
+        self.report(2, 1900)
+        last_id, events = self.events.wait(None, timeout=0)
+        self.assertEqual(last_id, self.events.epoch + '-2')
+        self.assertEqual([(e['device_id'], e['decoded']['Measured Temperature 1/100 of C']) for e in events],
+                         [(1, 2100), (2, 1900)])
+
+        self.report(1, -50)
+        last_id, events = self.events.wait(last_id, device_id=1, timeout=0)
+        self.assertEqual((last_id, len(events)), (self.events.epoch + '-3', 1))
+        self.assertEqual(events[0]['id'], last_id)
+        self.assertEqual(events[0]['values'], [0xff, 0xce])
+        self.assertEqual(events[0]['decoded']['Measured Temperature 1/100 of C'], -50)
+
+    def test_missed_events(self):
+        self.report(2, 1000)
+        last_id, _ = self.events.wait(None, timeout=0)
+        for value in range(10):
+            self.report(1, value)
+        # history overflowed, the current state of both devices is returned
+        _, events = self.events.wait(last_id, timeout=0)
+        self.assertEqual([(e['device_id'], e['values']) for e in events], [(2, [3, 232]), (1, [0, 9])])
+
+    def test_other_epoch(self):
+        self.report(1, 2100)
+        self.report(2, 1900)
+        state = [(1, [8, 52]), (2, [7, 108])]
+        # ids of an earlier gateway process, ahead of this one or not, and ids not understood
+        for since in ('0badcafe-1', '0badcafe-100', self.events.epoch + '-100', '1', 'x', ''):
+            _, events = self.events.wait(since, timeout=0)
+            self.assertEqual([(e['device_id'], e['values']) for e in events], state, msg=since)
+        _, events = self.events.wait(self.events.epoch + '-1', timeout=0)
+        self.assertEqual([e['device_id'] for e in events], [2])
+
+    def test_long_poll(self):
+        last_id, _ = self.events.wait(None, timeout=0)
+        threading.Timer(0.05, self.report, (2, 1800)).start()
+        threading.Timer(0.1, self.report, (1, 1700)).start()
+        start = time.monotonic()
+        last_id, events = self.events.wait(last_id, device_id=1, timeout=5)
+        self.assertLess(time.monotonic() - start, 1)
+        self.assertEqual([e['device_id'] for e in events], [1])
+
+        last_id, events = self.events.wait(last_id, timeout=0.05)
+        self.assertEqual(events, [])
+
+    def test_stream(self):
+        self.report(1, 2100)
+        self.assertTrue(self.events.open_stream())
+        stream = self.events.stream(None, keepalive=0.01)
+        self.assertEqual(next(stream), 'retry: 3000\n\n')
+        self.assertTrue(next(stream).startswith('id: ' + self.events.epoch + '-1\nevent: attribute\ndata: {'))
+        self.assertEqual(next(stream), ': keepalive\n\n')
+        stream.close()
+
+        self.events.max_streams = 1
+        self.assertTrue(self.events.open_stream())
+        self.assertFalse(self.events.open_stream())
@@ -0,0 +1,59 @@
+# SPDX-License-Identifier: MIT
+import os
+import tempfile
+import unittest
+import han_client
+from device_store import DeviceStore
+from test_han_client import DEV_INFO_PHASE_2_RESPONSE
+
+
+def parse_device(device_id):
+    msg = han_client.Message(DEV_INFO_PHASE_2_RESPONSE.replace(" DEV_ID:  7", " DEV_ID:  {}".format(device_id)))
+    return msg.device
+
+
+class DeviceStoreTest(unittest.TestCase):
+
+    def setUp(self):
+        self.tmpdir = tempfile.TemporaryDirectory()
+        self.path = os.path.join(self.tmpdir.name, "devices.db")
+        self.store = DeviceStore(self.path)
+
+    def tearDown(self):
+        self.store.close()
+        self.tmpdir.cleanup()
+
+    def test_roundtrip(self):
+        self.store.put(parse_device(7))
+        self.store.close()
+
+        self.store = DeviceStore(self.path)
+        devices = self.store.load()
+        self.assertEqual(len(devices), 1)
+        dev = devices[0]
+        self.assertIsInstance(dev, han_client.DevTableParser.Device)
+        self.assertEqual(dev.id, 7)
+        self.assertEqual(dev.ipui, "02c3c0507e")
+        self.assertEqual([u.type for u in dev.units], [0, 515, 65281])
+        self.assertEqual([i.id for i in dev.units[0].interfaces], [257, 272, 1024, 277])
+
+    def test_delete(self):
+        self.store.put(parse_device(7))
+        self.store.put(parse_device(8))
+        self.store.delete(7)
+        self.assertEqual([d.id for d in self.store.load()], [8])
+
+    def test_replace_all_reports_changes_only(self):
+        self.assertTrue(self.store.replace_all([parse_device(7), parse_device(8)]))
+        self.assertFalse(self.store.replace_all([parse_device(8), parse_device(7)]))
+
+        dev = parse_device(8)
+        dev.units = dev.units[:1]
+        self.assertTrue(self.store.replace_all([dev]))
+        devices = self.store.load()
+        self.assertEqual([d.id for d in devices], [8])
+        self.assertEqual(len(devices[0].units), 1)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -1,6 +1,11 @@
 # SPDX-License-Identifier: MIT
+import asyncio
+import threading
+import time
 import unittest
 import han_client
+import han_server_sim
+from han_server_sim import HANServerSim
 
 INIT_RESPONSE = """
 INIT_RES
@@ -229,6 +234,21 @@ class MessageTest(unittest.TestCase):
         self.assertEqual(msg.index, 0)
         self.assertEqual(len(msg.devices), 1)
 
+    def test_split_data(self):
+        service, name, params = han_client.Message._split_data(
+            "[SRV]" + han_client.EOL + "SET_EEPROM_PARAM_RES" + han_client.EOL +
+            " NAME:  RXTUN" + han_client.EOL + " FAIL" + han_client.EOL + han_client.EOL)
+        self.assertEqual(service, "[SRV]")
+        self.assertEqual(name, "SET_EEPROM_PARAM_RES")
+        self.assertEqual(params, [("NAME", "RXTUN"), ("FAIL", True)])
+
+        self.assertEqual(han_client.Message._split_data("KEEP_ALIVE" + han_client.EOL), (None, "KEEP_ALIVE", []))
+
+    def test_factory(self):
+        self.assertTrue(isinstance(han_client.Message(FUN_MSG_MESSAGE), han_client.FunMsgMessage))
+        self.assertTrue(isinstance(han_client.Message(DEV_INFO_PHASE_2_RESPONSE), han_client.DevInfoPhase2Message))
+        self.assertEqual(type(han_client.Message(INIT_RESPONSE)), han_client.Message)
+
     def test_get_target_hw_version_response(self):
         msg = han_client.Message(GET_TARGET_HW_VERSION_RESPONSE)
         self.assertTrue(isinstance(msg, han_client.Message))
@@ -324,6 +344,240 @@ class FunMsgMessageTest(unittest.TestCase):
         for i, x in enumerate(msg.data):
             self.assertEqual(x, FUN_MSG_DATA[i])
 
+    def test_fields(self):
+        msg = han_client.Message(FUN_MSG_MESSAGE)
+        self.assertEqual(msg.src_dev_id, 1)
+        self.assertEqual(msg.src_unit_id, 3)
+        self.assertEqual(msg.msg_type, 1)
+        self.assertEqual(msg.interface_id, 32534)
+        self.assertEqual(msg.interface_member, 1)
+        self.assertEqual(msg.data, bytes(FUN_MSG_DATA))
+
+    def test_decode_data(self):
+        self.assertEqual(han_client.FunMsgMessage.decode_data("1 F 13 AB"), b"\x01\x0f\x13\xab")
+        self.assertEqual(han_client.FunMsgMessage.decode_data(" 01 0f "), b"\x01\x0f")
+
+
+DEV_INFO_PHASE_2_RESPONSE_DEV_3 = DEV_INFO_PHASE_2_RESPONSE.replace("DEV_ID:  7", "DEV_ID:  3")
+
+
+class HANClientWaiterTest(unittest.TestCase):
+
+    def setUp(self):
+        self.client = han_client.HANClient()
+
+    def tearDown(self):
+        self.client._sock.close()
+
+    def test_concurrent_waiters(self):
+        open_waiter = self.client.waiter("OPEN_RES")
+        dev7 = self.client.waiter("DEV_INFO_PHASE_2", key=7)
+        dev3 = self.client.waiter("DEV_INFO_PHASE_2", key=3)
+
+        self.client._dispatch(DEV_INFO_PHASE_2_RESPONSE_DEV_3)
+        self.assertTrue(dev3.is_set())
+        self.assertFalse(dev7.is_set())
+        self.assertEqual(dev3.message.device.id, 3)
+
+        self.client._dispatch(OPEN_REG_RESPONSE)
+        self.assertTrue(open_waiter.is_set())
+        self.assertFalse(dev7.is_set())
+
+        self.client._dispatch(DEV_INFO_PHASE_2_RESPONSE)
+        self.assertTrue(dev7.is_set())
+        self.assertEqual(self.client._waiters, {})
+
+    def test_key_param_per_response(self):
+        # page 1 is requested, a late page 0 carries DEV_ID 1 but DEV_INDEX 0
+        page1 = self.client.waiter("DEV_TABLE_PHASE_2", key=1)
+        self.client._dispatch(DEV_TABLE_PHASE_2_RESPONSE)
+        self.assertFalse(page1.is_set())
+
+        self.client._dispatch(DEV_TABLE_PHASE_2_RESPONSE.replace("DEV_INDEX: 0", "DEV_INDEX: 1"))
+        self.assertTrue(page1.is_set())
+
+    def test_error_response_without_key(self):
+        dev7 = self.client.waiter("DEV_INFO_PHASE_2", key=7)
+        dev3 = self.client.waiter("DEV_INFO_PHASE_2", key=3)
+
+        self.client._dispatch("DEV_INFO_PHASE_2" + han_client.EOL + " STATUS: FAIL" + han_client.EOL * 2)
+        # either request may have failed, both see the error
+        self.assertTrue(dev7.is_set() and dev3.is_set())
+        self.assertIsNone(dev7.message.device)
+        self.assertIsNone(dev3.message.device)
+        self.assertEqual(self.client._waiters, {})
+
+    def test_cookie(self):
+        cookies = set()
+        threads = [threading.Thread(target=lambda: [cookies.add(self.client.cookie) for _ in range(64)])
+                   for _ in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(cookies, set(range(han_client.MSG_SEQ_MODULO)))
+        self.assertEqual(self.client.cookie, 0)
+
+    def test_waiters_without_key_in_order(self):
+        first = self.client.waiter("OPEN_RES")
+        second = self.client.waiter("OPEN_RES")
+
+        self.client._dispatch(OPEN_REG_RESPONSE)
+        self.assertTrue(first.is_set())
+        self.assertFalse(second.is_set())
+
+    def test_cancel_waiter(self):
+        waiter = self.client.waiter("OPEN_RES")
+        self.client.cancel_waiter(waiter)
+
+        self.client._dispatch(OPEN_REG_RESPONSE)
+        self.assertFalse(waiter.is_set())
+
+
+class HANClientDevTableTest(unittest.TestCase):
+
+    def setUp(self):
+        self.sim = HANServerSim(devices=23, max_page=4).start()
+        self.client = han_client.HANClient(port=self.sim.port)
+        self.client.start()
+
+    def tearDown(self):
+        self.client.destroy()
+        self.client._sock.close()
+        self.sim.stop()
+
+    def test_full_dev_table(self):
+        devices = self.client.get_full_dev_table()
+        self.assertEqual([dev.id for dev in devices], list(range(1, 24)))
+        # first page cut to 4, one page to confirm, then requests ahead until a page is not full
+        self.assertLessEqual(self.sim.requests["GET_DEV_TABLE_PHASE_2"], 6 + han_client.PIPELINE_WINDOW)
+        self.assertEqual(self.client._waiters, {})
+
+    def test_rejected_pages(self):
+        # the server rejects the large first page: fall back to pages of 5
+        self.sim.reject_large_pages = True
+        self.sim.max_page = han_client.DEV_TABLE_COUNT
+        devices = self.client.get_full_dev_table()
+        self.assertEqual([dev.id for dev in devices], list(range(1, 24)))
+        self.assertEqual(self.client._waiters, {})
+
+        # a rejected later page fails the table instead of cutting it short
+        self.sim.reject_large_pages = False
+        self.sim.max_page = 4
+        self.sim.fail_pages = {4}
+        with self.assertRaises(han_client.ResponseException):
+            self.client.get_full_dev_table()
+        self.sim.reject_large_pages = True
+        self.sim.max_page = han_client.DEV_TABLE_COUNT
+        self.sim.fail_pages = {10}
+        with self.assertRaises(han_client.ResponseException):
+            self.client.get_full_dev_table()
+        self.sim.fail_pages = {5}
+        with self.assertRaises(han_client.ResponseException):
+            self.client.get_full_dev_table()
+        with self.assertRaises(han_client.ResponseException):
+            self.client.get_dev_snapshot()
+        self.assertEqual(self.client._waiters, {})
+
+    def test_dev_snapshot(self):
+        snapshot = self.client.get_dev_snapshot()
+        self.assertEqual([dev.id for dev in snapshot], list(range(1, 24)))
+        self.assertEqual(self.sim.requests["GET_DEV_INFO_PHASE_2"], 23)
+        self.assertEqual(snapshot[0].ule_capabilities, 5)
+
+        known = {dev.id: dev for dev in snapshot}
+        del known[5]
+        self.sim.devices[7].units[1] = (1, 0x0101, [0x0200, 0x0300])
+        snapshot = self.client.get_dev_snapshot(known)
+        self.assertEqual(self.sim.requests["GET_DEV_INFO_PHASE_2"], 25)
+        self.assertIs(snapshot[0], known[1])
+        self.assertEqual(snapshot[6].units[1].type, 0x0101)
+
+    def test_reports(self):
+        received = []
+        done = threading.Event()
+
+        def handle_fun_msg(client, msg):
+            received.append(msg)
+            done.set()
+
+        self.client.subscribe("FUN_MSG", handle_fun_msg)
+        self.sim.report(3, -250)
+        self.assertTrue(done.wait(1))
+
+        msg = received[0]
+        self.assertEqual((msg.src_dev_id, msg.src_unit_id, msg.msg_seq), (3, 1, 0))
+        self.assertEqual(msg.interface_id, han_server_sim.REPORT_INTERFACE)
+        self.assertEqual(int.from_bytes(msg.data[1:], "big", signed=True), -250)
+        self.assertIn((3, 0), self.sim.sent_reports)
+
+
+class FakeHANServer(asyncio.DatagramProtocol):
+    """Answer requests by name, responses are sent in reverse order of requests."""
+
+    RESPONSES = {
+        "INIT": [INIT_RESPONSE],
+        "GET_DEV_INFO_PHASE_2": [DEV_INFO_PHASE_2_RESPONSE, DEV_INFO_PHASE_2_RESPONSE_DEV_3],
+    }
+
+    def __init__(self):
+        self.requests = []
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def datagram_received(self, data, addr):
+        name = data.decode("utf-8").split(han_client.EOL)[1]
+        self.requests.append(name)
+        responses = self.RESPONSES.get(name, [])
+        if name == "GET_DEV_INFO_PHASE_2":
+            if self.requests.count(name) < 2:
+                return
+            responses = reversed(responses)
+        for response in responses:
+            self.transport.sendto(response.encode("utf-8"), addr)
+
+
+class AsyncHANClientTest(unittest.TestCase):
+
+    async def _run(self):
+        loop = asyncio.get_running_loop()
+        transport, server = await loop.create_datagram_endpoint(
+            FakeHANServer, local_addr=("127.0.0.1", 0))
+        port = transport.get_extra_info("sockname")[1]
+
+        client = han_client.AsyncHANClient(port=port, timeout=1)
+        try:
+            init = await client.start()
+            self.assertEqual(init.name, "INIT_RES")
+
+            dev7, dev3 = await asyncio.gather(client.get_dev_info(7), client.get_dev_info(3))
+            self.assertEqual(dev7.device.id, 7)
+            self.assertEqual(dev3.device.id, 3)
+
+            with self.assertRaises(han_client.TimeoutException):
+                await client.request(han_client.Message(name="CLOSE_REG"), "CLOSE_RES", timeout=0.1)
+            self.assertEqual(client._waiters, {})
+
+            # 0 does not wait, it is not the default of 1 second
+            start = time.monotonic()
+            with self.assertRaises(han_client.TimeoutException):
+                await client.wait_for("CLOSE_RES", timeout=0)
+            self.assertLess(time.monotonic() - start, 0.5)
+
+            task = asyncio.ensure_future(client.request(han_client.Message(name="CLOSE_REG"), "CLOSE_RES"))
+            await asyncio.sleep(0)
+            task.cancel()
+            with self.assertRaises(asyncio.CancelledError):
+                await task
+            self.assertEqual(client._waiters, {})
+        finally:
+            client.close()
+            transport.close()
+
+    def test_requests(self):
+        asyncio.run(self._run())
+
 
 if __name__ == "__main__":
     unittest.main()
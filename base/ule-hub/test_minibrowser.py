@@ -0,0 +1,54 @@
+# SPDX-License-Identifier: MIT
+import unittest
+from DECTULEMiniBrowser import RenderCache, return_minibrowser_device
+from profile_hanfun import HFDevice, HFDevices, HFInterfaces, HFProfiles, HFUnit
+
+
+def make_devices():
+    interfaces = HFInterfaces()
+    interfaces.create_known_interfaces()
+    unit = HFUnit(unit_id=1, unit_name='Power Plug', profile=HFProfiles().get_profile_by_id(0x0107),
+                  interfaces=[interfaces.get_interface_by_id(0x0300), interfaces.get_interface_by_id(0x0200)])
+    devices = HFDevices()
+    devices.add_device(HFDevice(device_id=6, device_ipui="1234567891", device_name='Fritz Plug', units=[unit]))
+    return devices
+
+
+class RenderCacheTest(unittest.TestCase):
+
+    def setUp(self):
+        self.cache = RenderCache()
+        self.devices = make_devices()
+        self.renders = 0
+
+    def page(self, dev):
+        def render():
+            self.renders += 1
+            return return_minibrowser_device(dev)
+        return self.cache.get(('mini', dev.device_id), dev, dev.version, render)
+
+    def test_version(self):
+        dev = self.devices.get_device_by_id(6)
+        first = self.page(dev)
+        self.assertIs(self.page(dev), first)
+        self.assertEqual((self.renders, self.cache.hits), (1, 1))
+
+        # attribute report: rendered again
+        self.devices.set_attribute_values(6, 1, 0x0300, 1, [1, 0, 0, 0, 0])
+        self.assertEqual(self.page(dev), first)
+        self.assertEqual(self.renders, 2)
+
+    def test_owner_replaced(self):
+        self.page(self.devices.get_device_by_id(6))
+        # registered again with the same version
+        self.devices.delete_device_by_id(6)
+        self.devices.add_device(make_devices().get_device_by_id(6))
+        self.page(self.devices.get_device_by_id(6))
+        self.assertEqual(self.renders, 2)
+
+    def test_lru(self):
+        self.cache.max_entries = 2
+        for key in range(3):
+            self.cache.get(key, None, 0, lambda: key)
+        self.assertEqual(self.cache.get(0, None, 0, lambda: 'again'), 'again')
+        self.assertEqual(self.cache.get(2, None, 0, lambda: 'again'), 2)
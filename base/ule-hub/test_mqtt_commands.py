@@ -0,0 +1,181 @@
+# SPDX-License-Identifier: MIT
+import threading
+import unittest
+import han_client
+import mqtt_commands
+from han_server_sim import HANServerSim
+from mqtt_commands import Answered, CommandIngest, parse_command
+
+
+class Acks(object):
+    """ack callback collecting the published acknowledgements."""
+
+    def __init__(self):
+        self.acks = []
+        self.cond = threading.Condition()
+
+    def __call__(self, topic, payload):
+        with self.cond:
+            self.acks.append((topic, payload))
+            self.cond.notify_all()
+
+    def wait(self, count, timeout=5):
+        with self.cond:
+            self.cond.wait_for(lambda: len(self.acks) >= count, timeout)
+            return list(self.acks)
+
+
+class ParseCommandTest(unittest.TestCase):
+
+    def test_topic(self):
+        cmd = parse_command("homeassistant/ule/9/1/0x0201/1/set", b"1 0xff")
+        self.assertEqual((cmd.device_id, cmd.unit_id, cmd.interface_id, cmd.cmd_id), (9, 1, 513, 1))
+        self.assertEqual(cmd.data, b"\x01\xff")
+        self.assertEqual(cmd.msg_type, mqtt_commands.MSG_TYPE_COMMAND)
+        self.assertEqual(cmd.ack_topic, "homeassistant/ule/9/1/513/1/ack")
+
+    def test_json_payload(self):
+        self.assertEqual(parse_command("homeassistant/ule/2/1/512/2/set", "[]").data, b"")
+        cmd = parse_command("homeassistant/ule/2/1/512/2/set", '{"msg_type": 4, "data": [16, 32]}')
+        self.assertEqual((cmd.msg_type, cmd.data, cmd.bypass), (4, b"\x10\x20", False))
+        cmd = parse_command("homeassistant/ule/2/1/769/1/set", '{"msg_type": 4, "bypass": true}')
+        self.assertEqual((cmd.msg_type, cmd.data, cmd.bypass), (mqtt_commands.MSG_TYPE_GET_ATTRIBUTE, b"", True))
+
+    def test_invalid(self):
+        for topic, payload in [("homeassistant/ule/2/1/512/set", b""),
+                               ("homeassistant/sensor/MD/1/state", b""),
+                               ("homeassistant/ule/2/1/512/2/set", b"256"),
+                               ("homeassistant/ule/2/1/on/2/set", b"")]:
+            with self.assertRaises(ValueError, msg=topic):
+                parse_command(topic, payload)
+
+
+class CommandIngestTest(unittest.TestCase):
+
+    def test_dropped_when_full(self):
+        release = threading.Event()
+        acks = Acks()
+        ingest = CommandIngest(send=lambda cmd: release.wait(5) and 1, ack=acks, maxsize=1)
+        try:
+            # the first command blocks the worker in send, the second fills the queue
+            topic = "homeassistant/ule/2/1/512/1/set"
+            self.assertIsNotNone(ingest.put(topic, b""))
+            while ingest.stats()["queued"]:
+                pass
+            self.assertIsNotNone(ingest.put(topic, b""))
+            self.assertIsNone(ingest.put(topic, b""))
+            self.assertEqual(acks.wait(1)[0], ("homeassistant/ule/2/1/512/1/ack", {
+                "status": "dropped", "cookie": None, "queue_ms": None, "send_ms": None, "delivery_ms": None}))
+            self.assertIsNone(ingest.put("homeassistant/ule/x/1/512/1/set", b""))
+            self.assertEqual(acks.wait(2)[1][1]["status"], "invalid")
+        finally:
+            release.set()
+            ingest.stop()
+        self.assertEqual(ingest.counters["dropped"], 1)
+        self.assertEqual(ingest.counters["invalid"], 1)
+
+    def test_cached(self):
+        acks = Acks()
+        answers = {1: Answered("cached", [8, 52]), 2: Answered("pending")}
+        # send answers without a cookie: served by the gateway
+        ingest = CommandIngest(send=lambda cmd: answers[cmd.device_id], ack=acks)
+        try:
+            ingest.put("homeassistant/ule/1/1/769/1/set", '{"msg_type": 4}')
+            ingest.put("homeassistant/ule/2/1/769/1/set", '{"msg_type": 4}')
+            acks = dict(acks.wait(2))
+        finally:
+            ingest.stop()
+        cached = acks["homeassistant/ule/1/1/769/1/ack"]
+        self.assertEqual((cached["status"], cached["values"]), ("cached", [8, 52]))
+        pending = acks["homeassistant/ule/2/1/769/1/ack"]
+        self.assertEqual(pending["status"], "pending")
+        self.assertNotIn("values", pending)
+        stats = ingest.stats()
+        self.assertEqual((stats["cached"], stats["read_pending"], stats["pending"]), (1, 1, 0))
+
+    def test_delivered(self):
+        sim = HANServerSim(devices=3).start()
+        client = han_client.HANClient(port=sim.port)
+        client.start()
+        ipuis = {dev.id: dev.ipui for dev in client.get_full_dev_table()}
+
+        def send(cmd):
+            return client.fun_msg(ipui=ipuis.get(cmd.device_id, ""), src_dev_id=0, src_unit_id=2,
+                                  dst_dev_id=cmd.device_id, dst_unit_id=cmd.unit_id, interface_type=1,
+                                  interface_id=cmd.interface_id, msg_type=cmd.msg_type,
+                                  interface_member=cmd.cmd_id, data=str(cmd.data, encoding="ISO-8859-1"))
+
+        acks = Acks()
+        ingest = CommandIngest(send=send, ack=acks, timeout=0.5)
+        client.subscribe("FUN_MSG_RES", ingest.handle_fun_msg_res)
+        try:
+            ingest.put("homeassistant/ule/1/1/512/1/set", b"")
+            ingest.put("homeassistant/ule/3/1/512/2/set", b"1")
+            # unknown to the HAN server, never confirmed
+            ingest.put("homeassistant/ule/7/1/512/1/set", b"")
+            acks = acks.wait(3)
+        finally:
+            ingest.stop()
+            client.destroy()
+            sim.stop()
+
+        by_topic = {topic: payload for topic, payload in acks}
+        self.assertEqual(by_topic["homeassistant/ule/1/1/512/1/ack"]["status"], "delivered")
+        self.assertEqual(by_topic["homeassistant/ule/3/1/512/2/ack"]["status"], "delivered")
+        self.assertEqual(by_topic["homeassistant/ule/7/1/512/1/ack"]["status"], "timeout")
+        delivered = by_topic["homeassistant/ule/1/1/512/1/ack"]
+        self.assertGreaterEqual(delivered["delivery_ms"], delivered["queue_ms"])
+        stats = ingest.stats()
+        self.assertEqual((stats["sent"], stats["delivered"], stats["timeout"]), (3, 2, 1))
+        self.assertIsNotNone(stats["p99_ms"])
+
+    def test_response_during_send(self):
+        # FUN_MSG_RES handled by the HAN rx thread before send() returns
+        acks = Acks()
+        ingest = None
+
+        def send(cmd):
+            res = han_client.Message(service="[HAN]", name="FUN_MSG_RES")
+            res.params.update({"DEV_ID": str(cmd.device_id), "MSG_SEQ": "7"})
+            responder = threading.Thread(target=ingest.handle_fun_msg_res, args=(None, res))
+            responder.start()
+            responder.join(1)
+            # blocked on the lock: sent as error
+            assert not responder.is_alive()
+            return 7
+
+        ingest = CommandIngest(send=send, ack=acks)
+        try:
+            ingest.put("homeassistant/ule/1/1/512/1/set", b"")
+            self.assertEqual(acks.wait(1)[0][1]["status"], "delivered")
+        finally:
+            ingest.stop()
+        stats = ingest.stats()
+        self.assertEqual((stats["sent"], stats["delivered"], stats["pending"]), (1, 1, 0))
+
+    def test_response_without_cookie(self):
+        acks = Acks()
+        cookies = iter(range(1, 10))
+        ingest = CommandIngest(send=lambda cmd: next(cookies), ack=acks)
+        res = han_client.Message(service="[HAN]", name="FUN_MSG_RES")
+        res.params["DEV_ID"] = "2"
+        try:
+            ingest.put("homeassistant/ule/2/1/512/1/set", b"")
+            ingest.put("homeassistant/ule/2/1/512/2/set", b"")
+            ingest.put("homeassistant/ule/3/1/512/1/set", b"")
+            while ingest.stats().get("sent", 0) < 3:
+                pass
+            # two commands to device 2, which one is answered is not known
+            ingest.handle_fun_msg_res(None, res)
+            ingest.put("homeassistant/ule/2/1/512/3/set", b"")
+            while ingest.stats().get("sent", 0) < 4:
+                pass
+            ingest.handle_fun_msg_res(None, res)
+            acks = acks.wait(3)
+        finally:
+            ingest.stop()
+        self.assertEqual([(topic, payload["status"]) for topic, payload in acks], [
+            ("homeassistant/ule/2/1/512/1/ack", "ambiguous"),
+            ("homeassistant/ule/2/1/512/2/ack", "ambiguous"),
+            ("homeassistant/ule/2/1/512/3/ack", "delivered")])
+        self.assertEqual(ingest.stats()["pending"], 1)
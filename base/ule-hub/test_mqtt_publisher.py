@@ -0,0 +1,118 @@
+# SPDX-License-Identifier: MIT
+import threading
+import unittest
+from snom_sss_mqtt_hassio import CoalescingPublisher, snomSSSMqttHasssioClient
+
+
+class Result(object):
+    """paho MQTTMessageInfo, rc only."""
+
+    def __init__(self, rc):
+        self.rc = rc
+
+
+class Broker(object):
+    """publish callback recording the messages, topics in fail are rejected."""
+
+    def __init__(self):
+        self.messages = []
+        self.fail = {}
+        self.lock = threading.Lock()
+
+    def publish(self, topic, payload):
+        if topic in self.fail:
+            failure = self.fail[topic]
+            if isinstance(failure, Exception):
+                raise failure
+            return Result(failure)
+        with self.lock:
+            self.messages.append((topic, payload))
+        return Result(0)
+
+
+class CoalescingPublisherTest(unittest.TestCase):
+
+    def setUp(self):
+        self.broker = Broker()
+        # long enough for the puts of a test to land in one batch
+        self.publisher = CoalescingPublisher(self.broker.publish, window=0.2, max_topics=3)
+
+    def tearDown(self):
+        self.publisher.stop()
+
+    def test_coalescing(self):
+        for value in range(3):
+            self.publisher.put("a/state", str(value))
+        self.publisher.put("b/state", {"state": "ON"})
+        self.assertTrue(self.publisher.flush(timeout=2))
+        # the last payload per topic, in order of the first update, JSON encoded
+        self.assertEqual(self.broker.messages, [("a/state", "2"), ("b/state", '{"state": "ON"}')])
+        self.assertEqual((self.publisher.published, self.publisher.coalesced), (2, 2))
+
+    def test_not_coalesced(self):
+        self.publisher.put("a/ack", "delivered", coalesce=False)
+        self.publisher.put("a/ack", "timeout", coalesce=False)
+        self.publisher.put("a/ack", "1")
+        self.publisher.put("a/ack", "2")
+        self.assertTrue(self.publisher.flush(timeout=2))
+        self.assertEqual(self.broker.messages, [("a/ack", "delivered"), ("a/ack", "timeout"), ("a/ack", "2")])
+
+    def test_overflow(self):
+        for topic in ("a", "b", "c", "d"):
+            self.publisher.put(topic, topic)
+        self.assertTrue(self.publisher.flush(timeout=2))
+        self.assertEqual([topic for topic, _ in self.broker.messages], ["b", "c", "d"])
+        self.assertEqual(self.publisher.dropped, 1)
+
+    def test_failed_message(self):
+        self.broker.fail = {"a": RuntimeError("broker gone"), "b": 4}
+        published = []
+        for topic in ("a", "b", "c"):
+            self.publisher.put(topic, topic, lambda topic, payload: published.append(topic))
+        self.assertTrue(self.publisher.flush(timeout=2))
+        # the rest of the batch is still sent
+        self.assertEqual(self.broker.messages, [("c", "c")])
+        self.assertEqual(published, ["c"])
+        self.assertEqual((self.publisher.published, self.publisher.failed), (1, 2))
+
+
+class ConfigCacheTest(unittest.TestCase):
+
+    def setUp(self):
+        self.broker = Broker()
+        self.client = snomSSSMqttHasssioClient()
+        self.client.publisher.stop()
+        self.client.publisher = CoalescingPublisher(self.broker.publish, window=0.01)
+
+    def tearDown(self):
+        self.client.publisher.stop()
+
+    def publish_config(self, topic, payload):
+        self.client.publish_config(topic, payload)
+        self.assertTrue(self.client.publisher.flush(timeout=2))
+
+    def test_unchanged_config(self):
+        self.publish_config("md/config", {"name": "1"})
+        self.publish_config("md/config", {"name": "1"})
+        self.assertEqual(len(self.broker.messages), 1)
+        self.publish_config("md/config", {"name": "2"})
+        self.assertEqual(len(self.broker.messages), 2)
+
+        # the broker may have lost the configs
+        self.client.on_connect(self.client, None, {}, 0)
+        self.publish_config("md/config", {"name": "2"})
+        self.assertEqual(len(self.broker.messages), 3)
+
+    def test_failed_config(self):
+        self.broker.fail = {"md/config": 4}
+        self.publish_config("md/config", {"name": "1"})
+        self.assertEqual(self.broker.messages, [])
+
+        # not cached, sent again once the broker takes it
+        self.broker.fail = {}
+        self.publish_config("md/config", {"name": "1"})
+        self.assertEqual(self.broker.messages, [("md/config", '{"name": "1"}')])
+
+
+if __name__ == "__main__":
+    unittest.main()
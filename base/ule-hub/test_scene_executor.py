@@ -0,0 +1,66 @@
+# SPDX-License-Identifier: MIT
+import threading
+import time
+import unittest
+from DECTULEAction import HFAction, HFScene, SceneExecutor
+
+
+class SceneExecutorTest(unittest.TestCase):
+
+    def setUp(self):
+        self.done = []
+        self.lock = threading.Lock()
+        self.executor = SceneExecutor(workers=2, max_steps=4, action=self.action)
+        self.scene = HFScene(name='test')
+
+    def tearDown(self):
+        self.executor.stop()
+
+    def action(self, action):
+        with self.lock:
+            self.done.append((action.action_url, time.monotonic()))
+
+    def wait_idle(self, timeout=5):
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            stats = self.executor.stats()
+            if not stats['queue_depth'] and not stats['running'] and not stats['active_scenes']:
+                return stats
+            time.sleep(0.01)
+        self.fail('executor not idle')
+
+    def test_delayed_steps(self):
+        start = time.monotonic()
+        self.executor.submit(self.scene, '1', [HFAction('a', 0.2), HFAction('b', 0)])
+        stats = self.wait_idle()
+        self.assertEqual([url for url, _ in self.done], ['a', 'b'])
+        self.assertGreaterEqual(self.done[1][1] - start, 0.2)
+        self.assertEqual(stats['actions'], 2)
+        self.assertIsNotNone(stats['delay_p99_ms'])
+
+    def test_dedup_and_cancel(self):
+        self.assertTrue(self.executor.submit(self.scene, '1', [HFAction('a1', 0.2), HFAction('a2', 0)]))
+        # same state while running: ignored
+        self.assertFalse(self.executor.submit(self.scene, '1', [HFAction('a1', 0.2), HFAction('a2', 0)]))
+        time.sleep(0.05)
+        # other state: a2 is not executed
+        self.assertTrue(self.executor.submit(self.scene, '0', [HFAction('b1', 0)]))
+        stats = self.wait_idle()
+        self.assertEqual([url for url, _ in self.done], ['a1', 'b1'])
+        self.assertEqual((stats['deduplicated'], stats['cancelled']), (1, 1))
+
+        self.executor.submit(self.scene, '1', [HFAction('c1', 0.5), HFAction('c2', 0)])
+        time.sleep(0.05)
+        self.assertTrue(self.executor.cancel('test'))
+        self.wait_idle()
+        self.assertNotIn('c2', [url for url, _ in self.done])
+
+    def test_bounded(self):
+        # flapping sensor on many scenes: at most max_steps actions wait
+        blocked = threading.Event()
+        self.executor._action = lambda action: blocked.wait(5)
+        results = [self.executor.submit(HFScene(name=str(i)), '1', [HFAction('x', 0)]) for i in range(10)]
+        self.assertLessEqual(self.executor.stats()['queue_depth'], 4)
+        self.assertEqual(results.count(False), self.executor.stats()['dropped'])
+        blocked.set()
+        self.wait_idle()
@@ -1,7 +1,9 @@
 # SPDX-License-Identifier: MIT
-import time
 import struct
 import sys
+import time
+
+import framing
 
 
 class TimeoutError(Exception):
@@ -396,27 +398,14 @@ def send(f, unit, service, message, *ies):
     f.write(msg.pack())
 
 
-def receive(f, timeout=0):
-    buf = b''
-    expire_at = time.time() + timeout
-    while not timeout or expire_at > time.time():
-        byt = f.read(1)
-        if byt:
-            buf += byt
-        if len(buf) < 4:
-            continue
+def _frame_size(buf):
+    (length,) = struct.unpack("!H", buf[2:4])
+    return 4 + length
 
-        if buf[0:2] != b'\xda\xda':
-            buf = buf[1:]
-            continue
-
-        (length,) = struct.unpack("!H", buf[2:4])
-        if len(buf) < 4 + length:
-            continue
 
-        # we have a complete message buffer now
-        break
-    else:
+def receive(f, timeout=0):
+    buf = framing.reader(f, b'\xda\xda', 4, _frame_size).read_frame(timeout)
+    if buf is None:
         raise TimeoutError()
 
     msg = Message().unpack(buf)
@@ -424,9 +413,14 @@ def receive(f, timeout=0):
     return msg
 
 
-def wait(f, service, cmd):
+def wait(f, service, cmd, timeout=0):
+    """Wait for the message, raises TimeoutError after timeout seconds (0 waits forever)."""
+    expire_at = time.time() + timeout
     while True:
-        msg = receive(f)
+        remaining = expire_at - time.time()
+        if timeout and remaining <= 0:
+            raise TimeoutError()
+        msg = receive(f, remaining if timeout else 0)
         if msg.service == service and msg.id == cmd:
             return msg
 
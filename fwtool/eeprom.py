@@ -0,0 +1,276 @@
+# SPDX-License-Identifier: MIT
+"""Bulk EEPROM transfers.
+
+A single parameter direct (CMND) or parameter area (CMBS) request moves at
+most target.eeprom_chunk_size bytes. Ranges are split into chunks of that
+size and up to `window` requests are sent before the first response is
+read, so the serial line is not idle while the target handles a request.
+The target answers in order.
+
+When the target rejects a chunk (e.g. too large for its buffers), the
+responses in flight are drained, the chunk size is halved and the transfer
+continues at the rejected offset, until the chunk size reaches 0. A
+response which does not arrive within `timeout` seconds ends the transfer
+with EepromTimeout, instead of waiting forever for a lost frame.
+
+The target provides:
+
+    eeprom_chunk_size
+    send_get_eeprom(offset, length)   wait_get_eeprom(offset, timeout) -> (result, data)
+    send_set_eeprom(offset, data)     wait_set_eeprom(offset, timeout) -> result
+
+wait_* raise TimeoutError (cmnd.TimeoutError, cmbs.TimeoutError) when no
+response arrived within timeout seconds, and ValueError when the response
+does not match the request (other type or offset); the transfer then ends
+with UnexpectedResponse.
+
+EEPROM images (dump/restore/diff) hold a range and its metadata
+(network byte order):
+  4 byte magic "FWEE"
+  1 byte version
+  1 byte target type (1 = CMND, 2 = CMBS)
+  2 byte reserved
+  4 byte offset
+  4 byte length
+  4 byte CRC32 of the data
+  4 byte creation time (unix time)
+  32 byte label, UTF-8, zero padded
+  data
+"""
+import collections
+import struct
+import time
+import zlib
+
+import cmbs
+import cmnd
+
+# requests in flight
+WINDOW = 4
+# seconds to wait for one response, as for the hello at connect
+TIMEOUT = 4
+
+MAGIC = b"FWEE"
+VERSION = 1
+TARGET_CMND = 1
+TARGET_CMBS = 2
+
+HEADER_FMT = "!4sBBHLLLL32s"
+HEADER_SIZE = struct.calcsize(HEADER_FMT)
+
+# unchanged bytes between two differences which are written rather than
+# split into two requests
+DIFF_GAP = 8
+
+# raised by the targets' wait_* when no response arrived
+TIMEOUT_ERRORS = (TimeoutError, cmnd.TimeoutError, cmbs.TimeoutError)
+
+
+class EepromError(Exception):
+    def __init__(self, offset, code):
+        self.offset = offset
+        self.code = code
+
+    def __str__(self):
+        return "error code {:#04x} at offset {:#010x}".format(self.code, self.offset)
+
+
+class EepromTimeout(Exception):
+    def __init__(self, offset):
+        self.offset = offset
+
+    def __str__(self):
+        return "no response at offset {:#010x}".format(self.offset)
+
+
+class UnexpectedResponse(Exception):
+    def __init__(self, offset, reason=""):
+        self.offset = offset
+        self.reason = reason
+
+    def __str__(self):
+        return "unexpected response at offset {:#010x}{}".format(
+            self.offset, ": {}".format(self.reason) if self.reason else "")
+
+
+class VerifyError(Exception):
+    def __init__(self, offset):
+        self.offset = offset
+
+    def __str__(self):
+        return "verify failed, first difference at offset {:#010x}".format(self.offset)
+
+
+class ImageError(Exception):
+    pass
+
+
+class Stats(object):
+    """Bytes transferred and throughput of one operation."""
+
+    def __init__(self):
+        self.start = time.time()
+        self.bytes = 0
+        self.requests = 0
+
+    @property
+    def duration(self):
+        return time.time() - self.start
+
+    @property
+    def rate(self):
+        return self.bytes / max(self.duration, 1e-6)
+
+    def __str__(self):
+        return "{} bytes in {} requests, {:.2f} s, {:.0f} bytes/s".format(
+            self.bytes, self.requests, self.duration, self.rate)
+
+
+def _transfer(send, wait, offset, length, chunk, window, progress, stats):
+    """Yields (offset, data) of the chunks in order, data is None for writes."""
+    end = offset + length
+    pos = offset
+    inflight = collections.deque()
+
+    def response(off, size):
+        try:
+            return wait(off, size)
+        except TIMEOUT_ERRORS:
+            raise EepromTimeout(off)
+        except ValueError as e:
+            raise UnexpectedResponse(off, str(e))
+
+    while pos < end or inflight:
+        while pos < end and len(inflight) < window:
+            size = min(chunk, end - pos)
+            send(pos, size)
+            inflight.append((pos, size))
+            pos += size
+
+        off, size = inflight.popleft()
+        result, data = response(off, size)
+        stats.requests += 1
+        if result != 0:
+            # the following requests were sent with the same chunk size
+            while inflight:
+                response(*inflight.popleft())
+            chunk = size // 2
+            if not chunk:
+                raise EepromError(off, result)
+            pos = off
+            continue
+
+        stats.bytes += size
+        if progress:
+            progress(size)
+        yield off, data
+
+
+def iter_read(target, offset, length, window=WINDOW, progress=None, stats=None):
+    """Yields the data of the range chunk by chunk."""
+    stats = stats or Stats()
+
+    def wait(off, size):
+        result, data = target.wait_get_eeprom(off, TIMEOUT)
+        if result == 0 and len(data) != size:
+            raise ValueError("short read, {} of {} bytes".format(len(data), size))
+        return result, data
+
+    chunks = _transfer(target.send_get_eeprom, wait,
+                       offset, length, target.eeprom_chunk_size, window, progress, stats)
+    for _, data in chunks:
+        yield data
+
+
+def read(target, offset, length, window=WINDOW, progress=None, stats=None):
+    return b"".join(iter_read(target, offset, length, window, progress, stats))
+
+
+def write(target, offset, data, window=WINDOW, progress=None, stats=None):
+    data = bytes(data)
+    stats = stats or Stats()
+
+    def send(off, size):
+        target.send_set_eeprom(off, data[off - offset:off - offset + size])
+
+    def wait(off, size):
+        return target.wait_set_eeprom(off, TIMEOUT), None
+
+    for _ in _transfer(send, wait, offset, len(data), target.eeprom_chunk_size, window, progress, stats):
+        pass
+
+
+def verify(target, offset, data, window=WINDOW, progress=None, stats=None):
+    """Read the range back and compare its checksum, raises VerifyError."""
+    data = bytes(data)
+    readback = read(target, offset, len(data), window, progress, stats)
+    if zlib.crc32(readback) != zlib.crc32(data):
+        diff = next((i for i, (a, b) in enumerate(zip(bytearray(readback), bytearray(data))) if a != b),
+                    min(len(readback), len(data)))
+        raise VerifyError(offset + diff)
+
+
+class Image(object):
+    def __init__(self, target_type, offset, data, label="", created=None):
+        self.target_type = target_type
+        self.offset = offset
+        self.data = bytes(data)
+        self.label = label
+        self.created = int(time.time()) if created is None else created
+
+    def pack(self):
+        label = self.label.encode("utf-8")[:32]
+        header = struct.pack(HEADER_FMT, MAGIC, VERSION, self.target_type, 0, self.offset, len(self.data),
+                             zlib.crc32(self.data) & 0xffffffff, self.created, label)
+        return header + self.data
+
+    @classmethod
+    def unpack(cls, buf):
+        if len(buf) < HEADER_SIZE:
+            raise ImageError("image too short")
+        magic, version, target_type, _, offset, length, crc, created, label = \
+            struct.unpack(HEADER_FMT, buf[:HEADER_SIZE])
+        if magic != MAGIC:
+            raise ImageError("not an EEPROM image")
+        if version != VERSION:
+            raise ImageError("unsupported image version {}".format(version))
+        data = buf[HEADER_SIZE:]
+        if len(data) != length:
+            raise ImageError("image truncated: {} of {} bytes".format(len(data), length))
+        if zlib.crc32(data) & 0xffffffff != crc:
+            raise ImageError("image checksum mismatch")
+        return cls(target_type, offset, data, label.rstrip(b"\x00").decode("utf-8", "replace"), created)
+
+
+def diff_runs(old, new, gap=DIFF_GAP):
+    """(start, end) index ranges where new differs from old, runs closer than gap are joined."""
+    runs = []
+    for i, (a, b) in enumerate(zip(bytearray(old), bytearray(new))):
+        if a == b:
+            continue
+        if runs and i - runs[-1][1] <= gap:
+            runs[-1][1] = i + 1
+        else:
+            runs.append([i, i + 1])
+    return [tuple(run) for run in runs]
+
+
+def restore(target, image, window=WINDOW, progress=None, stats=None):
+    """Write the whole image and verify it."""
+    write(target, image.offset, image.data, window, progress, stats)
+    verify(target, image.offset, image.data, window)
+
+
+def update(target, image, window=WINDOW, progress=None, stats=None, dry_run=False):
+    """Write only the bytes which differ from the device, returns the written runs.
+
+    progress counts the bytes read, then the bytes written."""
+    current = read(target, image.offset, len(image.data), window, progress, stats)
+    runs = diff_runs(current, image.data)
+    if dry_run:
+        return runs
+    for start, end in runs:
+        write(target, image.offset + start, image.data[start:end], window, progress, stats)
+    for start, end in runs:
+        verify(target, image.offset + start, image.data[start:end], window)
+    return runs
@@ -0,0 +1,77 @@
+# SPDX-License-Identifier: MIT
+"""Buffered frame reader for the CMND and CMBS serial protocols.
+
+Both protocols start a frame with a sync pattern (0xdada for CMND,
+0xdadadada for CMBS) followed by a length field. The reader takes whatever
+the serial port has buffered in one read, searches the sync with find() and
+returns one complete frame per call. Bytes after the frame stay in the
+buffer for the next call, so the reader is kept per port.
+"""
+import time
+import weakref
+
+# bytes read at once from ports which cannot tell how many are waiting
+CHUNK_SIZE = 4096
+# pause when nothing was received, the port is opened non-blocking (timeout=0)
+POLL_INTERVAL = 0.001
+
+
+class FrameReader(object):
+    def __init__(self, f, sync, header_size, frame_size):
+        """frame_size(buf) returns the size of the frame starting at buf, which holds
+        at least header_size bytes (sync included)."""
+        self._f = f
+        self.sync = sync
+        self.header_size = header_size
+        self.frame_size = frame_size
+        self.buf = bytearray()
+
+    def _fill(self):
+        waiting = getattr(self._f, 'in_waiting', None)
+        data = self._f.read(max(1, waiting) if waiting is not None else CHUNK_SIZE)
+        if data:
+            self.buf += data
+        return bool(data)
+
+    def _frame(self):
+        start = self.buf.find(self.sync)
+        if start < 0:
+            # drop junk, but keep a sync pattern which is not complete yet
+            del self.buf[:max(0, len(self.buf) - len(self.sync) + 1)]
+            return None
+        del self.buf[:start]
+        if len(self.buf) < self.header_size:
+            return None
+
+        size = self.frame_size(self.buf)
+        if len(self.buf) < size:
+            return None
+        frame = bytes(self.buf[:size])
+        del self.buf[:size]
+        return frame
+
+    def read_frame(self, timeout=0):
+        """Return the next complete frame, None after timeout seconds (0 waits forever)."""
+        expire_at = time.time() + timeout
+        while True:
+            frame = self._frame()
+            if frame is not None:
+                return frame
+            if timeout and expire_at <= time.time():
+                return None
+            if not self._fill():
+                time.sleep(POLL_INTERVAL)
+
+
+_readers = weakref.WeakKeyDictionary()
+
+
+def reader(f, sync, header_size, frame_size):
+    """FrameReader of port f, created on first use."""
+    r = _readers.get(f)
+    if r is None or r.sync != sync:
+        old = r
+        r = _readers[f] = FrameReader(f, sync, header_size, frame_size)
+        if old is not None:
+            r.buf = old.buf
+    return r
@@ -11,13 +11,12 @@ __version__ = "0.1"
 #  $ fwtool region <"eu"|"us"|"jp"|"kr"> # set target firmware
 #  $ fwtool param <name> [value] # set/get parameter
 #  $ fwtool eeprom <range> <bytes> # set/get eeprom values
+#  $ fwtool eeprom dump <range> <image> # save eeprom range to image
+#  $ fwtool eeprom restore <image> # write image to eeprom
+#  $ fwtool eeprom diff <image> # write only bytes differing from image
 #  $ fwtool preset <name/id> # apply eeprom preset
+#  $ fwtool suota <image> [output] # pack SUOTA transport image
 
-# TODO: eeprom: add --dump feature
-#   - implement as stream, yielding bytes as we go
-#   - on CMND, we do not have the eeprom size
-#     - read in 256 byte chunks
-#     - on ie.response = 1, half chunk size, retry until chunk size is 0
 # TODO: eeprom: dump binary data when connected to pipe (tty detection)
 
 import logging
@@ -30,6 +29,8 @@ import serial
 
 import cmbs
 import cmnd
+import eeprom
+import suota
 
 
 class ResponseError(Exception):
@@ -155,6 +156,11 @@ class CMND(object):
         ("minimum_sleep_time", dict(id=0x1c, format=">L", desc="Minimum time the device should be sleeping between pages, in ms.")) # noqa
     ])
 
+    # bytes per parameter direct request, CMND_IE_PARAMETER_DIRECT_DATA_MAX_LENGTH:
+    # CMND_API_PAYLOAD_MAX_LENGTH (167, 250 only in supermarket builds) minus the
+    # IE header (3) and the parameter direct header (7)
+    eeprom_chunk_size = 167 - 3 - 7
+
     class ProductionModeContext(object):
         def __init__(self, target):
             self._target = target
@@ -184,8 +190,8 @@ class CMND(object):
     def send(self, svc, msg, *ies):
         cmnd.send(self._ser, 0, svc, msg, *ies)
 
-    def wait(self, svc, msg):
-        return cmnd.wait(self._ser, svc, msg)
+    def wait(self, svc, msg, timeout=0):
+        return cmnd.wait(self._ser, svc, msg, timeout)
 
     def release(self):
         self.into_normal()
@@ -251,26 +257,41 @@ class CMND(object):
             raise ResponseError(ie.result)
 
     def get_param_direct(self, typ, offset, length):
+        self.send_get_param_direct(typ, offset, length)
+        result, data = self.wait_get_param_direct(typ, offset)
+        if result != 0:
+            raise ResponseError(result)
+        return data
+
+    def send_get_param_direct(self, typ, offset, length):
         ie = cmnd.IEParameterDirect(typ, offset, length=length)
         self.send(cmnd.SERVICE_ID_PARAMETERS, cmnd.MSG_PARAM_GET_DIRECT_REQ, ie)
-        msg = self.wait(cmnd.SERVICE_ID_PARAMETERS, cmnd.MSG_PARAM_GET_DIRECT_RES)
+
+    def wait_get_param_direct(self, typ, offset, timeout=0):
+        msg = self.wait(cmnd.SERVICE_ID_PARAMETERS, cmnd.MSG_PARAM_GET_DIRECT_RES, timeout)
         ie = msg.get_ie(cmnd.IEResponse)
         if ie.result != 0:
-            raise ResponseError(ie.result)
+            return ie.result, None
         ie = msg.get_ie(cmnd.IEParameterDirect)
         if ie.type != typ:
-            raise ValueError()
+            raise ValueError("parameter type {}, expected {}".format(ie.type, typ))
         if ie.offset != offset:
-            raise ValueError()
-        return ie.data
+            raise ValueError("offset {:#010x}, expected {:#010x}".format(ie.offset, offset))
+        return 0, ie.data
 
     def set_param_direct(self, typ, offset, data):
+        self.send_set_param_direct(typ, offset, data)
+        result = self.wait_set_param_direct()
+        if result != 0:
+            raise ResponseError(result)
+
+    def send_set_param_direct(self, typ, offset, data):
         ie = cmnd.IEParameterDirect(typ, offset, data)
         self.send(cmnd.SERVICE_ID_PARAMETERS, cmnd.MSG_PARAM_SET_DIRECT_REQ, ie)
-        msg = self.wait(cmnd.SERVICE_ID_PARAMETERS, cmnd.MSG_PARAM_SET_DIRECT_RES)
-        ie = msg.get_ie(cmnd.IEResponse)
-        if ie.result != 0:
-            raise ResponseError(ie.result)
+
+    def wait_set_param_direct(self, timeout=0):
+        msg = self.wait(cmnd.SERVICE_ID_PARAMETERS, cmnd.MSG_PARAM_SET_DIRECT_RES, timeout)
+        return msg.get_ie(cmnd.IEResponse).result
 
     def region(self, settings):
         us_dect, support_fcc, full_power, deviation, pa2_comp = settings
@@ -281,13 +302,24 @@ class CMND(object):
         self.set_param(cmnd.PARAM_EEPROM_DECT_DEVIATION, struct.pack("B", deviation))
         self.set_param(cmnd.PARAM_EEPROM_DECT_PA2_COMP, struct.pack("B", pa2_comp))
 
-    def get_eeprom(self, offset, length):
-        # dect eeprom only for now
-        return self.get_param_direct(cmnd.PARAM_ADDRESS_TYPE_DECT_EEPROM, offset, length)
+    # dect eeprom only for now
+    def get_eeprom(self, offset, length, window=eeprom.WINDOW, progress=None):
+        return eeprom.read(self, offset, length, window, progress)
+
+    def set_eeprom(self, offset, data, window=eeprom.WINDOW, progress=None):
+        eeprom.write(self, offset, data, window, progress)
+
+    def send_get_eeprom(self, offset, length):
+        self.send_get_param_direct(cmnd.PARAM_ADDRESS_TYPE_DECT_EEPROM, offset, length)
 
-    def set_eeprom(self, offset, data):
-        # dect eeprom only for now
-        self.set_param_direct(cmnd.PARAM_ADDRESS_TYPE_DECT_EEPROM, offset, data)
+    def wait_get_eeprom(self, offset, timeout=0):
+        return self.wait_get_param_direct(cmnd.PARAM_ADDRESS_TYPE_DECT_EEPROM, offset, timeout)
+
+    def send_set_eeprom(self, offset, data):
+        self.send_set_param_direct(cmnd.PARAM_ADDRESS_TYPE_DECT_EEPROM, offset, data)
+
+    def wait_set_eeprom(self, offset, timeout=0):
+        return self.wait_set_param_direct(timeout)
 
     def set_preset(self, id):
         self.send(cmnd.SERVICE_ID_PRODUCTION, cmnd.MSG_PROD_SPECIFIC_PRESET_REQ, cmnd.IEU8(id))
@@ -303,6 +335,9 @@ class CMND(object):
 class CMBS(object):
     params = {}
 
+    # bytes per parameter area request, the target's buffer limit
+    eeprom_chunk_size = cmbs.PARAM_MAX_TRANSFER_SIZE
+
     # stub, before calling sending EV_DSR_SYS_START we already are
     # in what CMND calls production mode
     class ProductionModeContext(object):
@@ -350,8 +385,8 @@ class CMBS(object):
     def send(self, event, *ies):
         cmbs.send(self._ser, event, *ies)
 
-    def wait(self, event):
-        msg = cmbs.wait(self._ser, event)
+    def wait(self, event, timeout=0):
+        msg = cmbs.wait(self._ser, event, timeout)
         return msg
 
     def reset(self):
@@ -401,28 +436,43 @@ class CMBS(object):
             raise ResponseError(ie.result)
 
     def get_param_area(self, typ, offset, length):
+        self.send_get_param_area(typ, offset, length)
+        result, data = self.wait_get_param_area(typ, offset)
+        if result != 0:
+            raise ResponseError(result)
+        if len(data) != length:
+            raise ValueError()
+        return data
+
+    def send_get_param_area(self, typ, offset, length):
         ie = cmbs.IEParameterArea(typ, offset, length=length)
         self.send(cmbs.EV_DSR_PARAM_AREA_GET, ie)
-        msg = self.wait(cmbs.EV_DSR_PARAM_AREA_GET_RES)
+
+    def wait_get_param_area(self, typ, offset, timeout=0):
+        msg = self.wait(cmbs.EV_DSR_PARAM_AREA_GET_RES, timeout)
         ie = msg.get_ie(cmbs.IEResponse)
         if ie.result != 0:
-            raise ResponseError(ie.result)
+            return ie.result, None
         ie = msg.get_ie(cmbs.IEParameterArea)
         if ie.type != typ:
-            raise ValueError()
+            raise ValueError("parameter area type {}, expected {}".format(ie.type, typ))
         if ie.offset != offset:
-            raise ValueError()
-        if len(ie.data) != length:
-            raise ValueError()
-        return ie.data
+            raise ValueError("offset {:#010x}, expected {:#010x}".format(ie.offset, offset))
+        return 0, ie.data
 
     def set_param_area(self, typ, offset, data):
+        self.send_set_param_area(typ, offset, data)
+        result = self.wait_set_param_area()
+        if result != 0:
+            raise ResponseError(result)
+
+    def send_set_param_area(self, typ, offset, data):
         ie = cmbs.IEParameterArea(typ, offset, data)
         self.send(cmbs.EV_DSR_PARAM_AREA_SET, ie)
-        msg = self.wait(cmbs.EV_DSR_PARAM_AREA_SET_RES)
-        ie = msg.get_ie(cmbs.IEResponse)
-        if ie.result != 0:
-            raise ResponseError(ie.result)
+
+    def wait_set_param_area(self, timeout=0):
+        msg = self.wait(cmbs.EV_DSR_PARAM_AREA_SET_RES, timeout)
+        return msg.get_ie(cmbs.IEResponse).result
 
     def region(self, settings):
         us_dect, support_fcc, full_power, deviation, pa2_comp = settings
@@ -433,11 +483,23 @@ class CMBS(object):
         self.set_param(cmbs.PARAM_RF19APU_DEVIATION, struct.pack("B", deviation))
         self.set_param(cmbs.PARAM_RF19APU_PA2_COMP, struct.pack("B", pa2_comp))
 
-    def get_eeprom(self, offset, length):
-        return self.get_param_area(cmbs.PARAM_AREA_TYPE_EEPROM, offset, length)
+    def get_eeprom(self, offset, length, window=eeprom.WINDOW, progress=None):
+        return eeprom.read(self, offset, length, window, progress)
+
+    def set_eeprom(self, offset, data, window=eeprom.WINDOW, progress=None):
+        eeprom.write(self, offset, data, window, progress)
+
+    def send_get_eeprom(self, offset, length):
+        self.send_get_param_area(cmbs.PARAM_AREA_TYPE_EEPROM, offset, length)
+
+    def wait_get_eeprom(self, offset, timeout=0):
+        return self.wait_get_param_area(cmbs.PARAM_AREA_TYPE_EEPROM, offset, timeout)
 
-    def set_eeprom(self, offset, data):
-        self.set_param_area(cmbs.PARAM_AREA_TYPE_EEPROM, offset, data)
+    def send_set_eeprom(self, offset, data):
+        self.send_set_param_area(cmbs.PARAM_AREA_TYPE_EEPROM, offset, data)
+
+    def wait_set_eeprom(self, offset, timeout=0):
+        return self.wait_set_param_area(timeout)
 
     def session(self):
         return self
@@ -556,15 +618,61 @@ def format_bytes(bytes):
     res = []
     for i in range(0, len(bytes), 16):
         chunk = bytes[i:i+16]
-        res.append(" ".join("{:02x}".format(ord(b)) for b in chunk))
+        res.append(" ".join("{:02x}".format(b) for b in bytearray(chunk)))
     return "\n".join(res)
 
 
-@cli.command()
+class NoProgress(object):
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        pass
+
+    def update(self, n):
+        pass
+
+
+def transfer_progress(target, label, length):
+    """Progress bar on stderr, for transfers of more than one request."""
+    if length <= target.eeprom_chunk_size:
+        return NoProgress()
+    return click.progressbar(length=length, label=label, file=sys.stderr)
+
+
+def target_type(target):
+    return eeprom.TARGET_CMND if target.is_cmnd() else eeprom.TARGET_CMBS
+
+
+class EepromGroup(click.Group):
+    """Runs the hidden 'range' command unless a subcommand is given, which keeps
+    'eeprom <RANGE> [BYTES]...' working."""
+
+    def parse_args(self, ctx, args):
+        if args and args[0] not in self.commands and args[0] != "--help":
+            args = ["range"] + args
+        return super(EepromGroup, self).parse_args(ctx, args)
+
+
+@cli.group(name="eeprom", cls=EepromGroup)
+def eeprom_cmd():
+    """Modify EEPROM values, dump and restore EEPROM images.
+
+    \b
+    fwtool eeprom <RANGE> [BYTES]...
+    fwtool eeprom dump <RANGE> <IMAGE>
+    fwtool eeprom restore <IMAGE>
+    fwtool eeprom diff <IMAGE>
+    """
+
+
+@eeprom_cmd.command(name="range", hidden=True)
+@click.option("--window", default=eeprom.WINDOW, show_default=True, help="Requests in flight.")
+@click.option("--verify/--no-verify", default=True, show_default=True, help="Read back written bytes.")
 @click.argument("range")
 @click.argument("bytes", required=False, nargs=-1)
 @click.pass_context
-def eeprom(ctx, range, bytes):
+def eeprom_range(ctx, window, verify, range, bytes):
     """Modify EEPROM values."""
     try:
         offset, length = parse_range(range)
@@ -593,18 +701,124 @@ def eeprom(ctx, range, bytes):
         write = False
 
     target = connect_target(ctx)
-    with target.production_mode():
-        if write:
-            target.set_eeprom(offset, bytes)
-        else:
-            bytes = target.get_eeprom(offset, length)
+    stats = eeprom.Stats()
+    try:
+        with target.production_mode():
+            if write:
+                with transfer_progress(target, "Writing", len(bytes)) as bar:
+                    eeprom.write(target, offset, bytes, window, bar.update, stats)
+                if verify:
+                    eeprom.verify(target, offset, bytes, window)
+            else:
+                with transfer_progress(target, "Reading", length) as bar:
+                    bytes = eeprom.read(target, offset, length, window, bar.update, stats)
+    except (eeprom.EepromError, eeprom.EepromTimeout, eeprom.UnexpectedResponse, eeprom.VerifyError) as e:
+        err_exit(e)
 
+    if stats.requests > 1:
+        click.echo(stats, err=True)
     if write:
-        click.echo("Wrote {} byte(s) to offset {:#010x}.".format(len(bytes), offset))
+        click.echo("Wrote {} byte(s) to offset {:#010x}{}.".format(len(bytes), offset, ", verified" if verify else ""))
     else:
         click.echo(format_bytes(bytes))
 
 
+def read_image(image):
+    try:
+        return eeprom.Image.unpack(image.read())
+    except eeprom.ImageError as e:
+        err_exit(e)
+
+
+def check_image(target, image, force):
+    if image.target_type != target_type(target) and not force:
+        err_exit("image was dumped from a {} target, use '--force' to write it anyway.".format(
+            "CMND" if image.target_type == eeprom.TARGET_CMND else "CMBS"))
+
+
+@eeprom_cmd.command(name="dump")
+@click.option("--window", default=eeprom.WINDOW, show_default=True, help="Requests in flight.")
+@click.option("--label", default="", help="Text stored in the image header, up to 32 bytes.")
+@click.argument("range")
+@click.argument("image", type=click.File("wb"))
+@click.pass_context
+def eeprom_dump(ctx, window, label, range, image):
+    """Save an EEPROM range to an image file."""
+    try:
+        offset, length = parse_range(range)
+    except ValueError as e:
+        err_exit(e)
+    if not length:
+        err_exit("specify the range as <offset>+<length>.")
+
+    target = connect_target(ctx)
+    stats = eeprom.Stats()
+    try:
+        with target.production_mode():
+            with transfer_progress(target, "Reading", length) as bar:
+                data = eeprom.read(target, offset, length, window, bar.update, stats)
+    except (eeprom.EepromError, eeprom.EepromTimeout, eeprom.UnexpectedResponse) as e:
+        err_exit(e)
+
+    image.write(eeprom.Image(target_type(target), offset, data, label).pack())
+    click.echo(stats, err=True)
+    click.echo("Saved {} byte(s) from offset {:#010x}.".format(length, offset))
+
+
+@eeprom_cmd.command(name="restore")
+@click.option("--window", default=eeprom.WINDOW, show_default=True, help="Requests in flight.")
+@click.option("--force", is_flag=True, help="Write an image dumped from another target type.")
+@click.argument("image", type=click.File("rb"))
+@click.pass_context
+def eeprom_restore(ctx, window, force, image):
+    """Write an image file to EEPROM and verify it."""
+    image = read_image(image)
+    target = connect_target(ctx)
+    check_image(target, image, force)
+
+    stats = eeprom.Stats()
+    try:
+        with target.production_mode():
+            with transfer_progress(target, "Writing", len(image.data)) as bar:
+                eeprom.restore(target, image, window, bar.update, stats)
+    except (eeprom.EepromError, eeprom.EepromTimeout, eeprom.UnexpectedResponse, eeprom.VerifyError) as e:
+        err_exit(e)
+
+    click.echo(stats, err=True)
+    click.echo("Restored {} byte(s) to offset {:#010x}, verified.".format(len(image.data), image.offset))
+
+
+@eeprom_cmd.command(name="diff")
+@click.option("--window", default=eeprom.WINDOW, show_default=True, help="Requests in flight.")
+@click.option("--force", is_flag=True, help="Write an image dumped from another target type.")
+@click.option("--dry-run", is_flag=True, help="Only list the differences.")
+@click.argument("image", type=click.File("rb"))
+@click.pass_context
+def eeprom_diff(ctx, window, force, dry_run, image):
+    """Write only the bytes of an image file which differ from EEPROM."""
+    image = read_image(image)
+    target = connect_target(ctx)
+    if not dry_run:
+        check_image(target, image, force)
+
+    stats = eeprom.Stats()
+    try:
+        with target.production_mode():
+            with transfer_progress(target, "Comparing", len(image.data)) as bar:
+                runs = eeprom.update(target, image, window, bar.update, stats, dry_run)
+    except (eeprom.EepromError, eeprom.EepromTimeout, eeprom.UnexpectedResponse, eeprom.VerifyError) as e:
+        err_exit(e)
+
+    click.echo(stats, err=True)
+    for start, end in runs:
+        click.echo("{:#010x}+{}".format(image.offset + start, end - start))
+    changed = sum(end - start for start, end in runs)
+    if dry_run:
+        click.echo("{} byte(s) in {} range(s) differ.".format(changed, len(runs)))
+    else:
+        click.echo("Wrote {} byte(s) in {} range(s), verified.".format(changed, len(runs)))
+
+
 @cli.command()
 @click.option("--list", is_flag=True, help="List supported presets.")
 @click.argument("name", required=False)
@@ -641,5 +855,34 @@ def preset(ctx, list, name):
     click.secho("Please re-register your device.", fg="green")
 
 
+@cli.command(name="suota")
+@click.option("--block-size", default=suota.BLOCK_SIZE_DEFAULT, show_default=True,
+              type=click.IntRange(1, suota.BLOCK_SIZE_MAX),
+              help="Decoded block size, up to the node's decoder limit.")
+@click.option("--chunk", default=128, show_default=True, help="Bytes per SUOTA read file request.")
+@click.option("--rate", default=1000, show_default=True, help="Effective link throughput in bytes/s.")
+@click.option("--latency", default=0.1, show_default=True, help="Round trip time per read request in s.")
+@click.argument("image", type=click.File("rb"))
+@click.argument("output", type=click.File("wb"), required=False)
+def suota_pack(image, output, block_size, chunk, rate, latency):
+    """Pack a SUOTA image for compressed transport."""
+    raw = image.read()
+    try:
+        packed = suota.pack(raw, block_size)
+        # verify with the reference decoder before anything leaves the host
+        if suota.unpack(packed) != raw:
+            err_exit("packed image does not decode to the original image")
+    except suota.ImageError as e:
+        err_exit(e)
+
+    if output:
+        output.write(packed)
+
+    for name, size in (("raw", len(raw)), ("packed", len(packed))):
+        reads, duration = suota.transfer_stats(size, chunk, rate, latency)
+        click.echo("{:<6} {:>8} bytes {:>6} reads {:>8.1f} s".format(name, size, reads, duration))
+    click.echo("Saved {:.1%} of transferred bytes.".format(1 - float(len(packed)) / len(raw)))
+
+
 if __name__ == "__main__":
     cli(obj={})
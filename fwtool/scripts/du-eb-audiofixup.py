@@ -51,14 +51,15 @@ class CMND(object):
         if ie.result != 0:
             raise ResponseError()
 
-    def set_dect_eeprom(self, address, value):
-        ie = cmnd.IeParameterDirect(0x02, address, bytearray([value]))
+    def set_dect_eeprom(self, address, values):
+        # consecutive bytes in one request
+        ie = cmnd.IeParameterDirect(0x02, address, bytearray(values))
         cmnd.send(self._ser, 0, cmnd.SERVICE_ID_PARAMETERS, cmnd.MSG_PARAM_SET_DIRECT_REQ, cmnd.ie_topayload(ie))
         resp = cmnd.wait(self._ser, cmnd.SERVICE_ID_PARAMETERS, cmnd.MSG_PARAM_SET_DIRECT_RES)
         ie = cmnd.ie_get(resp.payload, cmnd.IeResponse)
         if ie.result != 0:
             raise ResponseError()
-        print("[*] Set DECT EEPROM {:#06x} = {:#04x}".format(address, value))
+        print("[*] Set DECT EEPROM {:#06x} = {}".format(address, " ".join("{:#04x}".format(v) for v in values)))
 
     def into_normal(self):
         print("[ ] Requesting normal mode...")
@@ -136,13 +137,9 @@ def main():
     target.into_production()
 
     # AEC_MODE - disable AEC
-    target.set_dect_eeprom(0x226, 0x00)
-    target.set_dect_eeprom(0x227, 0x00)
+    target.set_dect_eeprom(0x226, [0x00, 0x00])
     # ACL_V_MIN/ACL_V_MAX - disable dynamic volume, fix to 0x0800
-    target.set_dect_eeprom(0x273, 0x00)
-    target.set_dect_eeprom(0x274, 0x08)
-    target.set_dect_eeprom(0x275, 0x00)
-    target.set_dect_eeprom(0x276, 0x08)
+    target.set_dect_eeprom(0x273, [0x00, 0x08, 0x00, 0x08])
 
     target.into_normal()
 
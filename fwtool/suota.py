@@ -0,0 +1,174 @@
+# SPDX-License-Identifier: MIT
+"""SUOTA transport image packing.
+
+Firmware images are placed on the SUOTA server and read by the node in small
+chunks over DECT ULE. Large parts of an image are padding or repeated bytes, so
+the image is split into blocks which are run length encoded whenever that
+saves space. The node side decoder lives in CmndLib (CmndSuotaImage.c).
+
+Image format (network byte order):
+  3 byte magic "SUZ"
+  1 byte version
+  1 byte method (1 = RLE)
+  1 byte reserved
+  2 byte decoded block size
+  4 byte decoded image size
+  4 byte decoded image checksum (32 bit byte sum)
+  blocks:
+    2 byte block header, bit 15 set if compressed, bits 0..14 encoded length
+    encoded block data
+
+RLE control byte:
+  0x00..0x7f: copy the next n + 1 bytes
+  0x80..0xff: repeat the next byte n - 0x80 + 3 times
+"""
+
+import struct
+
+MAGIC = b"SUZ"
+VERSION = 1
+METHOD_RLE = 1
+
+HEADER_FMT = "!3sBBBHLL"
+HEADER_SIZE = struct.calcsize(HEADER_FMT)
+
+BLOCK_COMPRESSED = 0x8000
+BLOCK_LENGTH_MASK = 0x7fff
+
+# CMNDLIB_SUOTA_IMAGE_BLOCK_MAX_SIZE of the node decoder
+BLOCK_SIZE_MAX = 256
+BLOCK_SIZE_DEFAULT = BLOCK_SIZE_MAX
+
+RLE_LITERAL_MAX = 0x80
+RLE_REPEAT_MIN = 3
+RLE_REPEAT_MAX = 0x7f + RLE_REPEAT_MIN
+
+
+class ImageError(Exception):
+    pass
+
+
+def checksum(data):
+    return sum(bytearray(data)) & 0xffffffff
+
+
+def rle_encode(data):
+    data = bytearray(data)
+    out = bytearray()
+    literal_start = 0
+    i = 0
+    n = len(data)
+
+    def flush_literal(end):
+        start = literal_start
+        while start < end:
+            count = min(end - start, RLE_LITERAL_MAX)
+            out.append(count - 1)
+            out.extend(data[start:start+count])
+            start += count
+
+    while i < n:
+        run = 1
+        while i + run < n and run < RLE_REPEAT_MAX and data[i + run] == data[i]:
+            run += 1
+
+        if run >= RLE_REPEAT_MIN:
+            flush_literal(i)
+            out.append(0x80 + run - RLE_REPEAT_MIN)
+            out.append(data[i])
+            i += run
+            literal_start = i
+        else:
+            i += run
+
+    flush_literal(n)
+    return bytes(out)
+
+
+def rle_decode(data):
+    data = bytearray(data)
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        control = data[i]
+        i += 1
+        if control & 0x80:
+            if i >= len(data):
+                raise ImageError("truncated run")
+            out.extend(data[i:i+1] * (control - 0x80 + RLE_REPEAT_MIN))
+            i += 1
+        else:
+            count = control + 1
+            if i + count > len(data):
+                raise ImageError("truncated run")
+            out.extend(data[i:i+count])
+            i += count
+    return bytes(out)
+
+
+def pack(image, block_size=BLOCK_SIZE_DEFAULT):
+    """Pack a raw firmware image into a SUOTA transport image."""
+    if not image:
+        raise ImageError("empty image")
+    if not 0 < block_size <= BLOCK_LENGTH_MASK:
+        raise ImageError("invalid block size")
+
+    buf = bytearray(struct.pack(HEADER_FMT, MAGIC, VERSION, METHOD_RLE, 0, block_size,
+                                len(image), checksum(image)))
+
+    for offset in range(0, len(image), block_size):
+        block = image[offset:offset+block_size]
+        encoded = rle_encode(block)
+        if len(encoded) < len(block):
+            buf += struct.pack("!H", BLOCK_COMPRESSED | len(encoded)) + encoded
+        else:
+            buf += struct.pack("!H", len(block)) + block
+
+    return bytes(buf)
+
+
+def unpack(buf):
+    """Unpack a SUOTA transport image, mirrors the node side decoder."""
+    if len(buf) < HEADER_SIZE:
+        raise ImageError("short header")
+
+    magic, version, method, _, block_size, size, expected = struct.unpack(HEADER_FMT, buf[:HEADER_SIZE])
+    if magic != MAGIC or version != VERSION or method != METHOD_RLE:
+        raise ImageError("unsupported header")
+
+    image = bytearray()
+    pos = HEADER_SIZE
+    while len(image) < size:
+        if pos + 2 > len(buf):
+            raise ImageError("truncated image")
+        (header,) = struct.unpack("!H", buf[pos:pos+2])
+        pos += 2
+
+        length = header & BLOCK_LENGTH_MASK
+        block = buf[pos:pos+length]
+        pos += length
+        if header & BLOCK_COMPRESSED:
+            block = rle_decode(block)
+
+        if len(block) != min(block_size, size - len(image)):
+            raise ImageError("bad block length at offset {:#x}".format(len(image)))
+        image += block
+
+    if checksum(image) != expected:
+        raise ImageError("checksum mismatch")
+
+    return bytes(image)
+
+
+def transfer_stats(size, chunk, rate, latency):
+    """Estimate reads and duration for transferring size bytes.
+
+    Args:
+        size: number of image bytes to transfer
+        chunk: bytes per SUOTA read file request
+        rate: effective link throughput in bytes per second
+        latency: round trip time per read request in seconds
+    """
+    reads = (size + chunk - 1) // chunk
+    duration = float(size) / rate + reads * latency
+    return reads, duration
@@ -0,0 +1,150 @@
+# SPDX-License-Identifier: MIT
+import collections
+import unittest
+import cmbs
+import cmnd
+import eeprom
+
+
+class FakeTarget(object):
+    """EEPROM answering requests in order, rejecting chunks larger than max_chunk,
+    requests at offsets in lost are not answered, the responses to offsets in
+    misplaced carry another offset."""
+    eeprom_chunk_size = 62
+
+    def __init__(self, size=1024, max_chunk=62):
+        self.memory = bytearray(range(256)) * (size // 256)
+        self.max_chunk = max_chunk
+        self.responses = collections.deque()
+        self.max_inflight = 0
+        self.requests = 0
+        self.lost = ()
+        self.misplaced = ()
+
+    def _queue(self, response):
+        self.requests += 1
+        self.responses.append(response)
+        self.max_inflight = max(self.max_inflight, len(self.responses))
+
+    def send_get_eeprom(self, offset, length):
+        if length > self.max_chunk:
+            self._queue((1, None))
+        else:
+            self._queue((0, bytes(self.memory[offset:offset + length])))
+
+    def wait_get_eeprom(self, offset, timeout):
+        # as the CMND and CMBS targets
+        if offset in self.lost:
+            raise cmnd.TimeoutError()
+        if offset in self.misplaced:
+            raise ValueError("offset {:#010x}, expected {:#010x}".format(offset + 1, offset))
+        return self.responses.popleft()
+
+    def send_set_eeprom(self, offset, data):
+        if len(data) > self.max_chunk:
+            self._queue(1)
+        else:
+            self.memory[offset:offset + len(data)] = data
+            self._queue(0)
+
+    def wait_set_eeprom(self, offset, timeout):
+        if offset in self.lost:
+            raise cmbs.TimeoutError()
+        return self.responses.popleft()
+
+
+class TestEeprom(unittest.TestCase):
+
+    def test_read(self):
+        target = FakeTarget()
+        done = []
+        stats = eeprom.Stats()
+        data = eeprom.read(target, 10, 500, window=4, progress=done.append, stats=stats)
+        self.assertEqual(data, bytes(target.memory[10:510]))
+        self.assertEqual(target.requests, 9)
+        self.assertEqual(target.max_inflight, 4)
+        self.assertEqual(sum(done), 500)
+        self.assertEqual((stats.bytes, stats.requests), (500, 9))
+
+    def test_write_verify(self):
+        target = FakeTarget()
+        data = bytes(bytearray(0x55 for _ in range(200)))
+        eeprom.write(target, 100, data)
+        eeprom.verify(target, 100, data)
+        self.assertEqual(target.memory[100:300], data)
+        self.assertEqual(target.memory[99], 99)
+
+        target.memory[250] ^= 0xff
+        with self.assertRaises(eeprom.VerifyError) as cm:
+            eeprom.verify(target, 100, data)
+        self.assertEqual(cm.exception.offset, 250)
+
+    def test_chunk_halving(self):
+        # target buffer smaller than expected: chunks are halved until accepted
+        target = FakeTarget(max_chunk=20)
+        self.assertEqual(eeprom.read(target, 0, 100), bytes(target.memory[:100]))
+
+        target = FakeTarget(max_chunk=0)
+        with self.assertRaises(eeprom.EepromError) as cm:
+            eeprom.write(target, 8, b"\x01\x02")
+        self.assertEqual(cm.exception.offset, 8)
+
+    def test_timeout(self):
+        target = FakeTarget()
+        target.lost = (124,)
+        with self.assertRaises(eeprom.EepromTimeout) as cm:
+            eeprom.read(target, 0, 500)
+        self.assertEqual(cm.exception.offset, 124)
+        with self.assertRaises(eeprom.EepromTimeout) as cm:
+            eeprom.write(target, 62, bytes(100))
+        self.assertEqual(cm.exception.offset, 124)
+
+    def test_unexpected_response(self):
+        target = FakeTarget()
+        target.misplaced = (62,)
+        with self.assertRaises(eeprom.UnexpectedResponse) as cm:
+            eeprom.read(target, 0, 500)
+        self.assertEqual(cm.exception.offset, 62)
+        self.assertIn("expected 0x0000003e", str(cm.exception))
+
+
+class TestImage(unittest.TestCase):
+
+    def test_pack_unpack(self):
+        image = eeprom.Image(eeprom.TARGET_CMND, 0x100, b"\x01\x02\x03", "unit 42", created=1700000000)
+        buf = image.pack()
+        self.assertEqual(len(buf), eeprom.HEADER_SIZE + 3)
+        copy = eeprom.Image.unpack(buf)
+        self.assertEqual((copy.target_type, copy.offset, copy.data, copy.label, copy.created),
+                         (eeprom.TARGET_CMND, 0x100, b"\x01\x02\x03", "unit 42", 1700000000))
+
+        for bad in (buf[:-1], b"XXXX" + buf[4:], buf[:-1] + b"\x00"):
+            with self.assertRaises(eeprom.ImageError):
+                eeprom.Image.unpack(bad)
+
+    def test_diff_runs(self):
+        old = bytes(bytearray(40))
+        new = bytearray(40)
+        new[1] = new[5] = new[30] = 1
+        self.assertEqual(eeprom.diff_runs(old, bytes(new)), [(1, 6), (30, 31)])
+        self.assertEqual(eeprom.diff_runs(old, bytes(new), gap=2), [(1, 2), (5, 6), (30, 31)])
+        self.assertEqual(eeprom.diff_runs(old, old), [])
+
+    def test_update(self):
+        target = FakeTarget()
+        image = eeprom.Image(eeprom.TARGET_CMBS, 0, eeprom.read(target, 0, 1024))
+        target.memory[500] = 0
+        target.memory[900:904] = b"\x00" * 4
+
+        self.assertEqual(eeprom.update(target, image, dry_run=True), [(500, 501), (900, 904)])
+        self.assertEqual(target.memory[500], 0)
+
+        requests = target.requests
+        self.assertEqual(eeprom.update(target, image), [(500, 501), (900, 904)])
+        self.assertEqual(bytes(target.memory), image.data)
+        # 17 chunk reads, then one write and one read back per run
+        self.assertEqual(target.requests - requests, 17 + 4)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,63 @@
+# SPDX-License-Identifier: MIT
+import unittest
+import cmnd
+import framing
+
+
+class FakeSerial(object):
+    """Delivers the given chunks one per read, like a port with in_waiting."""
+
+    def __init__(self, *chunks):
+        self.chunks = list(chunks)
+        self.reads = 0
+
+    @property
+    def in_waiting(self):
+        return len(self.chunks[0]) if self.chunks else 0
+
+    def read(self, size=1):
+        self.reads += 1
+        if not self.chunks:
+            return b''
+        data, self.chunks[0] = self.chunks[0][:size], self.chunks[0][size:]
+        if not self.chunks[0]:
+            self.chunks.pop(0)
+        return data
+
+
+def hello():
+    return cmnd.Message(0, cmnd.SERVICE_ID_GENERAL, cmnd.MSG_GENERAL_HELLO_IND).pack()
+
+
+class TestFrameReader(unittest.TestCase):
+
+    def test_frames_in_one_read(self):
+        status = cmnd.Message(0, cmnd.SERVICE_ID_PRODUCTION, cmnd.MSG_PROD_CFM, cmnd.IEResponse(0)).pack()
+        ser = FakeSerial(b'\x00\xda\x01' + hello() + status + hello()[:5])
+        msg = cmnd.receive(ser, timeout=1)
+        self.assertEqual((msg.service, msg.id), (cmnd.SERVICE_ID_GENERAL, cmnd.MSG_GENERAL_HELLO_IND))
+        msg = cmnd.receive(ser, timeout=1)
+        self.assertEqual(msg.get_ie(cmnd.IEResponse).result, 0)
+        self.assertEqual(ser.reads, 1)
+        # the partial frame is kept
+        self.assertEqual(bytes(framing.reader(ser, b'\xda\xda', 4, cmnd._frame_size).buf), hello()[:5])
+
+    def test_split_sync(self):
+        frame = hello()
+        ser = FakeSerial(b'\x11\x22\xda', frame[1:3], frame[3:])
+        self.assertEqual(cmnd.receive(ser, timeout=1).id, cmnd.MSG_GENERAL_HELLO_IND)
+
+    def test_timeout(self):
+        ser = FakeSerial(hello()[:6])
+        with self.assertRaises(cmnd.TimeoutError):
+            cmnd.receive(ser, timeout=0.01)
+
+    def test_wait_timeout(self):
+        # other messages do not extend the timeout
+        ser = FakeSerial(*[hello()] * 1000)
+        with self.assertRaises(cmnd.TimeoutError):
+            cmnd.wait(ser, cmnd.SERVICE_ID_PRODUCTION, cmnd.MSG_PROD_CFM, timeout=0.01)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -1,6 +1,20 @@
 # SPDX-License-Identifier: MIT
+import os
+import tempfile
 import unittest
+from unittest import mock
+from click.testing import CliRunner
 import fwtool
+from test_eeprom import FakeTarget
+
+
+class FakeCMND(FakeTarget):
+
+    def is_cmnd(self):
+        return True
+
+    def production_mode(self):
+        return fwtool.CMBS.ProductionModeContext(self)
 
 class TestFwtool(unittest.TestCase):
 
@@ -28,5 +42,28 @@ class TestFwtool(unittest.TestCase):
         s = fwtool.format_bytes(b"\x00"*16 + b"\x01\x02\x03\x04")
         self.assertEqual(s, "00 "*15 + "00\n" + "01 02 03 04")
 
+    def test_suota_block_size(self):
+        result = CliRunner().invoke(fwtool.cli, ["suota", "--block-size", "257", "fwtool.py"], obj={})
+        self.assertEqual(result.exit_code, 2)
+        self.assertIn("--block-size", result.output)
+
+    def test_eeprom_image(self):
+        target = FakeCMND()
+        runner = CliRunner()
+        with mock.patch.object(fwtool, "connect_target", lambda ctx: target), tempfile.TemporaryDirectory() as tmp:
+            image = os.path.join(tmp, "unit.bin")
+            result = runner.invoke(fwtool.cli, ["eeprom", "dump", "0+1024", image], obj={})
+            self.assertEqual(result.exit_code, 0, result.output)
+
+            target.memory[10] ^= 0xff
+            result = runner.invoke(fwtool.cli, ["eeprom", "diff", image], obj={})
+            self.assertEqual(result.exit_code, 0, result.output)
+            self.assertIn("0x0000000a+1", result.output)
+            self.assertEqual(target.memory[10], 10)
+
+            # the range command is still reached without a subcommand
+            result = runner.invoke(fwtool.cli, ["eeprom", "--window", "1", "8+2"], obj={})
+            self.assertEqual(result.output, "08 09\n")
+
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,42 @@
+# SPDX-License-Identifier: MIT
+import unittest
+import struct
+import suota
+
+
+class TestSuota(unittest.TestCase):
+
+    def test_rle(self):
+        data = b"\x01\x02" + b"\xff" * 200 + b"\x03\x03\x04"
+        encoded = suota.rle_encode(data)
+        self.assertLess(len(encoded), len(data))
+        self.assertEqual(suota.rle_decode(encoded), data)
+
+        self.assertEqual(suota.rle_encode(b"\x00\x00\x00"), b"\x80\x00")
+        self.assertEqual(suota.rle_encode(b"\x01\x02"), b"\x01\x01\x02")
+
+    def test_pack(self):
+        image = bytes(bytearray(range(256))) * 3 + b"\xff" * 1000 + b"\x42"
+        packed = suota.pack(image)
+        self.assertEqual(packed[:3], b"SUZ")
+        self.assertLess(len(packed), len(image))
+        self.assertEqual(suota.unpack(packed), image)
+
+        # incompressible blocks are stored as is
+        (header,) = struct.unpack("!H", packed[suota.HEADER_SIZE:suota.HEADER_SIZE+2])
+        self.assertEqual(header, 256)
+
+    def test_unpack_checksum(self):
+        packed = bytearray(suota.pack(b"\x01\x02\x03\x04"))
+        packed[-1] ^= 0xff
+        with self.assertRaises(suota.ImageError):
+            suota.unpack(bytes(packed))
+
+    def test_transfer_stats(self):
+        reads, duration = suota.transfer_stats(1000, 128, 1000, 0.1)
+        self.assertEqual(reads, 8)
+        self.assertAlmostEqual(duration, 1.8)
+
+
+if __name__ == '__main__':
+    unittest.main()
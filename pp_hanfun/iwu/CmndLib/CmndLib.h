@@ -14,16 +14,20 @@
 #include "CmndApiExported.h"
 #include "CmndPacketCreator.h"
 #include "CmndPacketDetector.h"
+#include "CmndPacketTemplate.h"
+#include "CmndTransaction.h"
 #include "FunProfiles.h"
 #include "IeList.h"
 #include "CmndMsg.h"
 #include "CmndMsgLog.h"
+#include "CmndMsgPool.h"
 #include "CmndLib_UserImpl.h"
 #include "FunProprietary.h"
 #include "CmndApiIe.h"
 #include "CmndPresetDefs.h"
 #include "CmndLib_UserImpl.h"
 #include "CmndPresetUtils.h"
+#include "CmndSuotaImage.h"
 #include "Logger.h"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -13,6 +13,11 @@ enum
     CMNDLIB_SUBSCRIBERS_CAPACITY            = 5,    //!< Maximum subscribers available with p_CmndTransport_Subscribe
     CMNDLIB_DATA_PAYLOAD_MAX_LENGTH         = 167,  //!< Maximum size of CMND data payload
     CMNDLIB_API_PACKET_MAX_SIZE             = 250,  //!< Maximum size of CMND API message
+    CMNDLIB_MSG_POOL_CAPACITY               = 4,    //!< Number of t_st_hanCmndApiMsg in message pool
+    CMNDLIB_PACKET_POOL_CAPACITY            = 4,    //!< Number of t_st_Packet in packet pool
+    CMNDLIB_TRANSACTION_MAX_REQUESTS        = 24,   //!< Maximum requests in one transaction of CmndTransaction
+    CMNDLIB_TRANSACTION_RESPONSE_MAX_LENGTH = 32,   //!< Payload bytes kept per response of CmndTransaction
+    CMNDLIB_SUOTA_IMAGE_BLOCK_MAX_SIZE      = 256,  //!< Maximum decoded block size of compressed SUOTA transport image
     CMNDLIB_LOG_LEVEL                       = (LOG_LEVEL_ALL & ~LOG_LEVEL_TRACE), //!< A bit mask of enabled log levels. See t_en_hanLogLevel.
     //CMNDLIB_LOG_LEVEL    = LOG_LEVEL_NOTSET, //!< Logs disabled
 };
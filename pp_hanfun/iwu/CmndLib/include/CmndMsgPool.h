@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2016-2018 DSP Group, Inc.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef _CMND_MSG_POOL_H
+#define _CMND_MSG_POOL_H
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TypeDefs.h"
+#include "CmndApiExported.h"
+#include "CmndApiPacket.h"
+
+extern_c_begin
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Fixed capacity pools of CMND API messages and packets
+///
+/// @details    Entries are handed out by pointer with a reference count of 1.
+///             Every stage keeping an entry (dispatch, log, forward) calls Retain
+///             and Release when done, the entry returns to the pool on last Release.
+///             Entries are not zeroed on allocation, the parser and the creators
+///             fill all used fields.
+///
+/// @note       The pools are not protected against concurrent access.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+/// Pool occupancy
+///////////////////////////////////////////////////////////////////////////////
+typedef struct
+{
+    u8  u8_Capacity;            //!< Number of entries in pool
+    u8  u8_Used;                //!< Number of entries currently allocated
+    u8  u8_HighWater;           //!< Maximal number of entries allocated at the same time
+    u16 u16_AllocFailures;      //!< Number of allocations failed because the pool was empty
+}
+t_st_CmndMsgPoolStats;
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Allocate a message from the message pool
+///
+/// @return     pointer to message or NULL if pool is empty
+///////////////////////////////////////////////////////////////////////////////
+t_st_hanCmndApiMsg* p_CmndMsgPool_AllocMsg( void );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Add a reference to a pool message
+///
+/// @param[in]  pst_Msg     - message allocated with p_CmndMsgPool_AllocMsg
+///
+/// @return     true when success
+///////////////////////////////////////////////////////////////////////////////
+bool p_CmndMsgPool_RetainMsg( t_st_hanCmndApiMsg* pst_Msg );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Drop a reference to a pool message, the last one frees it
+///
+/// @param[in]  pst_Msg     - message allocated with p_CmndMsgPool_AllocMsg
+///
+/// @return     None
+///////////////////////////////////////////////////////////////////////////////
+void p_CmndMsgPool_ReleaseMsg( t_st_hanCmndApiMsg* pst_Msg );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Allocate a packet from the packet pool
+///
+/// @return     pointer to packet or NULL if pool is empty
+///////////////////////////////////////////////////////////////////////////////
+t_st_Packet* p_CmndMsgPool_AllocPacket( void );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Add a reference to a pool packet
+///
+/// @param[in]  pst_Packet  - packet allocated with p_CmndMsgPool_AllocPacket
+///
+/// @return     true when success
+///////////////////////////////////////////////////////////////////////////////
+bool p_CmndMsgPool_RetainPacket( t_st_Packet* pst_Packet );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Drop a reference to a pool packet, the last one frees it
+///
+/// @param[in]  pst_Packet  - packet allocated with p_CmndMsgPool_AllocPacket
+///
+/// @return     None
+///////////////////////////////////////////////////////////////////////////////
+void p_CmndMsgPool_ReleasePacket( t_st_Packet* pst_Packet );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Get occupancy of message pool
+///
+/// @param[out] pst_Stats   - pool occupancy
+///
+/// @return     None
+///////////////////////////////////////////////////////////////////////////////
+void p_CmndMsgPool_GetMsgStats( OUT t_st_CmndMsgPoolStats* pst_Stats );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Get occupancy of packet pool
+///
+/// @param[out] pst_Stats   - pool occupancy
+///
+/// @return     None
+///////////////////////////////////////////////////////////////////////////////
+void p_CmndMsgPool_GetPacketStats( OUT t_st_CmndMsgPoolStats* pst_Stats );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Reset high water marks and failure counters of both pools
+///////////////////////////////////////////////////////////////////////////////
+void p_CmndMsgPool_ResetStats( void );
+
+extern_c_end
+
+#endif  //_CMND_MSG_POOL_H
@@ -16,6 +16,16 @@
 
 extern_c_begin
 
+///////////////////////////////////////////////////////////////////////////////
+/// Initialisation of the message structure by the parser
+///////////////////////////////////////////////////////////////////////////////
+typedef enum
+{
+    CMND_PACKET_PARSER_MODE_CLEAR,      //!< Zero the whole structure, including unused payload
+    CMND_PACKET_PARSER_MODE_USED_ONLY,  //!< Set header fields and the used payload prefix only
+}
+t_en_CmndPacketParserMode;
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Parse CMND API packet buffer
 ///
@@ -36,6 +46,25 @@ bool p_CmndPacketParser_ParseCmndPacket(    u16                     u16_BufferLe
                                             const u8*               pu8_Buffer,
                                             OUT t_st_hanCmndApiMsg* pst_cmndApiMsg);
 
+///////////////////////////////////////////////////////////////////////////////
+/// Parse CMND API packet buffer with selected initialisation
+///
+/// @details    In CMND_PACKET_PARSER_MODE_USED_ONLY payload bytes beyond
+///             dataLength are left untouched, which saves clearing the whole
+///             payload array per message. Readers must honour dataLength.
+///
+/// @param[in]  u16_BufferLength    - CMND API packet buffer length
+/// @param[in]  pu8_Buffer          - pointer to CMND API packet buffer
+/// @param[in]  en_Mode             - initialisation of pst_cmndApiMsg
+/// @param[out] pst_cmndApiMsg      - pointer to t_st_hanCmndApiMsg structure
+///
+/// @return     true if ok
+///////////////////////////////////////////////////////////////////////////////
+bool p_CmndPacketParser_ParseCmndPacketMode(    u16                         u16_BufferLength,
+                                                const u8*                   pu8_Buffer,
+                                                t_en_CmndPacketParserMode   en_Mode,
+                                                OUT t_st_hanCmndApiMsg*     pst_cmndApiMsg);
+
 extern_c_end
 
 #endif  //_CMND_PACKET_PARSER_H
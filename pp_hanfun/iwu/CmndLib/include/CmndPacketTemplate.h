@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2016-2018 DSP Group, Inc.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef _CMND_PACKET_TEMPLATE_H
+#define _CMND_PACKET_TEMPLATE_H
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TypeDefs.h"
+#include "CmndApiPacket.h"
+
+extern_c_begin
+
+///////////////////////////////////////////////////////////////////////////////
+/// Frequently sent packets which differ only in unit id and cookie
+///////////////////////////////////////////////////////////////////////////////
+typedef enum
+{
+    CMND_PACKET_TEMPLATE_KEEP_ALIVE_IAMALIVE_REQ,   //!< p_KeepAlive_IamAliveReq
+    CMND_PACKET_TEMPLATE_GENERAL_HELLO_REQ,         //!< p_General_HelloReq
+    CMND_PACKET_TEMPLATE_GENERAL_GET_STATUS_REQ,    //!< p_General_GetStatusReq
+    CMND_PACKET_TEMPLATE_ON_OFF_ON_REQ,             //!< p_OnOff_OnReq
+    CMND_PACKET_TEMPLATE_ON_OFF_OFF_REQ,            //!< p_OnOff_OffReq
+    CMND_PACKET_TEMPLATE_ON_OFF_TOGGLE_REQ,         //!< p_OnOff_ToggleReq
+    CMND_PACKET_TEMPLATE_SYSTEM_GET_RSSI_REQ,       //!< p_System_GetRssi
+    CMND_PACKET_TEMPLATE_LAST,
+}
+t_en_CmndPacketTemplateId;
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Create a packet from the template cache
+///
+/// @details    The packet is serialized once on first use. Afterwards the cached
+///             bytes are copied and only unit id, cookie and checksum are patched.
+///
+/// @param[out] packet          - packet to fill
+/// @param[in]  en_TemplateId   - template to use
+/// @param[in]  u8_UnitId       - unit id of packet
+/// @param[in]  u8_Cookie       - cookie of packet
+///
+/// @return     true when success
+///////////////////////////////////////////////////////////////////////////////
+bool p_CmndPacketTemplate_Get(  OUT t_st_Packet*                packet,
+                                    t_en_CmndPacketTemplateId   en_TemplateId,
+                                    u8                          u8_UnitId,
+                                    u8                          u8_Cookie );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Patch unit id and cookie of a serialized packet
+///
+/// @details    The checksum is updated from the difference of the patched bytes,
+///             the rest of the packet is not read again. Use it to resend a packet
+///             kept by the application.
+///
+/// @param[in,out]  packet      - serialized packet (including 0xDADA and length)
+/// @param[in]      u8_UnitId   - new unit id
+/// @param[in]      u8_Cookie   - new cookie
+///
+/// @return     None
+///////////////////////////////////////////////////////////////////////////////
+void p_CmndPacketTemplate_Patch( INOUT t_st_Packet* packet, u8 u8_UnitId, u8 u8_Cookie );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Drop all cached templates, they are serialized again on next use
+///////////////////////////////////////////////////////////////////////////////
+void p_CmndPacketTemplate_Reset( void );
+
+extern_c_end
+
+#endif  //_CMND_PACKET_TEMPLATE_H
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2016-2018 DSP Group, Inc.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef _CMND_SUOTA_IMAGE_H
+#define _CMND_SUOTA_IMAGE_H
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TypeDefs.h"
+#include "CmndLib_Config.h"
+
+extern_c_begin
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+/// SUOTA transport image format (all fields in network order)
+///
+///     Header:
+///         3 bytes magic "SUZ"
+///         1 byte  version
+///         1 byte  method (CMND_SUOTA_IMAGE_METHOD_RLE)
+///         1 byte  reserved
+///         2 bytes decoded block size
+///         4 bytes decoded image size
+///         4 bytes decoded image checksum (32bit byte summation)
+///
+///     Blocks, each one decodes to <block size> bytes (the last one may be shorter):
+///         2 bytes block header: bit 15 set if block is compressed, bits 0..14 encoded length
+///         n bytes block data, stored as is or RLE compressed
+///
+///     RLE control byte:
+///         0x00..0x7F  - copy next (n + 1) bytes as they are
+///         0x80..0xFF  - repeat next byte (n - 0x80 + 3) times
+///
+/// The image is produced on the host side (see fwtool 'suota' command) and
+/// placed on the SUOTA server instead of the raw image.
+///////////////////////////////////////////////////////////////////////////////
+enum
+{
+    CMND_SUOTA_IMAGE_HEADER_SIZE        = 16,       //!< Size of transport image header
+    CMND_SUOTA_IMAGE_VERSION            = 1,        //!< Supported transport image version
+    CMND_SUOTA_IMAGE_METHOD_RLE         = 1,        //!< Block level run length encoding
+    CMND_SUOTA_IMAGE_BLOCK_COMPRESSED   = 0x8000,   //!< Block header flag of compressed block
+    CMND_SUOTA_IMAGE_BLOCK_LENGTH_MASK  = 0x7FFF,   //!< Block header mask of encoded length
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// Result of SUOTA transport image decoding
+///////////////////////////////////////////////////////////////////////////////
+typedef enum
+{
+    E_SUOTA_IMAGE_ONGOING       = 0,    //!< More input needed
+    E_SUOTA_IMAGE_BLOCK_READY   = 1,    //!< A decoded block is available
+    E_SUOTA_IMAGE_DONE          = 2,    //!< Last decoded block is available and the image checksum matched
+    E_SUOTA_IMAGE_ERROR         = 3,    //!< Malformed image, decoder has to be initialized again
+}
+t_en_CmndSuotaImage_DecodeCode;
+
+///////////////////////////////////////////////////////////////////////////////
+/// State of SUOTA transport image decoder
+///////////////////////////////////////////////////////////////////////////////
+typedef enum
+{
+    SUOTA_IMAGE_ST_HEADER,          // Accumulating image header
+    SUOTA_IMAGE_ST_BLOCK_LENGTH1,   // Waiting for first byte of block header
+    SUOTA_IMAGE_ST_BLOCK_LENGTH2,   // Waiting for second byte of block header
+    SUOTA_IMAGE_ST_STORED,          // Copying stored block data
+    SUOTA_IMAGE_ST_RLE_CONTROL,     // Waiting for RLE control byte
+    SUOTA_IMAGE_ST_RLE_LITERAL,     // Copying RLE literal run
+    SUOTA_IMAGE_ST_RLE_REPEAT,      // Waiting for RLE repeated byte
+    SUOTA_IMAGE_ST_ERROR,           // Malformed image
+}
+t_en_CmndSuotaImage_State;
+
+typedef struct
+{
+    t_en_CmndSuotaImage_State   state;
+
+    u8      header[CMND_SUOTA_IMAGE_HEADER_SIZE];
+    u16     u16_HeaderIndex;
+
+    u16     u16_BlockSize;              //!< Decoded size of a block
+    u32     u32_ImageSize;              //!< Decoded size of the image
+    u32     u32_ImageChecksum;          //!< Expected checksum of the decoded image
+
+    u16     u16_EncodedRemaining;       //!< Bytes of current block still to be consumed
+    u8      u8_RunRemaining;            //!< Bytes of current literal run still to be copied
+    u8      u8_RepeatCount;             //!< Length of current repeat run
+
+    u8      block[CMNDLIB_SUOTA_IMAGE_BLOCK_MAX_SIZE];
+    u16     u16_BlockLength;            //!< Length of decoded data in block
+    u16     u16_BlockExpected;          //!< Decoded length expected for current block
+
+    u32     u32_DecodedSize;            //!< Total decoded bytes of complete blocks
+    u32     u32_Checksum;               //!< Checksum of decoded bytes of complete blocks
+}
+t_st_CmndSuotaImageDecoder;
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Check whether a buffer starts with a SUOTA transport image header
+///
+/// @param[in]  pu8_Buffer      - pointer to first bytes of the image
+/// @param[in]  u16_Length      - buffer length
+///
+/// @return     true if buffer holds a supported transport image header
+///////////////////////////////////////////////////////////////////////////////
+bool p_CmndSuotaImage_IsTransportImage( const u8* pu8_Buffer, u16 u16_Length );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Initialize SUOTA transport image decoder
+///
+/// @param[out] pst_Decoder     - decoder context
+///
+/// @return     None
+///////////////////////////////////////////////////////////////////////////////
+void p_CmndSuotaImage_DecoderInit( OUT t_st_CmndSuotaImageDecoder* pst_Decoder );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Decode one byte of a SUOTA transport image
+///
+/// @param[in,out]  pst_Decoder     - decoder context
+/// @param[in]      u8_Byte         - next image byte, as read with SUOTA read file request
+///
+/// @return     t_en_CmndSuotaImage_DecodeCode
+///////////////////////////////////////////////////////////////////////////////
+t_en_CmndSuotaImage_DecodeCode p_CmndSuotaImage_DecodeAppendByte( INOUT t_st_CmndSuotaImageDecoder* pst_Decoder, u8 u8_Byte );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Decode a chunk of a SUOTA transport image
+///
+/// @details    Decoding stops as soon as a block is ready. Fetch it with
+///             p_CmndSuotaImage_GetBlock and call again to continue from <pu16_InputBufIndex>.
+///
+/// @param[in,out]  pst_Decoder         - decoder context
+/// @param[in]      pu8_InputBuf        - pointer to image chunk
+/// @param[in]      u16_InputBufLen     - image chunk length
+/// @param[in,out]  pu16_InputBufIndex  - IN - start position, OUT - new position
+///
+/// @return     t_en_CmndSuotaImage_DecodeCode
+///////////////////////////////////////////////////////////////////////////////
+t_en_CmndSuotaImage_DecodeCode p_CmndSuotaImage_Decode( INOUT   t_st_CmndSuotaImageDecoder* pst_Decoder,
+                                                        const   u8*                         pu8_InputBuf,
+                                                                u16                         u16_InputBufLen,
+                                                        INOUT   u16*                        pu16_InputBufIndex );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Get the last decoded block
+///
+/// @param[in]  pst_Decoder         - decoder context
+/// @param[out] pu32_Offset         - offset of the block in the decoded image
+/// @param[out] pu16_Length         - block length
+///
+/// @return     pointer to decoded block data
+///////////////////////////////////////////////////////////////////////////////
+const u8* p_CmndSuotaImage_GetBlock( const t_st_CmndSuotaImageDecoder* pst_Decoder, OUT u32* pu32_Offset, OUT u16* pu16_Length );
+
+extern_c_end
+
+#endif  //_CMND_SUOTA_IMAGE_H
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2016-2018 DSP Group, Inc.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef _CMND_TRANSACTION_H
+#define _CMND_TRANSACTION_H
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TypeDefs.h"
+#include "CmndApiExported.h"
+#include "CmndApiPacket.h"
+#include "CmndLib_Config.h"
+
+extern_c_begin
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Batch of requests to CMND wrapped in a transaction
+///
+/// @details    The requests are serialized back to back between
+///             TRANSACTION_START_REQ and TRANSACTION_END_REQ into a buffer
+///             owned by the application, which sends it in one go without
+///             waiting for the responses in between. Each packet gets its own
+///             cookie (consecutive from u8_FirstCookie), the responses are
+///             matched by cookie and collected until TRANSACTION_START_CFM,
+///             TRANSACTION_END_CFM and the responses of all requests which
+///             expect one have been received.
+///
+///             Typical use:
+///                 p_CmndTransaction_Init( &tr, buffer, sizeof(buffer), cookie );
+///                 p_Parameters_SetReq( &packet, ... );
+///                 p_CmndTransaction_Add( &tr, &packet, true );
+///                 ...
+///                 p_CmndTransaction_Close( &tr );
+///                 send tr.pu8_Buffer / tr.u16_Length
+///                 p_CmndTransaction_HandleMsg( &tr, &msg ) for every received message
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+/// Result of p_CmndTransaction_HandleMsg
+///////////////////////////////////////////////////////////////////////////////
+typedef enum
+{
+    E_CMND_TRANSACTION_IGNORED  = 0,    //!< Message does not belong to transaction
+    E_CMND_TRANSACTION_ONGOING  = 1,    //!< Message consumed, more responses expected
+    E_CMND_TRANSACTION_DONE     = 2,    //!< All expected responses, TRANSACTION_START_CFM and TRANSACTION_END_CFM received
+}
+t_en_CmndTransactionCode;
+
+///////////////////////////////////////////////////////////////////////////////
+/// Response of one request in transaction
+///////////////////////////////////////////////////////////////////////////////
+typedef struct
+{
+    u16     u16_ServiceId;          //!< Service id of response
+    u8      u8_MessageId;           //!< Message id of response
+    u8      u8_Result;              //!< Result of CMND_IE_RESPONSE (t_en_hanCmndRc), valid if b_HasResult
+    bool    b_HasResult;            //!< Response contains CMND_IE_RESPONSE
+    bool    b_Expected;             //!< Request expects a response
+    bool    b_Received;             //!< Response received
+    bool    b_Truncated;            //!< Payload longer than CMNDLIB_TRANSACTION_RESPONSE_MAX_LENGTH
+    u16     u16_DataLength;         //!< Used length of au8_Data
+    u8      au8_Data[CMNDLIB_TRANSACTION_RESPONSE_MAX_LENGTH]; //!< Payload (IEs) of response
+}
+t_st_CmndTransactionResponse;
+
+///////////////////////////////////////////////////////////////////////////////
+/// Transaction context
+///////////////////////////////////////////////////////////////////////////////
+typedef struct
+{
+    u8*                             pu8_Buffer;         //!< Serialized packets to send
+    u16                             u16_BufferSize;     //!< Size of pu8_Buffer
+    u16                             u16_Length;         //!< Used length of pu8_Buffer
+    u8                              u8_FirstCookie;     //!< Cookie of TRANSACTION_START_REQ
+    u8                              u8_Count;           //!< Number of requests
+    u8                              u8_Pending;         //!< Number of requests expecting a response which has not arrived
+    bool                            b_Closed;           //!< TRANSACTION_END_REQ added
+    bool                            b_Started;          //!< TRANSACTION_START_CFM received
+    bool                            b_Ended;            //!< TRANSACTION_END_CFM received
+    t_st_CmndTransactionResponse    ast_Responses[CMNDLIB_TRANSACTION_MAX_REQUESTS];
+}
+t_st_CmndTransaction;
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Start a transaction and serialize TRANSACTION_START_REQ
+///
+/// @param[out] pst_Transaction - transaction context
+/// @param[in]  pu8_Buffer      - buffer for serialized packets
+/// @param[in]  u16_BufferSize  - size of pu8_Buffer
+/// @param[in]  u8_FirstCookie  - cookie of first packet, the following packets
+///                               use the next cookies
+///
+/// @return     true when success
+///////////////////////////////////////////////////////////////////////////////
+bool p_CmndTransaction_Init(    OUT t_st_CmndTransaction*   pst_Transaction,
+                                    u8*                     pu8_Buffer,
+                                    u16                     u16_BufferSize,
+                                    u8                      u8_FirstCookie );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Append a request to the transaction
+///
+/// @details    The cookie of the packet is replaced by the transaction cookie
+///             before it is copied.
+///
+/// @param[in,out]  pst_Transaction     - transaction context
+/// @param[in,out]  packet              - serialized request (from CmndPacketCreator)
+/// @param[in]      b_ExpectResponse    - the target answers the request (e.g. a _REQ
+///                                       with a matching _RES), the transaction is
+///                                       not done before the response arrived
+///
+/// @return     true when success, false if the transaction or buffer is full
+///////////////////////////////////////////////////////////////////////////////
+bool p_CmndTransaction_Add( INOUT t_st_CmndTransaction* pst_Transaction, INOUT t_st_Packet* packet, bool b_ExpectResponse );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Serialize TRANSACTION_END_REQ, the buffer is ready to send
+///
+/// @param[in,out]  pst_Transaction - transaction context
+///
+/// @return     true when success
+///////////////////////////////////////////////////////////////////////////////
+bool p_CmndTransaction_Close( INOUT t_st_CmndTransaction* pst_Transaction );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Collect a received message
+///
+/// @param[in,out]  pst_Transaction - transaction context
+/// @param[in]      pst_Msg         - received message
+///
+/// @return     t_en_CmndTransactionCode
+///////////////////////////////////////////////////////////////////////////////
+t_en_CmndTransactionCode p_CmndTransaction_HandleMsg(   INOUT t_st_CmndTransaction*     pst_Transaction,
+                                                        const t_st_hanCmndApiMsg*       pst_Msg );
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief      Get response of a request
+///
+/// @param[in]  pst_Transaction - transaction context
+/// @param[in]  u8_Index        - index of request in order of p_CmndTransaction_Add
+///
+/// @return     response or NULL if index is out of range
+///////////////////////////////////////////////////////////////////////////////
+const t_st_CmndTransactionResponse* p_CmndTransaction_GetResponse(  const t_st_CmndTransaction* pst_Transaction,
+                                                                    u8                          u8_Index );
+
+extern_c_end
+
+#endif  //_CMND_TRANSACTION_H
@@ -81,10 +81,13 @@ void p_CmndMsgLog_PrintTxMsg( const t_st_hanCmndApiMsg* pst_Msg )
 
 void p_CmndMsgLog_PrintTxBuffer( u16 u16_BufferLen, const u8* u8_Buffer )
 {
-    t_st_hanCmndApiMsg st_Msg = {0};
+    t_st_hanCmndApiMsg st_Msg;
     bool ok;
 
-    ok = p_CmndPacketParser_ParseCmndPacket( u16_BufferLen-4, &u8_Buffer[4], &st_Msg );
+    ok = p_CmndPacketParser_ParseCmndPacketMode(    u16_BufferLen-4,
+                                                    &u8_Buffer[4],
+                                                    CMND_PACKET_PARSER_MODE_USED_ONLY,
+                                                    &st_Msg );
 
     if ( ok )
     {
@@ -353,17 +356,33 @@ void p_CmndMsgLog_ParseMsgIEs(  const t_st_hanCmndApiMsg* pst_cmndApiMsg,
         {
             i += 1;
 
-            memcpy( &ieLen,& ( pst_cmndApiMsg->data[i] ),sizeof ( ieLen ) );
-
-            ieLen = p_Endian_net2hos16( ieLen );
+            // the bytes after dataLength are not cleared, the length and the body must be within it
+            if ( i + sizeof( ieLen ) > pst_cmndApiMsg->dataLength )
+            {
+                i = pst_cmndApiMsg->dataLength;
+                p_CmndLib_UserImpl_snprintf( ac_IeContent, sizeof(ac_IeContent), "Truncated IE length" );
+            }
+            else
+            {
+                memcpy( &ieLen,& ( pst_cmndApiMsg->data[i] ),sizeof ( ieLen ) );
 
-            if ( ieLen > MAX_IE_LENGTH )
-                break;
+                ieLen = p_Endian_net2hos16( ieLen );
 
+                if ( ieLen > MAX_IE_LENGTH )
+                    break;
 
-            p_CmndMsgLog_IeValueToString( u8_IeType, &st_IeList, ac_IeContent, sizeof( ac_IeContent ) );
+                if ( ieLen > pst_cmndApiMsg->dataLength - i - sizeof( ieLen ) )
+                {
+                    i = pst_cmndApiMsg->dataLength;
+                    p_CmndLib_UserImpl_snprintf( ac_IeContent, sizeof(ac_IeContent), "Truncated IE: %u bytes", ieLen );
+                }
+                else
+                {
+                    p_CmndMsgLog_IeValueToString( u8_IeType, &st_IeList, ac_IeContent, sizeof( ac_IeContent ) );
 
-            i += sizeof( ieLen ) + ieLen;
+                    i += sizeof( ieLen ) + ieLen;
+                }
+            }
         }
         else
         {
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2016-2018 DSP Group, Inc.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "CmndMsgPool.h"
+#include "Logger.h"
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+/// Bookkeeping of one pool, entries are stored separately to keep their natural type
+typedef struct
+{
+    u8*                     pu8_RefCount;       //!< Reference count per entry, 0 if free
+    t_st_CmndMsgPoolStats   st_Stats;
+}
+t_st_CmndMsgPool;
+
+static t_st_hanCmndApiMsg   g_Msgs[CMNDLIB_MSG_POOL_CAPACITY];
+static u8                   g_MsgRefCount[CMNDLIB_MSG_POOL_CAPACITY];
+static t_st_CmndMsgPool     g_MsgPool = { g_MsgRefCount, { CMNDLIB_MSG_POOL_CAPACITY, 0, 0, 0 } };
+
+static t_st_Packet          g_Packets[CMNDLIB_PACKET_POOL_CAPACITY];
+static u8                   g_PacketRefCount[CMNDLIB_PACKET_POOL_CAPACITY];
+static t_st_CmndMsgPool     g_PacketPool = { g_PacketRefCount, { CMNDLIB_PACKET_POOL_CAPACITY, 0, 0, 0 } };
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Find a free entry and take it, returns entry index or -1
+static i16 p_CmndMsgPool_Alloc( INOUT t_st_CmndMsgPool* pst_Pool );
+
+// Add reference to entry
+static bool p_CmndMsgPool_Retain( INOUT t_st_CmndMsgPool* pst_Pool, i16 index );
+
+// Drop reference to entry
+static void p_CmndMsgPool_Release( INOUT t_st_CmndMsgPool* pst_Pool, i16 index );
+
+// Map pointers to entry index, -1 if not from the pool
+static i16 p_CmndMsgPool_MsgIndex( const t_st_hanCmndApiMsg* pst_Msg );
+static i16 p_CmndMsgPool_PacketIndex( const t_st_Packet* pst_Packet );
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+t_st_hanCmndApiMsg* p_CmndMsgPool_AllocMsg( void )
+{
+    i16 index = p_CmndMsgPool_Alloc( &g_MsgPool );
+    return ( index < 0 ) ? NULL : &g_Msgs[index];
+}
+
+bool p_CmndMsgPool_RetainMsg( t_st_hanCmndApiMsg* pst_Msg )
+{
+    return p_CmndMsgPool_Retain( &g_MsgPool, p_CmndMsgPool_MsgIndex( pst_Msg ) );
+}
+
+void p_CmndMsgPool_ReleaseMsg( t_st_hanCmndApiMsg* pst_Msg )
+{
+    p_CmndMsgPool_Release( &g_MsgPool, p_CmndMsgPool_MsgIndex( pst_Msg ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+t_st_Packet* p_CmndMsgPool_AllocPacket( void )
+{
+    i16 index = p_CmndMsgPool_Alloc( &g_PacketPool );
+    return ( index < 0 ) ? NULL : &g_Packets[index];
+}
+
+bool p_CmndMsgPool_RetainPacket( t_st_Packet* pst_Packet )
+{
+    return p_CmndMsgPool_Retain( &g_PacketPool, p_CmndMsgPool_PacketIndex( pst_Packet ) );
+}
+
+void p_CmndMsgPool_ReleasePacket( t_st_Packet* pst_Packet )
+{
+    p_CmndMsgPool_Release( &g_PacketPool, p_CmndMsgPool_PacketIndex( pst_Packet ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void p_CmndMsgPool_GetMsgStats( OUT t_st_CmndMsgPoolStats* pst_Stats )
+{
+    *pst_Stats = g_MsgPool.st_Stats;
+}
+
+void p_CmndMsgPool_GetPacketStats( OUT t_st_CmndMsgPoolStats* pst_Stats )
+{
+    *pst_Stats = g_PacketPool.st_Stats;
+}
+
+void p_CmndMsgPool_ResetStats( void )
+{
+    g_MsgPool.st_Stats.u8_HighWater         = g_MsgPool.st_Stats.u8_Used;
+    g_MsgPool.st_Stats.u16_AllocFailures    = 0;
+    g_PacketPool.st_Stats.u8_HighWater      = g_PacketPool.st_Stats.u8_Used;
+    g_PacketPool.st_Stats.u16_AllocFailures = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static i16 p_CmndMsgPool_MsgIndex( const t_st_hanCmndApiMsg* pst_Msg )
+{
+    if (    ( pst_Msg < &g_Msgs[0] )
+         || ( pst_Msg >= &g_Msgs[CMNDLIB_MSG_POOL_CAPACITY] ) )
+    {
+        return -1;
+    }
+    return (i16)( pst_Msg - g_Msgs );
+}
+
+static i16 p_CmndMsgPool_PacketIndex( const t_st_Packet* pst_Packet )
+{
+    if (    ( pst_Packet < &g_Packets[0] )
+         || ( pst_Packet >= &g_Packets[CMNDLIB_PACKET_POOL_CAPACITY] ) )
+    {
+        return -1;
+    }
+    return (i16)( pst_Packet - g_Packets );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static i16 p_CmndMsgPool_Alloc( INOUT t_st_CmndMsgPool* pst_Pool )
+{
+    t_st_CmndMsgPoolStats* pst_Stats = &pst_Pool->st_Stats;
+    i16 i;
+
+    for ( i = 0; i < pst_Stats->u8_Capacity; i++ )
+    {
+        if ( pst_Pool->pu8_RefCount[i] == 0 )
+        {
+            pst_Pool->pu8_RefCount[i] = 1;
+            pst_Stats->u8_Used++;
+            if ( pst_Stats->u8_Used > pst_Stats->u8_HighWater )
+            {
+                pst_Stats->u8_HighWater = pst_Stats->u8_Used;
+            }
+            return i;
+        }
+    }
+
+    if ( pst_Stats->u16_AllocFailures < U16_MAX )
+    {
+        pst_Stats->u16_AllocFailures++;
+    }
+    LOG_WARN( "Pool exhausted, capacity<%d>", pst_Stats->u8_Capacity );
+    return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static bool p_CmndMsgPool_Retain( INOUT t_st_CmndMsgPool* pst_Pool, i16 index )
+{
+    if (    ( index < 0 )
+         || ( index >= pst_Pool->st_Stats.u8_Capacity )
+         || ( pst_Pool->pu8_RefCount[index] == 0 )
+         || ( pst_Pool->pu8_RefCount[index] == U8_MAX ) )
+    {
+        LOG_ERROR( "Retain of invalid pool entry<%d>", index );
+        return false;
+    }
+
+    pst_Pool->pu8_RefCount[index]++;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static void p_CmndMsgPool_Release( INOUT t_st_CmndMsgPool* pst_Pool, i16 index )
+{
+    if (    ( index < 0 )
+         || ( index >= pst_Pool->st_Stats.u8_Capacity )
+         || ( pst_Pool->pu8_RefCount[index] == 0 ) )
+    {
+        LOG_ERROR( "Release of invalid pool entry<%d>", index );
+        return;
+    }
+
+    pst_Pool->pu8_RefCount[index]--;
+    if ( pst_Pool->pu8_RefCount[index] == 0 )
+    {
+        pst_Pool->st_Stats.u8_Used--;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
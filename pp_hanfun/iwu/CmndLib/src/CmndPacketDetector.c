@@ -40,7 +40,10 @@ bool p_hanCmndApi_HandleByte(t_stReceiveData* context, u8 byte, OUT t_st_Msg* ms
 
     if(context->result == E_DETECT_PACKET_OK)
     {
-        return p_CmndPacketParser_ParseCmndPacket(context->packet.length, context->packet.buffer, msg);
+        return p_CmndPacketParser_ParseCmndPacketMode(  context->packet.length,
+                                                        context->packet.buffer,
+                                                        CMND_PACKET_PARSER_MODE_USED_ONLY,
+                                                        msg );
     }
 
     return false;
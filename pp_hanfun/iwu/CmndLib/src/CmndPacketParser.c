@@ -28,6 +28,21 @@ bool p_CmndPacketParser_ParseCmndApiPacket( const t_st_Packet* packet, OUT t_st_
 bool p_CmndPacketParser_ParseCmndPacket(    u16                     u16_BufferLength,
                                             const u8*               pu8_Buffer,
                                             OUT t_st_hanCmndApiMsg* pst_cmndApiMsg)
+{
+    return p_CmndPacketParser_ParseCmndPacketMode(  u16_BufferLength,
+                                                    pu8_Buffer,
+                                                    CMND_PACKET_PARSER_MODE_CLEAR,
+                                                    pst_cmndApiMsg );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool p_CmndPacketParser_ParseCmndPacketMode(    u16                         u16_BufferLength,
+                                                const u8*                   pu8_Buffer,
+                                                t_en_CmndPacketParserMode   en_Mode,
+                                                OUT t_st_hanCmndApiMsg*     pst_cmndApiMsg)
 {
     bool ok = true;
 
@@ -37,7 +52,14 @@ bool p_CmndPacketParser_ParseCmndPacket(    u16                     u16_BufferLe
         return false;
     }
 
-    memset( pst_cmndApiMsg, 0, sizeof(t_st_hanCmndApiMsg) );
+    if ( en_Mode == CMND_PACKET_PARSER_MODE_CLEAR )
+    {
+        memset( pst_cmndApiMsg, 0, sizeof(t_st_hanCmndApiMsg) );
+    }
+    else
+    {
+        pst_cmndApiMsg->nodeDeviceId = 0;
+    }
     pst_cmndApiMsg->cookie      = pu8_Buffer[CMND_API_PROTOCOL_COOKIE_POS];
     pst_cmndApiMsg->unitId      = pu8_Buffer[CMND_API_PROTOCOL_UNITID_POS];
     memcpy( &(pst_cmndApiMsg->serviceId), &(pu8_Buffer[CMND_API_PROTOCOL_SERVICEID_POS]), sizeof(pst_cmndApiMsg->serviceId) );
@@ -48,10 +70,11 @@ bool p_CmndPacketParser_ParseCmndPacket(    u16                     u16_BufferLe
 
     if ( u16_BufferLength > CMND_API_PROTOCOL_SIZE_WITHOUT_DATA )
     {
-        pst_cmndApiMsg->dataLength = u16_BufferLength - CMND_API_PROTOCOL_SIZE_WITHOUT_DATA;
-        if ( pst_cmndApiMsg->dataLength < CMNDLIB_API_PACKET_MAX_SIZE )
+        u16 u16_DataLength = u16_BufferLength - CMND_API_PROTOCOL_SIZE_WITHOUT_DATA;
+        if ( u16_DataLength <= sizeof(pst_cmndApiMsg->data) )
         {
-            memcpy(pst_cmndApiMsg->data, &(pu8_Buffer[CMND_API_PROTOCOL_DATASTART_POS]), pst_cmndApiMsg->dataLength);
+            memcpy(pst_cmndApiMsg->data, &(pu8_Buffer[CMND_API_PROTOCOL_DATASTART_POS]), u16_DataLength);
+            pst_cmndApiMsg->dataLength = u16_DataLength;
         }
         else
         {
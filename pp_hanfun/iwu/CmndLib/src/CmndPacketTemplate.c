@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2016-2018 DSP Group, Inc.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "CmndPacketTemplate.h"
+#include "CmndPacketCreator.h"
+#include "CmndApiHost.h"
+
+#include <string.h> //memcpy
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Positions in serialized packet (including 0xDADA and length)
+enum
+{
+    TEMPLATE_COOKIE_POS     = CMND_API_PROTOCOL_SIZE_HEADER + CMND_API_PROTOCOL_COOKIE_POS,
+    TEMPLATE_UNITID_POS     = CMND_API_PROTOCOL_SIZE_HEADER + CMND_API_PROTOCOL_UNITID_POS,
+    TEMPLATE_CHECKSUM_POS   = CMND_API_PROTOCOL_CHECKSUM_POS_WITH_HEADERS,
+};
+
+typedef bool (*TemplateCreator)(t_st_Packet* packet);
+
+typedef struct
+{
+    t_st_Packet packet;
+    bool        b_Valid;
+}
+t_st_CmndPacketTemplate;
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Creators with unit id, the unit id is patched on every use
+static bool p_CmndPacketTemplate_OnReq( t_st_Packet* packet );
+static bool p_CmndPacketTemplate_OffReq( t_st_Packet* packet );
+static bool p_CmndPacketTemplate_ToggleReq( t_st_Packet* packet );
+
+/// Creator of each template, indexed by t_en_CmndPacketTemplateId
+static const TemplateCreator g_TemplateCreators[CMND_PACKET_TEMPLATE_LAST] =
+{
+    p_KeepAlive_IamAliveReq,
+    p_General_HelloReq,
+    p_General_GetStatusReq,
+    p_CmndPacketTemplate_OnReq,
+    p_CmndPacketTemplate_OffReq,
+    p_CmndPacketTemplate_ToggleReq,
+    p_System_GetRssi,
+};
+
+/// Serialized templates
+static t_st_CmndPacketTemplate g_Templates[CMND_PACKET_TEMPLATE_LAST];
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool p_CmndPacketTemplate_Get(  OUT t_st_Packet*                packet,
+                                    t_en_CmndPacketTemplateId   en_TemplateId,
+                                    u8                          u8_UnitId,
+                                    u8                          u8_Cookie )
+{
+    t_st_CmndPacketTemplate* pst_Template;
+
+    if ( en_TemplateId >= CMND_PACKET_TEMPLATE_LAST )
+    {
+        return false;
+    }
+
+    pst_Template = &g_Templates[en_TemplateId];
+    if ( !pst_Template->b_Valid )
+    {
+        if ( !g_TemplateCreators[en_TemplateId]( &pst_Template->packet ) )
+        {
+            return false;
+        }
+        pst_Template->b_Valid = true;
+    }
+
+    // copy used part only
+    memcpy( packet->buffer, pst_Template->packet.buffer, pst_Template->packet.length );
+    packet->length = pst_Template->packet.length;
+
+    p_CmndPacketTemplate_Patch( packet, u8_UnitId, u8_Cookie );
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void p_CmndPacketTemplate_Patch( INOUT t_st_Packet* packet, u8 u8_UnitId, u8 u8_Cookie )
+{
+    u8 u8_CheckSum = packet->buffer[TEMPLATE_CHECKSUM_POS];
+
+    // checksum is a plain byte sum, so only the difference of patched bytes matters
+    u8_CheckSum += (u8)( u8_Cookie - packet->buffer[TEMPLATE_COOKIE_POS] );
+    u8_CheckSum += (u8)( u8_UnitId - packet->buffer[TEMPLATE_UNITID_POS] );
+
+    packet->buffer[TEMPLATE_COOKIE_POS]     = u8_Cookie;
+    packet->buffer[TEMPLATE_UNITID_POS]     = u8_UnitId;
+    packet->buffer[TEMPLATE_CHECKSUM_POS]   = u8_CheckSum;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void p_CmndPacketTemplate_Reset( void )
+{
+    u8 i;
+    for ( i = 0; i < CMND_PACKET_TEMPLATE_LAST; i++ )
+    {
+        g_Templates[i].b_Valid = false;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static bool p_CmndPacketTemplate_OnReq( t_st_Packet* packet )
+{
+    return p_OnOff_OnReq( packet, 0 );
+}
+
+static bool p_CmndPacketTemplate_OffReq( t_st_Packet* packet )
+{
+    return p_OnOff_OffReq( packet, 0 );
+}
+
+static bool p_CmndPacketTemplate_ToggleReq( t_st_Packet* packet )
+{
+    return p_OnOff_ToggleReq( packet, 0 );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
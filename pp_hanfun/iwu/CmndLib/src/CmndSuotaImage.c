@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) 2016-2018 DSP Group, Inc.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "CmndSuotaImage.h"
+#include "Logger.h"
+
+#include <string.h> //memset
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+/// Magic of SUOTA transport image header
+static const u8 suotaImageMagic[] = { 'S', 'U', 'Z' };
+
+enum
+{
+    SUOTA_IMAGE_VERSION_POS         = 3,
+    SUOTA_IMAGE_METHOD_POS          = 4,
+    SUOTA_IMAGE_BLOCK_SIZE_POS      = 6,
+    SUOTA_IMAGE_SIZE_POS            = 8,
+    SUOTA_IMAGE_CHECKSUM_POS        = 12,
+
+    SUOTA_IMAGE_RLE_REPEAT_FLAG     = 0x80,
+    SUOTA_IMAGE_RLE_REPEAT_MIN      = 3,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Read network order fields from header
+static u16 p_CmndSuotaImage_Get16( const u8* pu8_Buffer );
+static u32 p_CmndSuotaImage_Get32( const u8* pu8_Buffer );
+
+// Validate accumulated header and prepare for first block
+static t_en_CmndSuotaImage_DecodeCode p_CmndSuotaImage_HeaderDone( INOUT t_st_CmndSuotaImageDecoder* pst_Decoder );
+
+// Store decoded bytes in current block
+static bool p_CmndSuotaImage_Store( INOUT t_st_CmndSuotaImageDecoder* pst_Decoder, u8 u8_Byte, u8 u8_Count );
+
+// Called whenever encoded bytes of current block are consumed
+static t_en_CmndSuotaImage_DecodeCode p_CmndSuotaImage_BlockCheck( INOUT t_st_CmndSuotaImageDecoder* pst_Decoder );
+
+// Move to error state
+static t_en_CmndSuotaImage_DecodeCode p_CmndSuotaImage_Error( INOUT t_st_CmndSuotaImageDecoder* pst_Decoder, const char* reason );
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool p_CmndSuotaImage_IsTransportImage( const u8* pu8_Buffer, u16 u16_Length )
+{
+    if (    !pu8_Buffer
+         || ( u16_Length < CMND_SUOTA_IMAGE_HEADER_SIZE ) )
+    {
+        return false;
+    }
+
+    return  ( memcmp( pu8_Buffer, suotaImageMagic, sizeof(suotaImageMagic) ) == 0 )
+         && ( pu8_Buffer[SUOTA_IMAGE_VERSION_POS] == CMND_SUOTA_IMAGE_VERSION )
+         && ( pu8_Buffer[SUOTA_IMAGE_METHOD_POS] == CMND_SUOTA_IMAGE_METHOD_RLE );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void p_CmndSuotaImage_DecoderInit( OUT t_st_CmndSuotaImageDecoder* pst_Decoder )
+{
+    // header fields and counters only, block data is overwritten before use
+    pst_Decoder->state              = SUOTA_IMAGE_ST_HEADER;
+    pst_Decoder->u16_HeaderIndex    = 0;
+    pst_Decoder->u16_BlockSize      = 0;
+    pst_Decoder->u32_ImageSize      = 0;
+    pst_Decoder->u32_ImageChecksum  = 0;
+    pst_Decoder->u16_EncodedRemaining = 0;
+    pst_Decoder->u8_RunRemaining    = 0;
+    pst_Decoder->u8_RepeatCount     = 0;
+    pst_Decoder->u16_BlockLength    = 0;
+    pst_Decoder->u16_BlockExpected  = 0;
+    pst_Decoder->u32_DecodedSize    = 0;
+    pst_Decoder->u32_Checksum       = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+t_en_CmndSuotaImage_DecodeCode p_CmndSuotaImage_DecodeAppendByte( INOUT t_st_CmndSuotaImageDecoder* pst_Decoder, u8 u8_Byte )
+{
+    t_en_CmndSuotaImage_DecodeCode en_RetCode = E_SUOTA_IMAGE_ONGOING;
+
+    switch( pst_Decoder->state )
+    {
+        case SUOTA_IMAGE_ST_HEADER:
+        {
+            pst_Decoder->header[pst_Decoder->u16_HeaderIndex] = u8_Byte;
+            pst_Decoder->u16_HeaderIndex++;
+
+            if ( pst_Decoder->u16_HeaderIndex == CMND_SUOTA_IMAGE_HEADER_SIZE )
+            {
+                en_RetCode = p_CmndSuotaImage_HeaderDone( pst_Decoder );
+            }
+        }
+        break;
+
+        case SUOTA_IMAGE_ST_BLOCK_LENGTH1:
+        {
+            // previous block was handed out, start a new one
+            pst_Decoder->u16_BlockLength = 0;
+            pst_Decoder->u16_BlockExpected = (u16)MIN( (u32)pst_Decoder->u16_BlockSize,
+                                                       pst_Decoder->u32_ImageSize - pst_Decoder->u32_DecodedSize );
+
+            pst_Decoder->u16_EncodedRemaining = ( u8_Byte << 8 );
+            pst_Decoder->state = SUOTA_IMAGE_ST_BLOCK_LENGTH2;
+        }
+        break;
+
+        case SUOTA_IMAGE_ST_BLOCK_LENGTH2:
+        {
+            bool b_Compressed;
+
+            pst_Decoder->u16_EncodedRemaining |= u8_Byte;
+            b_Compressed = ( pst_Decoder->u16_EncodedRemaining & CMND_SUOTA_IMAGE_BLOCK_COMPRESSED ) ? true : false;
+            pst_Decoder->u16_EncodedRemaining &= CMND_SUOTA_IMAGE_BLOCK_LENGTH_MASK;
+
+            if ( pst_Decoder->u16_EncodedRemaining == 0 )
+            {
+                en_RetCode = p_CmndSuotaImage_Error( pst_Decoder, "empty block" );
+                break;
+            }
+
+            pst_Decoder->state = b_Compressed ? SUOTA_IMAGE_ST_RLE_CONTROL : SUOTA_IMAGE_ST_STORED;
+        }
+        break;
+
+        case SUOTA_IMAGE_ST_STORED:
+        {
+            pst_Decoder->u16_EncodedRemaining--;
+            if ( !p_CmndSuotaImage_Store( pst_Decoder, u8_Byte, 1 ) )
+            {
+                en_RetCode = p_CmndSuotaImage_Error( pst_Decoder, "block overflow" );
+                break;
+            }
+            en_RetCode = p_CmndSuotaImage_BlockCheck( pst_Decoder );
+        }
+        break;
+
+        case SUOTA_IMAGE_ST_RLE_CONTROL:
+        {
+            pst_Decoder->u16_EncodedRemaining--;
+            if ( u8_Byte & SUOTA_IMAGE_RLE_REPEAT_FLAG )
+            {
+                pst_Decoder->u8_RepeatCount = ( u8_Byte & ~SUOTA_IMAGE_RLE_REPEAT_FLAG ) + SUOTA_IMAGE_RLE_REPEAT_MIN;
+                pst_Decoder->state = SUOTA_IMAGE_ST_RLE_REPEAT;
+            }
+            else
+            {
+                pst_Decoder->u8_RunRemaining = u8_Byte + 1;
+                pst_Decoder->state = SUOTA_IMAGE_ST_RLE_LITERAL;
+            }
+
+            // control byte must be followed by data in the same block
+            if ( pst_Decoder->u16_EncodedRemaining == 0 )
+            {
+                en_RetCode = p_CmndSuotaImage_Error( pst_Decoder, "truncated run" );
+            }
+        }
+        break;
+
+        case SUOTA_IMAGE_ST_RLE_LITERAL:
+        {
+            pst_Decoder->u16_EncodedRemaining--;
+            if ( !p_CmndSuotaImage_Store( pst_Decoder, u8_Byte, 1 ) )
+            {
+                en_RetCode = p_CmndSuotaImage_Error( pst_Decoder, "block overflow" );
+                break;
+            }
+
+            pst_Decoder->u8_RunRemaining--;
+            if ( pst_Decoder->u8_RunRemaining == 0 )
+            {
+                pst_Decoder->state = SUOTA_IMAGE_ST_RLE_CONTROL;
+            }
+            else if ( pst_Decoder->u16_EncodedRemaining == 0 )
+            {
+                en_RetCode = p_CmndSuotaImage_Error( pst_Decoder, "truncated run" );
+                break;
+            }
+            en_RetCode = p_CmndSuotaImage_BlockCheck( pst_Decoder );
+        }
+        break;
+
+        case SUOTA_IMAGE_ST_RLE_REPEAT:
+        {
+            pst_Decoder->u16_EncodedRemaining--;
+            if ( !p_CmndSuotaImage_Store( pst_Decoder, u8_Byte, pst_Decoder->u8_RepeatCount ) )
+            {
+                en_RetCode = p_CmndSuotaImage_Error( pst_Decoder, "block overflow" );
+                break;
+            }
+
+            pst_Decoder->state = SUOTA_IMAGE_ST_RLE_CONTROL;
+            en_RetCode = p_CmndSuotaImage_BlockCheck( pst_Decoder );
+        }
+        break;
+
+        case SUOTA_IMAGE_ST_ERROR:
+        default:
+        {
+            en_RetCode = E_SUOTA_IMAGE_ERROR;
+        }
+        break;
+    }
+
+    return en_RetCode;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+t_en_CmndSuotaImage_DecodeCode p_CmndSuotaImage_Decode( INOUT   t_st_CmndSuotaImageDecoder* pst_Decoder,
+                                                        const   u8*                         pu8_InputBuf,
+                                                                u16                         u16_InputBufLen,
+                                                        INOUT   u16*                        pu16_InputBufIndex )
+{
+    t_en_CmndSuotaImage_DecodeCode en_RetCode = E_SUOTA_IMAGE_ONGOING;
+
+    while ( ( *pu16_InputBufIndex < u16_InputBufLen )
+            && ( en_RetCode == E_SUOTA_IMAGE_ONGOING ) )
+    {
+        en_RetCode = p_CmndSuotaImage_DecodeAppendByte( pst_Decoder, pu8_InputBuf[*pu16_InputBufIndex] );
+        (*pu16_InputBufIndex)++;
+    }
+
+    return en_RetCode;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+const u8* p_CmndSuotaImage_GetBlock( const t_st_CmndSuotaImageDecoder* pst_Decoder, OUT u32* pu32_Offset, OUT u16* pu16_Length )
+{
+    *pu32_Offset = pst_Decoder->u32_DecodedSize - pst_Decoder->u16_BlockLength;
+    *pu16_Length = pst_Decoder->u16_BlockLength;
+    return pst_Decoder->block;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static u16 p_CmndSuotaImage_Get16( const u8* pu8_Buffer )
+{
+    return ( (u16)pu8_Buffer[0] << 8 ) | pu8_Buffer[1];
+}
+
+static u32 p_CmndSuotaImage_Get32( const u8* pu8_Buffer )
+{
+    return  ( (u32)pu8_Buffer[0] << 24 )
+          | ( (u32)pu8_Buffer[1] << 16 )
+          | ( (u32)pu8_Buffer[2] << 8 )
+          |   (u32)pu8_Buffer[3];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static t_en_CmndSuotaImage_DecodeCode p_CmndSuotaImage_HeaderDone( INOUT t_st_CmndSuotaImageDecoder* pst_Decoder )
+{
+    if ( !p_CmndSuotaImage_IsTransportImage( pst_Decoder->header, sizeof(pst_Decoder->header) ) )
+    {
+        return p_CmndSuotaImage_Error( pst_Decoder, "unsupported header" );
+    }
+
+    pst_Decoder->u16_BlockSize      = p_CmndSuotaImage_Get16( &pst_Decoder->header[SUOTA_IMAGE_BLOCK_SIZE_POS] );
+    pst_Decoder->u32_ImageSize      = p_CmndSuotaImage_Get32( &pst_Decoder->header[SUOTA_IMAGE_SIZE_POS] );
+    pst_Decoder->u32_ImageChecksum  = p_CmndSuotaImage_Get32( &pst_Decoder->header[SUOTA_IMAGE_CHECKSUM_POS] );
+
+    if (    ( pst_Decoder->u16_BlockSize == 0 )
+         || ( pst_Decoder->u16_BlockSize > CMNDLIB_SUOTA_IMAGE_BLOCK_MAX_SIZE ) )
+    {
+        return p_CmndSuotaImage_Error( pst_Decoder, "unsupported block size" );
+    }
+
+    if ( pst_Decoder->u32_ImageSize == 0 )
+    {
+        return p_CmndSuotaImage_Error( pst_Decoder, "empty image" );
+    }
+
+    pst_Decoder->state = SUOTA_IMAGE_ST_BLOCK_LENGTH1;
+    return E_SUOTA_IMAGE_ONGOING;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static bool p_CmndSuotaImage_Store( INOUT t_st_CmndSuotaImageDecoder* pst_Decoder, u8 u8_Byte, u8 u8_Count )
+{
+    if ( pst_Decoder->u16_BlockLength + u8_Count > pst_Decoder->u16_BlockExpected )
+    {
+        return false;
+    }
+
+    memset( &pst_Decoder->block[pst_Decoder->u16_BlockLength], u8_Byte, u8_Count );
+    pst_Decoder->u16_BlockLength += u8_Count;
+    pst_Decoder->u32_Checksum += (u32)u8_Byte * u8_Count;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static t_en_CmndSuotaImage_DecodeCode p_CmndSuotaImage_BlockCheck( INOUT t_st_CmndSuotaImageDecoder* pst_Decoder )
+{
+    if ( pst_Decoder->u16_EncodedRemaining > 0 )
+    {
+        return E_SUOTA_IMAGE_ONGOING;
+    }
+
+    if ( pst_Decoder->u16_BlockLength != pst_Decoder->u16_BlockExpected )
+    {
+        return p_CmndSuotaImage_Error( pst_Decoder, "short block" );
+    }
+
+    pst_Decoder->u32_DecodedSize += pst_Decoder->u16_BlockLength;
+
+    if ( pst_Decoder->u32_DecodedSize < pst_Decoder->u32_ImageSize )
+    {
+        pst_Decoder->state = SUOTA_IMAGE_ST_BLOCK_LENGTH1;
+        return E_SUOTA_IMAGE_BLOCK_READY;
+    }
+
+    if ( pst_Decoder->u32_Checksum != pst_Decoder->u32_ImageChecksum )
+    {
+        LOG_ERROR(  "SUOTA image checksum failed. Expected<0x%lx>, actual<0x%lx>",
+                    (unsigned long)pst_Decoder->u32_ImageChecksum,
+                    (unsigned long)pst_Decoder->u32_Checksum );
+        pst_Decoder->state = SUOTA_IMAGE_ST_ERROR;
+        return E_SUOTA_IMAGE_ERROR;
+    }
+
+    // any further input is an error
+    pst_Decoder->state = SUOTA_IMAGE_ST_ERROR;
+    return E_SUOTA_IMAGE_DONE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static t_en_CmndSuotaImage_DecodeCode p_CmndSuotaImage_Error( INOUT t_st_CmndSuotaImageDecoder* pst_Decoder, const char* reason )
+{
+    LOG_ERROR( "SUOTA image decoding failed: %s at offset<0x%lx>", reason, (unsigned long)pst_Decoder->u32_DecodedSize );
+    pst_Decoder->state = SUOTA_IMAGE_ST_ERROR;
+    return E_SUOTA_IMAGE_ERROR;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2016-2018 DSP Group, Inc.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "CmndTransaction.h"
+#include "CmndPacketCreator.h"
+#include "CmndPacketTemplate.h"
+#include "CmndApiHost.h"
+#include "CmndMsg.h"
+#include "Logger.h"
+
+#include <string.h> //memcpy
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Set cookie of packet and append it to transaction buffer
+static bool p_CmndTransaction_Append( INOUT t_st_CmndTransaction* pst_Transaction, INOUT t_st_Packet* packet, u8 u8_Cookie );
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool p_CmndTransaction_Init(    OUT t_st_CmndTransaction*   pst_Transaction,
+                                    u8*                     pu8_Buffer,
+                                    u16                     u16_BufferSize,
+                                    u8                      u8_FirstCookie )
+{
+    t_st_Packet packet;
+
+    memset( pst_Transaction, 0, sizeof(t_st_CmndTransaction) );
+    pst_Transaction->pu8_Buffer     = pu8_Buffer;
+    pst_Transaction->u16_BufferSize = u16_BufferSize;
+    pst_Transaction->u8_FirstCookie = u8_FirstCookie;
+
+    return  p_General_TransactionStartReq( &packet )
+         && p_CmndTransaction_Append( pst_Transaction, &packet, u8_FirstCookie );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool p_CmndTransaction_Add( INOUT t_st_CmndTransaction* pst_Transaction, INOUT t_st_Packet* packet, bool b_ExpectResponse )
+{
+    u8 u8_Cookie = pst_Transaction->u8_FirstCookie + 1 + pst_Transaction->u8_Count;
+
+    if ( pst_Transaction->b_Closed || pst_Transaction->u8_Count >= CMNDLIB_TRANSACTION_MAX_REQUESTS )
+    {
+        LOG_ERROR( "Transaction full, requests<%d>", pst_Transaction->u8_Count );
+        return false;
+    }
+
+    if ( !p_CmndTransaction_Append( pst_Transaction, packet, u8_Cookie ) )
+    {
+        return false;
+    }
+
+    pst_Transaction->ast_Responses[pst_Transaction->u8_Count].b_Expected = b_ExpectResponse;
+    pst_Transaction->u8_Count++;
+    if ( b_ExpectResponse )
+    {
+        pst_Transaction->u8_Pending++;
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool p_CmndTransaction_Close( INOUT t_st_CmndTransaction* pst_Transaction )
+{
+    t_st_Packet packet;
+    u8 u8_Cookie = pst_Transaction->u8_FirstCookie + 1 + pst_Transaction->u8_Count;
+
+    if ( pst_Transaction->b_Closed )
+    {
+        return true;
+    }
+
+    if (    !p_General_TransactionEndReq( &packet )
+         || !p_CmndTransaction_Append( pst_Transaction, &packet, u8_Cookie ) )
+    {
+        return false;
+    }
+
+    pst_Transaction->b_Closed = true;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+t_en_CmndTransactionCode p_CmndTransaction_HandleMsg(   INOUT t_st_CmndTransaction*     pst_Transaction,
+                                                        const t_st_hanCmndApiMsg*       pst_Msg )
+{
+    u8 u8_Offset = pst_Msg->cookie - pst_Transaction->u8_FirstCookie;
+
+    if ( !pst_Transaction->b_Closed || u8_Offset > pst_Transaction->u8_Count + 1 )
+    {
+        return E_CMND_TRANSACTION_IGNORED;
+    }
+
+    if ( pst_Msg->serviceId == CMND_SERVICE_ID_GENERAL )
+    {
+        switch ( pst_Msg->messageId )
+        {
+            case CMND_MSG_GENERAL_TRANSACTION_START_CFM:
+                pst_Transaction->b_Started = true;
+                break;
+
+            case CMND_MSG_GENERAL_TRANSACTION_END_CFM:
+                pst_Transaction->b_Ended = true;
+                break;
+
+            case CMND_MSG_GENERAL_LINK_CFM:
+                // delivery confirmation only, the response follows
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (    ( u8_Offset >= 1 )
+         && ( u8_Offset <= pst_Transaction->u8_Count )
+         && !( pst_Msg->serviceId == CMND_SERVICE_ID_GENERAL && pst_Msg->messageId == CMND_MSG_GENERAL_LINK_CFM ) )
+    {
+        t_st_CmndTransactionResponse* pst_Response = &pst_Transaction->ast_Responses[u8_Offset - 1];
+
+        if ( !pst_Response->b_Received )
+        {
+            t_st(CMND_IE_RESPONSE) st_Result = { 0 };
+            u16 u16_Length = pst_Msg->dataLength;
+
+            pst_Response->u16_ServiceId = pst_Msg->serviceId;
+            pst_Response->u8_MessageId  = pst_Msg->messageId;
+            pst_Response->b_HasResult   = p_CmndMsg_IeGet( pst_Msg, p_CMND_IE_GETTER(CMND_IE_RESPONSE), &st_Result, sizeof(st_Result) );
+            pst_Response->u8_Result     = st_Result.u8_Result;
+
+            if ( u16_Length > sizeof(pst_Response->au8_Data) )
+            {
+                u16_Length = sizeof(pst_Response->au8_Data);
+                pst_Response->b_Truncated = true;
+            }
+            memcpy( pst_Response->au8_Data, pst_Msg->data, u16_Length );
+            pst_Response->u16_DataLength = u16_Length;
+            pst_Response->b_Received    = true;
+
+            // unsolicited answers of requests which do not expect one are kept, but not waited for
+            if ( pst_Response->b_Expected )
+            {
+                pst_Transaction->u8_Pending--;
+            }
+        }
+    }
+
+    if ( pst_Transaction->b_Started && pst_Transaction->b_Ended && pst_Transaction->u8_Pending == 0 )
+    {
+        return E_CMND_TRANSACTION_DONE;
+    }
+    return E_CMND_TRANSACTION_ONGOING;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+const t_st_CmndTransactionResponse* p_CmndTransaction_GetResponse(  const t_st_CmndTransaction* pst_Transaction,
+                                                                    u8                          u8_Index )
+{
+    if ( u8_Index >= pst_Transaction->u8_Count )
+    {
+        return NULL;
+    }
+    return &pst_Transaction->ast_Responses[u8_Index];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static bool p_CmndTransaction_Append( INOUT t_st_CmndTransaction* pst_Transaction, INOUT t_st_Packet* packet, u8 u8_Cookie )
+{
+    if ( pst_Transaction->u16_Length + packet->length > pst_Transaction->u16_BufferSize )
+    {
+        LOG_ERROR( "Transaction buffer full, size<%d>", pst_Transaction->u16_BufferSize );
+        return false;
+    }
+
+    // keep unit id of the packet, replace cookie only
+    p_CmndPacketTemplate_Patch( packet,
+                                packet->buffer[CMND_API_PROTOCOL_SIZE_HEADER + CMND_API_PROTOCOL_UNITID_POS],
+                                u8_Cookie );
+
+    memcpy( &pst_Transaction->pu8_Buffer[pst_Transaction->u16_Length], packet->buffer, packet->length );
+    pst_Transaction->u16_Length += packet->length;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,95 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+///////////////////////////////////////////////////////////////////////////////
+/// Per message cost of p_CmndPacketParser_ParseCmndPacketMode
+///
+/// Parses the same received frame (FUN message with a 20 byte payload) in a
+/// loop, once clearing the whole t_st_hanCmndApiMsg and once setting only the
+/// header fields and the used payload prefix, and prints ns per message.
+///
+///     bench_CmndPacketParser [iterations]
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CmndPacketParser.h"
+#include "CmndApiHost.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_ITERATIONS    10000000UL
+#define BENCH_PAYLOAD       20
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static double p_Bench_NowNs( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Parse the frame u32_Iterations times, return ns per message
+static double p_Bench_Parse( const u8* pu8_Frame, u16 u16_Length, t_en_CmndPacketParserMode en_Mode, unsigned long u32_Iterations )
+{
+    static t_st_hanCmndApiMsg st_Msg;
+    volatile u32 u32_Sink = 0;
+    unsigned long i;
+    double start;
+
+    start = p_Bench_NowNs();
+    for ( i = 0; i < u32_Iterations; i++ )
+    {
+        if ( !p_CmndPacketParser_ParseCmndPacketMode( u16_Length, pu8_Frame, en_Mode, &st_Msg ) )
+        {
+            fprintf( stderr, "parse failed\n" );
+            exit( 1 );
+        }
+        // keep the parse from being optimized away
+        u32_Sink += st_Msg.dataLength + st_Msg.data[0];
+    }
+    return ( p_Bench_NowNs() - start ) / u32_Iterations;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+int main( int argc, char* argv[] )
+{
+    unsigned long u32_Iterations = argc > 1 ? strtoul( argv[1], NULL, 0 ) : BENCH_ITERATIONS;
+    u8 au8_Frame[CMND_API_PROTOCOL_SIZE_WITHOUT_DATA + BENCH_PAYLOAD] = {
+        0x2a,           // cookie
+        0x01,           // unit id
+        0x04, 0x00,     // service id (FUN)
+        0x01,           // message id
+        0x00,           // checksum
+    };
+    double clear, used_only;
+    u16 i;
+
+    for ( i = 0; i < BENCH_PAYLOAD; i++ )
+    {
+        au8_Frame[CMND_API_PROTOCOL_DATASTART_POS + i] = (u8)i;
+    }
+
+    // warm up
+    p_Bench_Parse( au8_Frame, sizeof(au8_Frame), CMND_PACKET_PARSER_MODE_CLEAR, u32_Iterations / 10 );
+
+    clear       = p_Bench_Parse( au8_Frame, sizeof(au8_Frame), CMND_PACKET_PARSER_MODE_CLEAR, u32_Iterations );
+    used_only   = p_Bench_Parse( au8_Frame, sizeof(au8_Frame), CMND_PACKET_PARSER_MODE_USED_ONLY, u32_Iterations );
+
+    printf( "t_st_hanCmndApiMsg %u bytes, payload %d of %u bytes\n",
+            (unsigned)sizeof(t_st_hanCmndApiMsg), BENCH_PAYLOAD, (unsigned)sizeof(((t_st_hanCmndApiMsg*)0)->data) );
+    printf( "CLEAR      %8.2f ns/msg\n", clear );
+    printf( "USED_ONLY  %8.2f ns/msg\n", used_only );
+    printf( "speedup    %8.2fx\n", clear / used_only );
+    return 0;
+}
@@ -0,0 +1,222 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+///////////////////////////////////////////////////////////////////////////////
+/// Test driver of CmndTransaction
+///
+/// Feeds hand built responses to p_CmndTransaction_HandleMsg: responses out
+/// of order, link confirmations, unexpected and foreign responses, cookie
+/// wrap around, and transactions and responses exceeding their capacity.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CmndTransaction.h"
+#include "CmndPacketCreator.h"
+#include "CmndApiHost.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int s_Failures = 0;
+
+#define CHECK( cond ) \
+    do\
+    {\
+        if ( !(cond) )\
+        {\
+            printf( "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond ); \
+            s_Failures++; \
+        }\
+    } while ( 0 )
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Received message with a CMND_IE_RESPONSE and u16_Extra payload bytes after it
+static t_st_hanCmndApiMsg p_Test_Response( u8 u8_Cookie, u16 u16_ServiceId, u8 u8_MessageId, u8 u8_Result, u16 u16_Extra )
+{
+    t_st_hanCmndApiMsg st_Msg;
+
+    memset( &st_Msg, 0, sizeof(st_Msg) );
+    st_Msg.cookie       = u8_Cookie;
+    st_Msg.serviceId    = u16_ServiceId;
+    st_Msg.messageId    = u8_MessageId;
+    // IE type, length (network order), result
+    st_Msg.data[0]      = CMND_IE_RESPONSE;
+    st_Msg.data[1]      = 0;
+    st_Msg.data[2]      = 1;
+    st_Msg.data[3]      = u8_Result;
+    memset( &st_Msg.data[4], 0xa5, u16_Extra );
+    st_Msg.dataLength   = 4 + u16_Extra;
+    return st_Msg;
+}
+
+static t_st_hanCmndApiMsg p_Test_General( u8 u8_Cookie, u8 u8_MessageId )
+{
+    t_st_hanCmndApiMsg st_Msg;
+
+    memset( &st_Msg, 0, sizeof(st_Msg) );
+    st_Msg.cookie       = u8_Cookie;
+    st_Msg.serviceId    = CMND_SERVICE_ID_GENERAL;
+    st_Msg.messageId    = u8_MessageId;
+    return st_Msg;
+}
+
+// Transaction of u8_Count OnOff requests, closed
+static void p_Test_Build( t_st_CmndTransaction* pst_Tr, u8* pu8_Buffer, u16 u16_Size, u8 u8_FirstCookie, u8 u8_Count, bool b_Expect )
+{
+    t_st_Packet packet;
+    u8 i;
+
+    CHECK( p_CmndTransaction_Init( pst_Tr, pu8_Buffer, u16_Size, u8_FirstCookie ) );
+    for ( i = 0; i < u8_Count; i++ )
+    {
+        CHECK( p_OnOff_OnReq( &packet, 1 + i ) );
+        CHECK( p_CmndTransaction_Add( pst_Tr, &packet, b_Expect ) );
+    }
+    CHECK( p_CmndTransaction_Close( pst_Tr ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static void p_Test_OutOfOrder( void )
+{
+    static u8 au8_Buffer[512];
+    t_st_CmndTransaction tr;
+    t_st_hanCmndApiMsg msg;
+    const t_st_CmndTransactionResponse* pst_Response;
+
+    // cookies 0xfe (start), 0xff, 0x00, 0x01 (requests), 0x02 (end): offsets wrap around
+    p_Test_Build( &tr, au8_Buffer, sizeof(au8_Buffer), 0xfe, 3, true );
+
+    // serialized packets carry the transaction cookies
+    CHECK( au8_Buffer[CMND_API_PROTOCOL_SIZE_HEADER + CMND_API_PROTOCOL_COOKIE_POS] == 0xfe );
+
+    msg = p_Test_General( 0xfe, CMND_MSG_GENERAL_TRANSACTION_START_CFM );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_ONGOING );
+
+    msg = p_Test_Response( 0x01, CMND_SERVICE_ID_ON_OFF, CMND_MSG_ONOFF_ON_RES, CMND_RC_FAIL, 0 );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_ONGOING );
+
+    // a link confirmation is not the response of the request
+    msg = p_Test_General( 0xff, CMND_MSG_GENERAL_LINK_CFM );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_ONGOING );
+    CHECK( !p_CmndTransaction_GetResponse( &tr, 0 )->b_Received );
+
+    msg = p_Test_Response( 0xff, CMND_SERVICE_ID_ON_OFF, CMND_MSG_ONOFF_ON_RES, CMND_RC_OK, 0 );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_ONGOING );
+
+    msg = p_Test_General( 0x02, CMND_MSG_GENERAL_TRANSACTION_END_CFM );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_ONGOING );
+
+    // done once the last expected response arrived
+    msg = p_Test_Response( 0x00, CMND_SERVICE_ID_ON_OFF, CMND_MSG_ONOFF_ON_RES, CMND_RC_OK, 0 );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_DONE );
+
+    pst_Response = p_CmndTransaction_GetResponse( &tr, 2 );
+    CHECK( pst_Response->b_Received && pst_Response->b_HasResult );
+    CHECK( pst_Response->u16_ServiceId == CMND_SERVICE_ID_ON_OFF && pst_Response->u8_MessageId == CMND_MSG_ONOFF_ON_RES );
+    CHECK( pst_Response->u8_Result == CMND_RC_FAIL );
+    CHECK( p_CmndTransaction_GetResponse( &tr, 0 )->u8_Result == CMND_RC_OK );
+    CHECK( p_CmndTransaction_GetResponse( &tr, 3 ) == NULL );
+}
+
+static void p_Test_Unexpected( void )
+{
+    static u8 au8_Buffer[512];
+    t_st_CmndTransaction tr;
+    t_st_hanCmndApiMsg msg;
+    t_st_Packet packet;
+
+    // not closed yet: nothing belongs to the transaction
+    CHECK( p_CmndTransaction_Init( &tr, au8_Buffer, sizeof(au8_Buffer), 10 ) );
+    msg = p_Test_General( 10, CMND_MSG_GENERAL_TRANSACTION_START_CFM );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_IGNORED );
+
+    // request 11 expects a response, request 12 does not
+    CHECK( p_OnOff_OnReq( &packet, 1 ) );
+    CHECK( p_CmndTransaction_Add( &tr, &packet, true ) );
+    CHECK( p_OnOff_OnReq( &packet, 2 ) );
+    CHECK( p_CmndTransaction_Add( &tr, &packet, false ) );
+    CHECK( p_CmndTransaction_Close( &tr ) );
+
+    // cookies before and after the transaction
+    msg = p_Test_Response( 9, CMND_SERVICE_ID_ON_OFF, CMND_MSG_ONOFF_ON_RES, CMND_RC_OK, 0 );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_IGNORED );
+    msg = p_Test_Response( 14, CMND_SERVICE_ID_ON_OFF, CMND_MSG_ONOFF_ON_RES, CMND_RC_OK, 0 );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_IGNORED );
+
+    msg = p_Test_General( 10, CMND_MSG_GENERAL_TRANSACTION_START_CFM );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_ONGOING );
+    msg = p_Test_General( 13, CMND_MSG_GENERAL_TRANSACTION_END_CFM );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_ONGOING );
+
+    // an answer to the request without response is kept, but does not complete the transaction
+    msg = p_Test_Response( 12, CMND_SERVICE_ID_ON_OFF, CMND_MSG_ONOFF_ON_RES, CMND_RC_OK, 0 );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_ONGOING );
+    CHECK( p_CmndTransaction_GetResponse( &tr, 1 )->b_Received );
+    CHECK( tr.u8_Pending == 1 );
+
+    // the first answer counts, a repeated one neither completes nor replaces it
+    msg = p_Test_Response( 12, CMND_SERVICE_ID_ON_OFF, CMND_MSG_ONOFF_ON_RES, CMND_RC_FAIL, 0 );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_ONGOING );
+    CHECK( p_CmndTransaction_GetResponse( &tr, 1 )->u8_Result == CMND_RC_OK );
+
+    msg = p_Test_Response( 11, CMND_SERVICE_ID_ON_OFF, CMND_MSG_ONOFF_ON_RES, CMND_RC_OK, 0 );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_DONE );
+    CHECK( tr.u8_Pending == 0 );
+}
+
+static void p_Test_Overflow( void )
+{
+    static u8 au8_Buffer[4096];
+    t_st_CmndTransaction tr;
+    t_st_hanCmndApiMsg msg;
+    t_st_Packet packet;
+    const t_st_CmndTransactionResponse* pst_Response;
+    u8 i;
+
+    // more requests than CMNDLIB_TRANSACTION_MAX_REQUESTS
+    CHECK( p_CmndTransaction_Init( &tr, au8_Buffer, sizeof(au8_Buffer), 0 ) );
+    for ( i = 0; i < CMNDLIB_TRANSACTION_MAX_REQUESTS; i++ )
+    {
+        CHECK( p_OnOff_OnReq( &packet, 1 ) );
+        CHECK( p_CmndTransaction_Add( &tr, &packet, true ) );
+    }
+    CHECK( p_OnOff_OnReq( &packet, 1 ) );
+    CHECK( !p_CmndTransaction_Add( &tr, &packet, true ) );
+    CHECK( tr.u8_Count == CMNDLIB_TRANSACTION_MAX_REQUESTS );
+
+    // buffer holding TRANSACTION_START_REQ only
+    CHECK( p_CmndTransaction_Init( &tr, au8_Buffer, sizeof(au8_Buffer), 0 ) );
+    CHECK( p_CmndTransaction_Init( &tr, au8_Buffer, tr.u16_Length, 0 ) );
+    CHECK( p_OnOff_OnReq( &packet, 1 ) );
+    CHECK( !p_CmndTransaction_Add( &tr, &packet, true ) );
+    CHECK( tr.u8_Count == 0 );
+
+    // payload beyond CMNDLIB_TRANSACTION_RESPONSE_MAX_LENGTH is cut
+    p_Test_Build( &tr, au8_Buffer, sizeof(au8_Buffer), 0, 1, true );
+    msg = p_Test_Response( 1, CMND_SERVICE_ID_ON_OFF, CMND_MSG_ONOFF_ON_RES, CMND_RC_OK, 100 );
+    CHECK( p_CmndTransaction_HandleMsg( &tr, &msg ) == E_CMND_TRANSACTION_ONGOING );
+    pst_Response = p_CmndTransaction_GetResponse( &tr, 0 );
+    CHECK( pst_Response->b_Truncated );
+    CHECK( pst_Response->u16_DataLength == CMNDLIB_TRANSACTION_RESPONSE_MAX_LENGTH );
+    CHECK( memcmp( pst_Response->au8_Data, msg.data, CMNDLIB_TRANSACTION_RESPONSE_MAX_LENGTH ) == 0 );
+    CHECK( pst_Response->b_HasResult && pst_Response->u8_Result == CMND_RC_OK );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+int main( void )
+{
+    p_Test_OutOfOrder();
+    p_Test_Unexpected();
+    p_Test_Overflow();
+
+    printf( "test_CmndTransaction: %s\n", s_Failures ? "FAILED" : "OK" );
+    return s_Failures ? 1 : 0;
+}